@@ -0,0 +1,34 @@
+#shader vertex
+#version 430 core
+
+layout(location = 0) in vec2 position;
+
+void main()
+{
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+out vec4 color;
+
+// Weighted blended transparency targets, at the size of the framebuffer
+uniform sampler2D u_Accum;
+uniform sampler2D u_Revealage;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+
+    // Nothing translucent in front
+    float revealage = texelFetch(u_Revealage, texel, 0).r;
+    if(revealage == 1.0)
+        discard;
+
+    vec4 accum = texelFetch(u_Accum, texel, 0);
+
+    // Weighted average color, blended over the opaque faces by the coverage
+    color = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - revealage);
+}
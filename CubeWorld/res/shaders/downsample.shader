@@ -0,0 +1,62 @@
+#shader vertex
+#version 430 core
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 uv;
+
+out vec2 v_Uv;
+
+void main()
+{
+    gl_Position = vec4(position, 0.0, 1.0);
+    v_Uv = uv;
+}
+
+
+#shader fragment
+#version 430 core
+
+out vec4 color;
+
+uniform sampler2D u_Texture;
+
+// Texels of the framebuffer per pixel of the window, on each axis
+uniform vec2 u_Scale;
+
+in vec2 v_Uv;
+
+void main()
+{
+    // Upscaled, bilinear
+    if(u_Scale.x < 1.0 || u_Scale.y < 1.0)
+    {
+        color = texture(u_Texture, v_Uv);
+        return;
+    }
+
+    // The texels under the pixel, each weighted by the part of it they cover (box filter)
+    vec2 low  = floor(gl_FragCoord.xy) * u_Scale;
+    vec2 high = low + u_Scale;
+
+    ivec2 first = ivec2(floor(low));
+    ivec2 last  = ivec2(ceil(high)) - 1;
+    ivec2 edge  = textureSize(u_Texture, 0) - 1;
+
+    vec4 sum = vec4(0.0);
+    float total = 0.0;
+
+    for(int y = first.y; y <= last.y; ++y)
+    {
+        float wy = min(high.y, float(y + 1)) - max(low.y, float(y));
+
+        for(int x = first.x; x <= last.x; ++x)
+        {
+            float w = (min(high.x, float(x + 1)) - max(low.x, float(x))) * wy;
+
+            sum += texelFetch(u_Texture, min(ivec2(x, y), edge), 0) * w;
+            total += w;
+        }
+    }
+
+    color = sum / total;
+}
@@ -0,0 +1,30 @@
+#shader vertex
+#version 430 core
+
+layout(location = 0) in vec3 position;
+
+layout(std140, binding = 1) uniform FrameUniform
+{
+    mat4 u_VP;
+    vec3 u_CamPos;
+    bool u_DebugNormal;
+    bool u_DebugUV;
+};
+
+uniform vec3 u_Min;
+uniform vec3 u_Max;
+
+void main()
+{
+    gl_Position = u_VP * vec4(mix(u_Min, u_Max, position), 1.0);
+}
+
+
+#shader fragment
+#version 430 core
+
+// Only the samples passing the depth test are counted, nothing is written
+
+void main()
+{
+}
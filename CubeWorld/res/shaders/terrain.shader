@@ -1,27 +1,29 @@
 #shader vertex
 #version 430 core
 
-#define MAX_BLOCKS_IDS 4096
-
 layout(location = 0) in uint data;
 layout(location = 1) in uint data1;
+layout(location = 2) in uint drawIndex; // Same for the whole draw
 
-struct Block
+layout(std140, binding = 1) uniform FrameUniform
 {
-    uvec2 offset; // 1 uint offset + 1 padding
-    vec2 uv;
+    mat4 u_VP;
+    vec3 u_CamPos;
+    bool u_DebugNormal;
+    bool u_DebugUV;
 };
 
-layout(std140, binding = 0) uniform BlockUniform
+// Offset of each chunk drawn by the frame
+layout(std430, binding = 0) readonly buffer ChunkDraws
 {
-    Block data[MAX_BLOCKS_IDS];
-} blocks;
-
-uniform mat4 u_VP;
-
-uniform vec3 u_ChunkOff;
+    vec4 offsets[];
+} draws;
 
-uniform bool u_DebugUV;
+// Atlas layer of every side of every block (id * 6 + side)
+layout(std430, binding = 1) readonly buffer BlockLayers
+{
+    uint layers[];
+} blocks;
 
 const vec2 uvs[4] = vec2[]
 (
@@ -47,8 +49,9 @@ const vec3 normals[6] = vec3[]
 );
 
 out vec2 v_UV;
-out vec2 v_UVOff;
+flat out uint v_Layer;
 out float v_AO;
+out float v_Light;
 
 out vec3 v_Normal;
 out vec3 v_FragPos;
@@ -69,14 +72,21 @@ void main()
 
     uint id = data1 & 0x7FFu;
 
-    vec3 norm = normals[(data1 >> 12) & 0x7u];
+    uint side = (data1 >> 12) & 0x7u;
+    vec3 norm = normals[side];
 
-    vec3 pos = vec3(x, y, z) + u_ChunkOff;
+    // Skylight in the high nibble, block light in the low one, each level 20% darker
+    float sky   = float((data1 >> 20) & 0xFu);
+    float block = float((data1 >> 16) & 0xFu);
+    float light = max(pow(0.8, 15.0 - max(sky, block)), 0.03);
+
+    vec3 pos = vec3(x, y, z) + draws.offsets[drawIndex].xyz;
 
     // Calculate Fragment Color
     v_UV = uv;
-    v_UVOff = blocks.data[blocks.data[id].offset.x].uv;
+    v_Layer = blocks.layers[id * 6u + side];
     v_AO = ao;
+    v_Light = light;
 
     v_Normal = norm;
     v_FragPos = pos;
@@ -91,32 +101,54 @@ void main()
 
 layout(location = 0) out vec4 color;
 
-uniform sampler2D u_Texture;
+// Weighted blended transparency, the translucent pass writes only these
+layout(location = 1) out vec4 accum;
+layout(location = 2) out float revealage;
 
-uniform vec3 u_CamPos;
+uniform sampler2DArray u_Texture;
 
-uniform bool u_DebugNormal;
-uniform bool u_DebugUV;
+layout(std140, binding = 1) uniform FrameUniform
+{
+    mat4 u_VP;
+    vec3 u_CamPos;
+    bool u_DebugNormal;
+    bool u_DebugUV;
+};
 
-uniform vec2 u_Step;
+uniform bool u_WeightedBlend;
 
 in vec2 v_UV;
-in vec2 v_UVOff;
+flat in uint v_Layer;
 in float v_AO;
+in float v_Light;
 
 in vec3 v_Normal;
 in vec3 v_FragPos;
 
+// Premultiplied color weighted by its distance, the nearer faces win (McGuire and Bavoil, equation 7)
+void WriteWeighted()
+{
+    float d = length(v_FragPos - u_CamPos);
+    float weight = clamp(10.0 / (1e-5 + pow(d / 5.0, 2.0) + pow(d / 200.0, 6.0)), 1e-2, 3e3);
+
+    accum = vec4(color.rgb * color.a, color.a) * weight;
+    revealage = color.a;
+}
+
 void main()
 {
     if(u_DebugNormal)
     {
         color = vec4((v_Normal + 1.0) * 0.5, 1.0);
+        if(u_WeightedBlend)
+            WriteWeighted();
         return;
     }
     if(u_DebugUV)
     {
         color = vec4(v_UV, 0.0, 1.0);
+        if(u_WeightedBlend)
+            WriteWeighted();
         return;
     }
 
@@ -132,10 +164,16 @@ void main()
     vec3 diffuse = diff * lightColor;
 
 
-    color = texture(u_Texture, v_UVOff + fract(v_UV) * u_Step);
+    // The layer repeats across a greedy quad, its mip levels are its own
+    color = texture(u_Texture, vec3(v_UV, float(v_Layer)));
     if(color.a == 0)
         discard;
 
     if(color.a == 1)
         color *= vec4((ambient + diffuse) * v_AO, 1.0);
+
+    color.rgb *= v_Light;
+
+    if(u_WeightedBlend)
+        WriteWeighted();
 }
@@ -76,16 +76,14 @@ void Application::Run()
 	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 	ImGuiIO& io = ImGui::GetIO();
 
+	// The loading before does not count as a frame
+	m_Pacer.Reset();
+
 	// Main loop
 	while (!glfwWindowShouldClose(m_WindowHandle))
 	{
-		float time = (float)glfwGetTime();
-		m_DeltaTime = time - m_LastFrameTime;
-
-		if (m_DeltaTime < m_Specification.MaxDeltaTime)
-			continue;
-
-		m_LastFrameTime = time;
+		// Sleeps most of the time left to the frame, the workers get the core
+		m_DeltaTime = m_Pacer.Wait(m_Specification.MaxDeltaTime);
 
 		glfwPollEvents();
 
@@ -102,11 +100,23 @@ void Application::Run()
 
 		m_World->ImGuiRender();
 
+		const FramePacerStats& pacerStats = m_Pacer.GetStats();
+		ImGui::Text("Frame Pacing: slept %.2f ms, spun %.2f ms (sleep error %.0f us)", pacerStats.SleepMillis, pacerStats.SpinMillis, pacerStats.SleepErrorMicros);
+
+		const ShaderCacheStats& shaderStats = Shader::GetCacheStats();
+		ImGui::Text("Startup: first frame in %.0f ms, shaders %.1f ms (%u cached, %u compiled)", m_FirstFrameMillis, shaderStats.Millis, shaderStats.Hits, shaderStats.Misses);
+
 		// Rendering
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 		glfwSwapBuffers(m_WindowHandle);
+
+		if (m_FirstFrameMillis == 0.0f)
+		{
+			m_FirstFrameMillis = m_StartupTimer.ElapsedMillis();
+			std::cout << "First frame in " << m_FirstFrameMillis << " ms, shaders " << shaderStats.Millis << " ms (" << shaderStats.Hits << " cached, " << shaderStats.Misses << " compiled)" << std::endl;
+		}
 	}
 }
 
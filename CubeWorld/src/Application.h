@@ -4,6 +4,9 @@
 
 #include "CubeWorld.h"
 
+#include "utils/FramePacer.h"
+#include "utils/Timer.h"
+
 #include <string>
 
 struct GLFWwindow;
@@ -17,6 +20,10 @@ struct WindowSpecification
 
 	int MaxFps = 120;
 	float MaxDeltaTime = 1.0f / MaxFps;
+
+	// Fixed steps of the world thread (chunk streaming, lighting, LODs), apart from the frames
+	int TickRate = 30;
+	float TickDeltaTime = 1.0f / TickRate;
 };
 
 class Application
@@ -38,7 +45,12 @@ private:
 	GLFWwindow* m_WindowHandle = nullptr;
 
 	CubeWorld* m_World = nullptr;
+
+	FramePacer m_Pacer;
 	
 	float m_DeltaTime = 0.0f;
-	float m_LastFrameTime = 0.0f;
+
+	// From the start of the process to the first frame swapped, the loading included
+	Timer m_StartupTimer;
+	float m_FirstFrameMillis = 0.0f;
 };
@@ -2,21 +2,42 @@
 
 #include "Core.h"
 #include "CubeWorld.h"
+#include "StagingRing.h"
 
 #include "utils/Timer.h"
 #include "utils/Instrumentor.h"
 
 #include "data/BlocksManager.h"
 
+#include "storage/WorldStorage.h"
+
+static inline uint64_t HashMix(uint64_t hash, uint64_t value)
+{
+    hash ^= value * 0x9E3779B97F4A7C15ull;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * 0xBF58476D1CE4E5B9ull;
+}
+
 Chunk::~Chunk()
 {
-	GLCall(glDeleteVertexArrays(2, m_VAO));
-	GLCall(glDeleteBuffers(4, m_VBIO));
+	// Never uploaded (e.g. headless pregeneration), there may be no GL context
+	if (m_VAO[0] || m_VAO[1])
+	{
+		GLCall(glDeleteVertexArrays(2, m_VAO));
+		GLCall(glDeleteBuffers(4, m_VBIO));
+	}
+
+	if (m_SortVAO)
+	{
+		GLCall(glDeleteVertexArrays(1, &m_SortVAO));
+		GLCall(glDeleteBuffers(1, &m_SortIBO));
+	}
 
 	delete[] m_Data;
+	delete[] m_Light;
 }
 
-void Chunk::Fill(SimplexNoise* noise)
+void Chunk::Fill(SimplexNoise* noise, uint32_t seed)
 {
     m_Stage = Stage::Filling;
 
@@ -29,11 +50,12 @@ void Chunk::Fill(SimplexNoise* noise)
 
     float scale = 0.00065f;
 
+    // Each seed samples the noise far from the others, seed 0 is the original world
+    const float seedX = (float)((seed * 73856093u) % 100000u), seedZ = (float)((seed * 19349663u) % 100000u);
+
     for (uint16_t z = 0; z < CHUNK_SIZE; ++z)
         for (uint16_t x = 0; x < CHUNK_SIZE; ++x)
-            data[x + z * CHUNK_SIZE] = (uint16_t)((noise->fractal(5, (x + m_Coord.x) * scale, (z + m_Coord.z) * scale) + 1) * 0.5f * CHUNK_MAX_MOUNTAIN);
-
-    srand(unsigned int(time(NULL)));
+            data[x + z * CHUNK_SIZE] = (uint16_t)((noise->fractal(5, (x + m_Coord.x + seedX) * scale, (z + m_Coord.z + seedZ) * scale) + 1) * 0.5f * CHUNK_MAX_MOUNTAIN);
 
     const Block* dirt    = BlocksManager::GetBlock("Dirt");
     const Block* grass   = BlocksManager::GetBlock("Grass");
@@ -52,7 +74,9 @@ void Chunk::Fill(SimplexNoise* noise)
         {
             int maxH = data[x + z * CHUNK_SIZE];
 
-            rnd = rand() % 100;
+            // Same column, same seed, same value: on any thread, in the game and in --pregen
+            const uint64_t column = HashMix(HashMix(seed, (uint64_t)(int64_t)(x + m_Coord.x)), (uint64_t)(int64_t)(z + m_Coord.z));
+            rnd = (int)((column >> 32) % 100);
 
             for (int y = 0; y < CHUNK_SIZE; y++)
             {
@@ -101,7 +125,47 @@ void Chunk::Fill(SimplexNoise* noise)
     m_Stage = Stage::Filled;
 }
 
-void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
+bool Chunk::Load(WorldStorage* storage)
+{
+    if (!storage->HasChunk(m_Coord))
+        return false;
+
+    m_Stage = Stage::Filling;
+
+    m_Data = new ChunkBlock[CHUNK_SIZEQ];
+    if (!storage->LoadChunk(m_Coord, m_Data))
+    {
+        delete[] m_Data;
+        m_Data = nullptr;
+
+        m_Stage = Stage::Initialized;
+        return false;
+    }
+
+    m_Stage = Stage::Filled;
+    return true;
+}
+
+bool Chunk::Snapshot(ChunkBlock* data)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    if (!m_Modified || m_Data == nullptr)
+        return false;
+
+    memcpy(data, m_Data, CHUNK_SIZEQ * sizeof(ChunkBlock));
+
+    m_Modified = false;
+    return true;
+}
+
+void Chunk::RestoreModified()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Modified = true;
+}
+
+void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh, bool sections)
 {
     m_Stage = Stage::Building;
 
@@ -116,7 +180,67 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
         return;
     }
 
-    int i, j, k, l, w, h, u, v, n = 0;
+    GenerateMesh(chunks, mesh, sections);
+}
+
+void Chunk::GenerateMesh(Chunk* chunks[27], Mesh& mesh, bool sections)
+{
+    m_Stage = Stage::Building;
+
+    if (sections)
+    {
+        for (int s = 0; s < SECTION_COUNT; ++s)
+            GenerateSection(chunks, s, mesh);
+    }
+    else
+        GenerateSlices(chunks, glm::ivec3{ 0 }, glm::ivec3{ CHUNK_SIZE - 1 }, mesh);
+
+    mesh.sections = sections;
+
+    m_Stage = Stage::Built;
+}
+
+void Chunk::GenerateSection(Chunk* chunks[27], int section, Mesh& mesh)
+{
+    const glm::ivec3 from = glm::ivec3{ section % SECTION_AXIS, (section / SECTION_AXIS) % SECTION_AXIS, section / (SECTION_AXIS * SECTION_AXIS) } * SECTION_SIZE;
+    const glm::ivec3 to = from + (SECTION_SIZE - 1);
+
+    // A front face is in the plane of its block, a back face in the one before it,
+    // the faces against the neighbor chunks go to the sections on the border
+    FaceRange range;
+    for (int d = 0; d < 3; ++d)
+    {
+        range.planeFrom[0][d] = from[d] == 0 ? -1 : from[d];
+        range.planeTo  [0][d] = to[d];
+        range.planeFrom[1][d] = from[d] - 1;
+        range.planeTo  [1][d] = to[d] == CHUNK_SIZE - 1 ? CHUNK_SIZE - 1 : to[d] - 1;
+    }
+
+    range.from = from;
+    range.to   = to;
+
+    GenerateFaces(chunks, range, mesh);
+}
+
+void Chunk::GenerateSlices(Chunk* chunks[27], const glm::ivec3& from, const glm::ivec3& to, Mesh& mesh)
+{
+    // The faces of a block and the AO of the faces in front of it are in the plane before and after it
+    FaceRange range;
+    for (int d = 0; d < 3; ++d)
+    {
+        range.planeFrom[0][d] = range.planeFrom[1][d] = from[d] > 0 ? from[d] - 1 : -1;
+        range.planeTo  [0][d] = range.planeTo  [1][d] = to[d] < CHUNK_SIZE - 1 ? to[d] : CHUNK_SIZE - 1;
+    }
+
+    range.from = glm::ivec3{ 0 };
+    range.to   = glm::ivec3{ CHUNK_SIZE - 1 };
+
+    GenerateFaces(chunks, range, mesh);
+}
+
+void Chunk::GenerateFaces(Chunk* chunks[27], const FaceRange& range, Mesh& mesh)
+{
+    int u, v, n = 0;
     FaceSide side;
 
     int x []{ 0, 0, 0 };
@@ -131,7 +255,8 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
     ChunkBlock voxelFace, voxelFace1;
     Block* blockFace, *blockFace1;
 
-    uint32_t indicesCount = 0, indicesTCount = 0;
+    // Appended after the quads already in the mesh
+    uint32_t indicesCount = (uint32_t)(mesh.vertices.size() / 2), indicesTCount = (uint32_t)(mesh.tvertices.size() / 2);
 
     for (bool backFace = true, b = false; b != backFace; backFace = backFace && b, b = !b)
         for (int d = 0; d < 3; ++d)
@@ -155,10 +280,10 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
             case 2: side = backFace ? FaceSide::Back   : FaceSide::Front; break;
             }
 
-            for (x[d] = -1; x[d] < CHUNK_SIZE;)
-            {
-                n = 0;
+            const int planeFrom = range.planeFrom[backFace][d], planeTo = range.planeTo[backFace][d];
 
+            for (x[d] = planeFrom; x[d] <= planeTo;)
+            {
                 du[0] = 0;
                 du[1] = 0;
                 du[2] = 0;
@@ -169,9 +294,11 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
                 dv[2] = 0;
                 dv[v] = 1;
 
-                for (x[v] = 0; x[v] < CHUNK_SIZE; ++x[v])
-                    for (x[u] = 0; x[u] < CHUNK_SIZE; ++x[u])
+                for (x[v] = range.from[v]; x[v] <= range.to[v]; ++x[v])
+                    for (x[u] = range.from[u]; x[u] <= range.to[u]; ++x[u])
                     {
+                        n = x[v] * CHUNK_SIZE + x[u];
+
                         voxelFace  = (x[d] >= 0)             ? m_Data[ID(x[0], x[1], x[2])]
                             : GetNeighborBlock(chunks, x, d, false, CHUNK_SIZE - 1);
                         voxelFace1 = (x[d] < CHUNK_SIZE - 1) ? m_Data[ID(x[0] + q[0], x[1] + q[1], x[2] + q[2])]
@@ -179,8 +306,8 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
 
                         if (voxelFace == voxelFace1)
                         {
-                            mask[n].ao.data      = 0x03030303;
-                            mask[n++].block.data = 0;
+                            mask[n].ao.data    = 0x03030303;
+                            mask[n].block.data = 0;
                             continue;
                         }
 
@@ -205,325 +332,1363 @@ void Chunk::GenerateMesh(CubeWorld* world, Mesh& mesh)
                         blockFace1 = BlocksManager::GetBlock(voxelFace1);
                         if (!blockFace1->m_IsTransparent)
                         {
-                            mask[n].ao.data = 0x03030303;
-                            mask[n++].block.data = 0;
+                            mask[n].ao.data    = 0x03030303;
+                            mask[n].block.data = 0;
                             continue;
                         }
 
                         CalculateAO(chunks, mask[n].ao, dt[0], dt[1], dt[2], du, dv);
 
-                        mask[n++].block = std::move(voxelFace);
+                        // Light of the block in front of the face
+                        mask[n].light = GetNeighborLight(chunks, dt[0], dt[1], dt[2]);
+
+                        mask[n].block = std::move(voxelFace);
                     }
 
                 ++x[d];
 
-                n = 0;
-                for (j = 0; j < CHUNK_SIZE; ++j)
-                    for (i = 0; i < CHUNK_SIZE;)
-                    {
-                        if (!mask[n].block.data)
-                        {
-                            ++i;
-                            ++n;
-                            continue;
-                        }
+                MergeFaces(mask, CHUNK_SIZE, 1, x, d, side, backFace, range.from, range.to, mesh, indicesCount, indicesTCount);
+            }
+        }
+}
 
-                        for (w = 1; i + w < CHUNK_SIZE && mask[n + w].block.data && mask[n + w] == mask[n]; ++w);
+void Chunk::MergeFaces(FaceMask* mask, int stride, int scale, int x[3], int d, FaceSide side, bool backFace,
+    const glm::ivec3& from, const glm::ivec3& to, Mesh& mesh, uint32_t& indicesCount, uint32_t& indicesTCount)
+{
+    int i, j, k, l, w, h, n;
 
-                        bool done = false;
+    const int u = (d + 1) % 3;
+    const int v = (d + 2) % 3;
 
-                        for (h = 1; j + h < CHUNK_SIZE; ++h)
-                        {
-                            for (k = 0; k < w; ++k)
-                            {
-                                int indx = n + k + h * CHUNK_SIZE;
-                                if (!mask[indx].block.data || mask[indx] != mask[n]) { done = true; break; }
-                            }
+    int p []{ 0, 0, 0 };
+    int du[]{ 0, 0, 0 };
+    int dv[]{ 0, 0, 0 };
 
-                            if (done) break;
-                        }
+    for (j = from[v]; j <= to[v]; ++j)
+        for (i = from[u], n = j * stride + i; i <= to[u];)
+        {
+            if (!mask[n].block.data)
+            {
+                ++i;
+                ++n;
+                continue;
+            }
 
-                        //if (!mask[n]->transparent)
-                        if (true)
-                        {
-                            x[u] = i;
-                            x[v] = j;
-
-                            du[u] = w;
-                            dv[v] = h;
-
-                            const ChunkBlock& chunkBlock = mask[n].block;
-                            const AO& ao = mask[n].ao;
-
-                            int mW = h - 1, mH = w - 1;
-
-                            const uint32_t id = chunkBlock.GetID();
-                            const Block* block = BlocksManager::GetBlock(id);
-
-                            bool isFaceFlip = d != 0;
-                            if (isFaceFlip) // Is Flip
-                            {
-                                int temp = mH;
-                                mH = mW;
-                                mW = temp;
-                            }
-
-                            bool isTranslucent = block->m_IsTranslucent;
-
-                            std::vector<uint32_t>& vertices = isTranslucent ? mesh.tvertices : mesh.vertices;
-                            std::vector<uint32_t>& indices  = isTranslucent ? mesh.tindices  : mesh.indices;
-
-                            uint32_t& verticesCount = isTranslucent ? indicesTCount : indicesCount;
-
-                            vertices.push_back(VBO(x[0],                 x[1],                 x[2],                 mW, mH, 0, ao.vertices.v0));
-                            vertices.push_back(VBO1(id, side));
-
-                            if (isFaceFlip)
-                            {
-                                vertices.push_back(VBO(x[0] + dv[0], x[1] + dv[1], x[2] + dv[2], mW, mH, 2, ao.vertices.v1));
-                                vertices.push_back(VBO1(id, side));
-                                vertices.push_back(VBO(x[0] + du[0], x[1] + du[1], x[2] + du[2], mW, mH, 1, ao.vertices.v2));
-                                vertices.push_back(VBO1(id, side));
-                            }
-                            else
-                            {
-                                vertices.push_back(VBO(x[0] + dv[0], x[1] + dv[1], x[2] + dv[2], mW, mH, 1, ao.vertices.v1));
-                                vertices.push_back(VBO1(id, side));
-                                vertices.push_back(VBO(x[0] + du[0], x[1] + du[1], x[2] + du[2], mW, mH, 2, ao.vertices.v2));
-                                vertices.push_back(VBO1(id, side));
-                            }
-
-                            vertices.push_back(VBO(x[0] + du[0] + dv[0], x[1] + du[1] + dv[1], x[2] + du[2] + dv[2], mW, mH, 3, ao.vertices.v3));
-                            vertices.push_back(VBO1(id, side));
-
-                            bool flip = ao.vertices.v0 + ao.vertices.v3 > ao.vertices.v1 + ao.vertices.v2;
-
-                            if (backFace)
-                            {
-                                if (flip)
-                                {
-                                    indices.push_back(verticesCount + 3);
-                                    indices.push_back(verticesCount + 2);
-                                    indices.push_back(verticesCount);
-                                    indices.push_back(verticesCount);
-                                    indices.push_back(verticesCount + 1);
-                                    indices.push_back(verticesCount + 3);
-                                }
-                                else
-                                {
-                                    indices.push_back(verticesCount + 2);
-                                    indices.push_back(verticesCount);
-                                    indices.push_back(verticesCount + 1);
-                                    indices.push_back(verticesCount + 1);
-                                    indices.push_back(verticesCount + 3);
-                                    indices.push_back(verticesCount + 2);
-                                }
-                            }
-                            else if (flip) // flip triangles
-                            {
-                                indices.push_back(verticesCount);
-                                indices.push_back(verticesCount + 2);
-                                indices.push_back(verticesCount + 3);
-                                indices.push_back(verticesCount + 3);
-                                indices.push_back(verticesCount + 1);
-                                indices.push_back(verticesCount);
-                            }
-                            else
-                            {
-                                indices.push_back(verticesCount + 2);
-                                indices.push_back(verticesCount + 3);
-                                indices.push_back(verticesCount + 1);
-                                indices.push_back(verticesCount + 1);
-                                indices.push_back(verticesCount);
-                                indices.push_back(verticesCount + 2);
-                            }
-
-                            verticesCount += 4;
-                        }
-                        for (l = 0; l < h; ++l)
-                            for (k = 0; k < w; ++k)
-                                mask[n + k + l * CHUNK_SIZE].reset();
-                        
-                        i += w;
-                        n += w;
+            for (w = 1; i + w <= to[u] && mask[n + w].block.data && mask[n + w] == mask[n]; ++w);
+
+            bool done = false;
+
+            for (h = 1; j + h <= to[v]; ++h)
+            {
+                for (k = 0; k < w; ++k)
+                {
+                    int indx = n + k + h * stride;
+                    if (!mask[indx].block.data || mask[indx] != mask[n]) { done = true; break; }
+                }
+
+                if (done) break;
+            }
+
+            //if (!mask[n]->transparent)
+            if (true)
+            {
+                x[u] = i;
+                x[v] = j;
+
+                // A downsampled cell covers scale blocks
+                p[0] = x[0] * scale;
+                p[1] = x[1] * scale;
+                p[2] = x[2] * scale;
+
+                du[u] = w * scale;
+                dv[v] = h * scale;
+
+                const ChunkBlock& chunkBlock = mask[n].block;
+                const AO& ao = mask[n].ao;
+                const uint32_t light = mask[n].light;
+
+                int mW = h * scale - 1, mH = w * scale - 1;
+
+                const uint32_t id = chunkBlock.GetID();
+                const Block* block = BlocksManager::GetBlock(id);
+
+                bool isFaceFlip = d != 0;
+                if (isFaceFlip) // Is Flip
+                {
+                    int temp = mH;
+                    mH = mW;
+                    mW = temp;
+                }
+
+                bool isTranslucent = block->m_IsTranslucent;
+
+                std::vector<uint32_t>& vertices = isTranslucent ? mesh.tvertices : mesh.vertices;
+                std::vector<uint32_t>& indices  = isTranslucent ? mesh.tindices  : mesh.indices;
+
+                uint32_t& verticesCount = isTranslucent ? indicesTCount : indicesCount;
+
+                vertices.push_back(VBO(p[0],                 p[1],                 p[2],                 mW, mH, 0, ao.vertices.v0));
+                vertices.push_back(VBO1(id, side, light));
+
+                if (isFaceFlip)
+                {
+                    vertices.push_back(VBO(p[0] + dv[0], p[1] + dv[1], p[2] + dv[2], mW, mH, 2, ao.vertices.v1));
+                    vertices.push_back(VBO1(id, side, light));
+                    vertices.push_back(VBO(p[0] + du[0], p[1] + du[1], p[2] + du[2], mW, mH, 1, ao.vertices.v2));
+                    vertices.push_back(VBO1(id, side, light));
+                }
+                else
+                {
+                    vertices.push_back(VBO(p[0] + dv[0], p[1] + dv[1], p[2] + dv[2], mW, mH, 1, ao.vertices.v1));
+                    vertices.push_back(VBO1(id, side, light));
+                    vertices.push_back(VBO(p[0] + du[0], p[1] + du[1], p[2] + du[2], mW, mH, 2, ao.vertices.v2));
+                    vertices.push_back(VBO1(id, side, light));
+                }
+
+                vertices.push_back(VBO(p[0] + du[0] + dv[0], p[1] + du[1] + dv[1], p[2] + du[2] + dv[2], mW, mH, 3, ao.vertices.v3));
+                vertices.push_back(VBO1(id, side, light));
+
+                bool flip = ao.vertices.v0 + ao.vertices.v3 > ao.vertices.v1 + ao.vertices.v2;
+
+                if (backFace)
+                {
+                    if (flip)
+                    {
+                        indices.push_back(verticesCount + 3);
+                        indices.push_back(verticesCount + 2);
+                        indices.push_back(verticesCount);
+                        indices.push_back(verticesCount);
+                        indices.push_back(verticesCount + 1);
+                        indices.push_back(verticesCount + 3);
                     }
+                    else
+                    {
+                        indices.push_back(verticesCount + 2);
+                        indices.push_back(verticesCount);
+                        indices.push_back(verticesCount + 1);
+                        indices.push_back(verticesCount + 1);
+                        indices.push_back(verticesCount + 3);
+                        indices.push_back(verticesCount + 2);
+                    }
+                }
+                else if (flip) // flip triangles
+                {
+                    indices.push_back(verticesCount);
+                    indices.push_back(verticesCount + 2);
+                    indices.push_back(verticesCount + 3);
+                    indices.push_back(verticesCount + 3);
+                    indices.push_back(verticesCount + 1);
+                    indices.push_back(verticesCount);
+                }
+                else
+                {
+                    indices.push_back(verticesCount + 2);
+                    indices.push_back(verticesCount + 3);
+                    indices.push_back(verticesCount + 1);
+                    indices.push_back(verticesCount + 1);
+                    indices.push_back(verticesCount);
+                    indices.push_back(verticesCount + 2);
+                }
+
+                verticesCount += 4;
             }
+            for (l = 0; l < h; ++l)
+                for (k = 0; k < w; ++k)
+                    mask[n + k + l * stride].reset();
+            
+            i += w;
+            n += w;
         }
-    
-    m_Stage = Stage::Built;
 }
 
-void Chunk::UploadMesh(const Mesh& mesh)
+void Chunk::GenerateLodMesh(Chunk* chunks[27], int lod, Mesh& mesh)
 {
-    if (m_Stage != Stage::Built && m_Stage != Stage::Uploaded)
-        return;
+    m_Stage = Stage::Building;
 
-    m_IndicesCount = (uint32_t)mesh.indices.size();
-    if (m_IndicesCount > 0)
-    {
-        if (m_BufferSize == 0) // Create new buffer
-        {
-            GLCall(glGenVertexArrays(1, m_VAO));
-            GLCall(glGenBuffers(2, m_VBIO));
+    mesh.lod = lod;
 
-            // Opaque
-            GLCall(glBindVertexArray(m_VAO[0]));
+    const int scale = 1 << lod, size = CHUNK_SIZE >> lod;
 
-            m_BufferSize = (uint32_t)mesh.vertices.size();
+    // The cells of the chunk and one layer of cells of its neighbors around them
+    const int volumeSize = size + 2;
+    std::vector<ChunkBlock> cells((size_t)volumeSize * volumeSize * volumeSize);
+    std::vector<uint8_t>    light((size_t)volumeSize * volumeSize * volumeSize);
 
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[0]));
-            GLCall(glBufferData(GL_ARRAY_BUFFER, m_BufferSize * sizeof(uint32_t), &mesh.vertices[0], GL_STATIC_DRAW));
-            GLCall(glEnableVertexAttribArray(0));
-            GLCall(glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)0));
-            GLCall(glEnableVertexAttribArray(1));
-            GLCall(glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)(sizeof(uint32_t))));
+    const auto cellIndex = [volumeSize](int x, int y, int z) { return (x + 1) + (y + 1) * volumeSize + (z + 1) * volumeSize * volumeSize; };
 
-            GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[1]));
-            GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_IndicesCount * sizeof(uint32_t), &mesh.indices[0], GL_STATIC_DRAW));
-        }
-        else if (m_BufferSize < mesh.vertices.size())
-        {
-            m_BufferSize = (uint32_t)mesh.vertices.size();
+    for (int z = -1; z <= size; ++z)
+        for (int y = -1; y <= size; ++y)
+            for (int x = -1; x <= size; ++x)
+            {
+                const int index = cellIndex(x, y, z);
+                DownsampleCell(chunks, glm::ivec3{ x, y, z } * scale, scale, cells[index], light[index]);
+            }
 
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[0]));
-            GLCall(glBufferData(GL_ARRAY_BUFFER, m_BufferSize * sizeof(uint32_t), &mesh.vertices[0], GL_STATIC_DRAW));
+    int u, v;
+    FaceSide side;
 
-            GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[1]));
-            GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_IndicesCount * sizeof(uint32_t), &mesh.indices[0], GL_STATIC_DRAW));
-        }
-        else
-        {
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[0]));
-            GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.vertices.size() * sizeof(uint32_t), &mesh.vertices[0]));
+    int x[]{ 0, 0, 0 };
+    int q[]{ 0, 0, 0 };
+    int dt[]{ 0, 0, 0 };
 
-            GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[1]));
-            GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mesh.indices.size() * sizeof(uint32_t), &mesh.indices[0]));
-        }
-    }
+    FaceMask mask[CHUNK_SIZES];
+    memset(mask, 0, CHUNK_SIZES * sizeof(FaceMask));
 
+    ChunkBlock voxelFace, voxelFace1;
 
-    // Translucent
-    m_TIndicesCount = (uint32_t)mesh.tindices.size();
-    if (m_TIndicesCount > 0)
-    {
-        if (m_TBufferSize == 0) // Create new buffer
+    uint32_t indicesCount = (uint32_t)(mesh.vertices.size() / 2), indicesTCount = (uint32_t)(mesh.tvertices.size() / 2);
+
+    const glm::ivec3 from{ 0 }, to{ size - 1 };
+
+    for (bool backFace = true, b = false; b != backFace; backFace = backFace && b, b = !b)
+        for (int d = 0; d < 3; ++d)
         {
-            GLCall(glGenVertexArrays(1, m_VAO + 1));
-            GLCall(glGenBuffers(2, m_VBIO + 2));
+            u = (d + 1) % 3;
+            v = (d + 2) % 3;
 
-            // Opaque
-            GLCall(glBindVertexArray(m_VAO[1]));
+            q[0] = 0;
+            q[1] = 0;
+            q[2] = 0;
+            q[d] = 1;
 
-            m_TBufferSize = (uint32_t)mesh.tvertices.size();
+            switch (d)
+            {
+            case 0: side = backFace ? FaceSide::Left   : FaceSide::Right; break;
+            case 1: side = backFace ? FaceSide::Bottom : FaceSide::Top;   break;
+            case 2: side = backFace ? FaceSide::Back   : FaceSide::Front; break;
+            }
 
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[2]));
-            GLCall(glBufferData(GL_ARRAY_BUFFER, m_TBufferSize * sizeof(uint32_t), &mesh.tvertices[0], GL_STATIC_DRAW));
-            GLCall(glEnableVertexAttribArray(0));
-            GLCall(glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)0));
-            GLCall(glEnableVertexAttribArray(1));
-            GLCall(glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)(sizeof(uint32_t))));
+            // Skirt: an opaque cell on a side of the chunk always gets its face, it covers the
+            // cracks against a neighbor meshed at another level
+            const bool isSide = d != 1;
 
-            GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[3]));
-            GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_TIndicesCount * sizeof(uint32_t), &mesh.tindices[0], GL_STATIC_DRAW));
-        }
-        else if (m_TBufferSize < mesh.tvertices.size())
-        {
-            m_TBufferSize = (uint32_t)mesh.tvertices.size();
+            for (x[d] = -1; x[d] <= size - 1;)
+            {
+                for (x[v] = 0; x[v] < size; ++x[v])
+                    for (x[u] = 0; x[u] < size; ++x[u])
+                    {
+                        const int n = x[v] * size + x[u];
 
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[2]));
-            GLCall(glBufferData(GL_ARRAY_BUFFER, m_TBufferSize * sizeof(uint32_t), &mesh.tvertices[0], GL_STATIC_DRAW));
+                        voxelFace  = cells[cellIndex(x[0], x[1], x[2])];
+                        voxelFace1 = cells[cellIndex(x[0] + q[0], x[1] + q[1], x[2] + q[2])];
 
-            GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[3]));
-            GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_TIndicesCount * sizeof(uint32_t), &mesh.tindices[0], GL_STATIC_DRAW));
-        }
-        else
-        {
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[2]));
-            GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.tvertices.size() * sizeof(uint32_t), &mesh.tvertices[0]));
+                        if (isSide && x[d] == -1        && !BlocksManager::GetBlock(voxelFace1)->m_IsTransparent) voxelFace .data = 0;
+                        if (isSide && x[d] == size - 1 && !BlocksManager::GetBlock(voxelFace )->m_IsTransparent) voxelFace1.data = 0;
+
+                        mask[n].ao.data = 0x03030303;
+
+                        if (voxelFace == voxelFace1)
+                        {
+                            mask[n].block.data = 0;
+                            continue;
+                        }
+
+                        if (backFace)
+                        {
+                            dt[0] = x[0];
+                            dt[1] = x[1];
+                            dt[2] = x[2];
+
+                            ChunkBlock temp = voxelFace1;
+                            voxelFace1 = voxelFace;
+                            voxelFace = temp;
+                        }
+                        else
+                        {
+                            dt[0] = x[0] + q[0];
+                            dt[1] = x[1] + q[1];
+                            dt[2] = x[2] + q[2];
+                        }
+
+                        if (!BlocksManager::GetBlock(voxelFace1)->m_IsTransparent)
+                        {
+                            mask[n].block.data = 0;
+                            continue;
+                        }
+
+                        // No AO, the cells are smaller than the shading it would add
+                        mask[n].light = light[cellIndex(dt[0], dt[1], dt[2])];
+                        mask[n].block = voxelFace;
+                    }
 
-            GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[3]));
-            GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, mesh.tindices.size() * sizeof(uint32_t), &mesh.tindices[0]));
+                ++x[d];
+
+                MergeFaces(mask, size, scale, x, d, side, backFace, from, to, mesh, indicesCount, indicesTCount);
+            }
         }
-    }
 
-    m_Stage = Stage::Uploaded;
+    m_Stage = Stage::Built;
 }
 
-void Chunk::Render(Shader* shader) const
+void Chunk::DownsampleCell(Chunk* chunks[27], const glm::ivec3& origin, int scale, ChunkBlock& cell, uint8_t& light) const
 {
-    if (m_IndicesCount == 0)
-        return;
+    // The cell takes the top block of its solid part if the blocks are mostly solid (air otherwise),
+    // and the brightest sky and block light of its blocks
+    int solid = 0;
+    uint8_t sky = 0, block = 0;
+
+    cell.data = 0;
+
+    for (int y = origin.y + scale - 1; y >= origin.y; --y)
+        for (int z = origin.z; z < origin.z + scale; ++z)
+            for (int x = origin.x; x < origin.x + scale; ++x)
+            {
+                // Outside the chunk: the neighbor, nothing above and below the world
+                const int cx = x < 0 ? 0 : x >= CHUNK_SIZE ? 2 : 1;
+                const int cy = y < 0 ? 0 : y >= CHUNK_SIZE ? 2 : 1;
+                const int cz = z < 0 ? 0 : z >= CHUNK_SIZE ? 2 : 1;
+
+                // Not set above and below the world
+                const int worldY = (int)m_Coord.y + y;
+
+                const Chunk* chunk = cx == 1 && cy == 1 && cz == 1 ? this : chunks[cz * 9 + cy * 3 + cx];
+                if (worldY < 0 || worldY >= CHUNK_MAX_HEIGHT)
+                {
+                    sky = LIGHT_MAX;
+                    continue;
+                }
+
+                const int index = ID(x - (cx - 1) * CHUNK_SIZE, y - (cy - 1) * CHUNK_SIZE, z - (cz - 1) * CHUNK_SIZE);
+
+                const ChunkBlock chunkBlock = chunk->GetBlock(index);
+                if (chunkBlock.data != 0)
+                {
+                    if (solid++ == 0)
+                        cell = chunkBlock;
+                }
+
+                const uint8_t blockLight = chunk->GetLight(index);
+                sky   = LIGHT_SKY  (blockLight) > sky   ? LIGHT_SKY  (blockLight) : sky;
+                block = LIGHT_BLOCK(blockLight) > block ? LIGHT_BLOCK(blockLight) : block;
+            }
 
-    shader->SetUniform3f("u_ChunkOff", m_Coord.x, m_Coord.y, m_Coord.z);
+    if (solid * 2 < scale * scale * scale)
+        cell.data = 0;
 
-    GLCall(glBindVertexArray(m_VAO[0]));
-    GLCall(glDrawElements(GL_TRIANGLES, m_IndicesCount, GL_UNSIGNED_INT, (void*)0));
+    light = (sky << 4) | block;
 }
 
-void Chunk::RenderT(Shader* shader) const
+uint64_t Chunk::ContentHash(Chunk* chunks[27]) const
 {
-    if (m_TIndicesCount == 0)
-        return;
+    uint64_t hash = HashMix(0, CHUNK_SIZEQ);
+
+    const uint64_t* words = (const uint64_t*)m_Data;
+    for (size_t i = 0; i < CHUNK_SIZEQ * sizeof(ChunkBlock) / sizeof(uint64_t); ++i)
+        hash = HashMix(hash, words[i]);
+
+    if (m_Light)
+    {
+        words = (const uint64_t*)m_Light;
+        for (size_t i = 0; i < CHUNK_SIZEQ / sizeof(uint64_t); ++i)
+            hash = HashMix(hash, words[i]);
+    }
 
-    shader->SetUniform3f("u_ChunkOff", m_Coord.x, m_Coord.y, m_Coord.z);
+    // Faces, AO and light read one layer of blocks of every neighbor, none above and below the world
+    for (int i = 0; i < 27; ++i)
+    {
+        const int dx = i % 3 - 1, dy = (i / 3) % 3 - 1, dz = i / 9 - 1;
+        const int neighborY = (int)m_Coord.y + dy * CHUNK_SIZE;
+        if (i == 13 || neighborY < 0 || neighborY >= CHUNK_MAX_HEIGHT)
+            continue;
+
+        const Chunk* chunk = chunks[i];
+
+        const int x0 = dx < 0 ? CHUNK_SIZE - 1 : 0, x1 = dx > 0 ? 1 : CHUNK_SIZE;
+        const int y0 = dy < 0 ? CHUNK_SIZE - 1 : 0, y1 = dy > 0 ? 1 : CHUNK_SIZE;
+        const int z0 = dz < 0 ? CHUNK_SIZE - 1 : 0, z1 = dz > 0 ? 1 : CHUNK_SIZE;
+
+        for (int z = z0; z < z1; ++z)
+            for (int x = x0; x < x1; ++x)
+                for (int y = y0; y < y1; ++y)
+                {
+                    const int index = ID(x, y, z);
+                    hash = HashMix(hash, chunk->GetBlock(index).data | ((uint64_t)chunk->GetLight(index) << 32));
+                }
+    }
 
-    GLCall(glBindVertexArray(m_VAO[1]));
-    GLCall(glDrawElements(GL_TRIANGLES, m_TIndicesCount, GL_UNSIGNED_INT, (void*)0));
+    return hash;
 }
 
-ChunkBlock Chunk::GetNeighborBlock(Chunk* chunks[26], int x[3], int d, bool isNeighF, int v) const
+void Chunk::UpdateVisibility()
 {
-    int neighborIndex = 0, x_ = x[0], y_ = x[1], z_ = x[2];
-    if (d == 0) { neighborIndex = isNeighF ? 14 : 12; x_ = v; }
-    else if (d == 1)
+    if (m_Data == nullptr)
+        return;
+
+    // Opaque blocks start as visited
+    std::vector<uint8_t> visited(CHUNK_SIZEQ);
+
+    int open = 0;
+    for (int i = 0; i < CHUNK_SIZEQ; ++i)
     {
-        if (isNeighF)
-        {
-            if (m_Coord.y == CHUNK_MAX_HEIGHT - CHUNK_SIZE)
-                return ChunkBlock{};
+        visited[i] = !BlocksManager::GetBlock(m_Data[i])->m_IsTransparent;
+        open += !visited[i];
+    }
 
-            neighborIndex = 16;
-        }
-        else
-        {
-            if (m_Coord.y == 0)
-                return ChunkBlock{};
+    // The lowest run of opaque blocks from the bottom among the columns of each cell
+    uint64_t heights[OCCLUDER_CELLS / 8]{};
+    for (int cell = 0; cell < OCCLUDER_CELLS; ++cell)
+    {
+        int height = CHUNK_SIZE;
+        for (int z = 0; z < OCCLUDER_CELL && open > 0; ++z)
+            for (int x = 0; x < OCCLUDER_CELL; ++x)
+            {
+                const int column = ID(cell % OCCLUDER_AXIS * OCCLUDER_CELL + x, 0, cell / OCCLUDER_AXIS * OCCLUDER_CELL + z);
 
-            neighborIndex = 10;
-        }
-        y_ = v;
+                int y = 0;
+                while (y < height && visited[column + y])
+                    ++y;
+
+                height = y;
+            }
+
+        heights[cell / 8] |= (uint64_t)(open == CHUNK_SIZEQ ? 0 : height) << (cell % 8 * 8);
     }
-    else { neighborIndex = isNeighF ? 22 : 4; z_ = v; }
 
-    return chunks[neighborIndex]->GetBlock(ID(x_, y_, z_));
-}
+    for (int i = 0; i < OCCLUDER_CELLS / 8; ++i)
+        m_SolidHeights[i] = heights[i];
 
-void Chunk::RemoveTileEntity(const glm::vec3& coord)
-{
-    m_TileEntitiesToRemove.push(coord);
-}
+    // Air or solid chunks connect everything or nothing
+    if (open == 0 || open == CHUNK_SIZEQ)
+    {
+        m_Visibility = open ? ~0ull : 0ull;
+        return;
+    }
 
-void Chunk::Update(CubeWorld* world)
-{
-    for (auto& [_, tileEntity] : m_TileEntities)
-        tileEntity->Update(world);
-}
+    std::vector<uint16_t> stack;
+    stack.reserve(CHUNK_SIZEQ);
 
-void Chunk::PostUpdate()
-{
-    while (m_TileEntitiesToRemove.size() > 0)
+    // Every group of connected open blocks connects all the faces it touches
+    uint64_t visibility = 0;
+    for (int start = 0; start < CHUNK_SIZEQ; ++start)
     {
-        const glm::vec3& coord = m_TileEntitiesToRemove.front();
-        m_TileEntities.erase(coord);
+        if (visited[start])
+            continue;
 
-        m_TileEntitiesToRemove.pop();
+        visited[start] = true;
+        stack.push_back((uint16_t)start);
+
+        uint8_t faces = 0;
+        while (!stack.empty())
+        {
+            const int index = stack.back();
+            stack.pop_back();
+
+            const int y = index % CHUNK_SIZE, x = (index / CHUNK_SIZE) % CHUNK_SIZE, z = index / (CHUNK_SIZES);
+
+            faces |= (z == CHUNK_SIZE - 1) << FaceSide::Front;
+            faces |= (z == 0)              << FaceSide::Back;
+            faces |= (y == CHUNK_SIZE - 1) << FaceSide::Top;
+            faces |= (y == 0)              << FaceSide::Bottom;
+            faces |= (x == CHUNK_SIZE - 1) << FaceSide::Right;
+            faces |= (x == 0)              << FaceSide::Left;
+
+            const int neighbors[6][2]{ { z < CHUNK_SIZE - 1, index + CHUNK_SIZES }, { z > 0, index - CHUNK_SIZES },
+                                       { y < CHUNK_SIZE - 1, index + 1 },           { y > 0, index - 1 },
+                                       { x < CHUNK_SIZE - 1, index + CHUNK_SIZE },  { x > 0, index - CHUNK_SIZE } };
+
+            for (const auto& [inside, neighbor] : neighbors)
+                if (inside && !visited[neighbor])
+                {
+                    visited[neighbor] = true;
+                    stack.push_back((uint16_t)neighbor);
+                }
+        }
+
+        for (int from = 0; from < MESH_SIDES; ++from)
+            if (faces & (1 << from))
+                visibility |= (uint64_t)faces << (from * MESH_SIDES);
+
+        // Everything is connected already
+        if (faces == 0x3F)
+            break;
     }
+
+    m_Visibility = visibility;
 }
 
-void Chunk::CalculateAO(Chunk* chunks[26], AO& ao, int x, int y, int z, int du[3], int dv[3]) const
+void Chunk::PrepareUpload(MeshUpload& upload, StagingRing* staging)
 {
-    // V0 (0, 0)
-    int sMV = GetAONeighborBlock(chunks, x - dv[0], y - dv[1], z - dv[2]);
+    Mesh& mesh = upload.mesh;
+
+    const std::vector<uint32_t>* meshVertices[2] = { &mesh.vertices, &mesh.tvertices };
+    const std::vector<uint32_t>* meshIndices[2]  = { &mesh.indices,  &mesh.tindices };
+
+    // The sizes of the layouts first, the quads are laid out straight into the reserved ring space
+    std::vector<uint8_t> quadRanges[2];
+    uint32_t totals[2];
+
+    size_t bytes = 0;
+    for (int stream = 0; stream < 2; ++stream)
+    {
+        totals[stream] = LayoutRanges(upload.streams[stream], *meshVertices[stream], mesh.sections, mesh.lod == 0, quadRanges[stream]);
+        bytes += (size_t)totals[stream] * (QUAD_VERTICES + QUAD_INDICES) * sizeof(uint32_t);
+    }
+
+    // Written once in the mapped ring, in the same pass as the copy kept for splicing, and copied on the GPU.
+    // Else the driver copies them again (and may wait to)
+    size_t offset = 0;
+    uint8_t* ring = staging ? staging->Reserve(bytes, offset) : nullptr;
+
+    uint8_t* out = ring;
+    for (int stream = 0; stream < 2; ++stream)
+    {
+        LayoutQuads(upload.streams[stream], *meshVertices[stream], *meshIndices[stream], quadRanges[stream], totals[stream], out);
+
+        if (out)
+            out += (size_t)totals[stream] * (QUAD_VERTICES + QUAD_INDICES) * sizeof(uint32_t);
+    }
+
+    upload.indicesCounts[0] = (uint32_t)(mesh.vertices.size()  / QUAD_VERTICES * QUAD_INDICES);
+    upload.indicesCounts[1] = (uint32_t)(mesh.tvertices.size() / QUAD_VERTICES * QUAD_INDICES);
+
+    // The streams hold the quads from now on
+    std::vector<uint32_t>().swap(mesh.vertices);
+    std::vector<uint32_t>().swap(mesh.indices);
+    std::vector<uint32_t>().swap(mesh.tvertices);
+    std::vector<uint32_t>().swap(mesh.tindices);
+
+    if (mesh.sections)
+    {
+        for (int s = 0; s < SECTION_COUNT; ++s)
+            RangesBounds(upload.streams, s * MESH_SIDES, (s + 1) * MESH_SIDES, upload.sectionMin[s], upload.sectionMax[s]);
+
+        SectionsBounds(upload.sectionMin, upload.sectionMax, upload.boundsMin, upload.boundsMax);
+    }
+    else
+    {
+        RangesBounds(upload.streams, 0, MESH_SIDES, upload.boundsMin, upload.boundsMax);
+    }
+
+    if (ring)
+    {
+        GLCall(glBindBuffer(GL_COPY_READ_BUFFER, staging->GetBuffer()));
+    }
+
+    // Buffers of their own, the ones drawn now are left alone. A VAO is not shared between contexts, the render thread makes it
+    for (int stream = 0; stream < 2; ++stream)
+    {
+        const MeshStream& meshStream = upload.streams[stream];
+        if (meshStream.slices.empty())
+            continue;
+
+        GLCall(glGenBuffers(2, &upload.buffers[stream * 2]));
+
+        const std::vector<uint32_t>* parts[2] = { &meshStream.vertices, &meshStream.indices };
+        for (int part = 0; part < 2; ++part)
+        {
+            const size_t partBytes = parts[part]->size() * sizeof(uint32_t);
+
+            GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, upload.buffers[stream * 2 + part]));
+
+            if (!ring)
+            {
+                GLCall(glBufferData(GL_COPY_WRITE_BUFFER, partBytes, parts[part]->data(), GL_STATIC_DRAW));
+                continue;
+            }
+
+            GLCall(glBufferData(GL_COPY_WRITE_BUFFER, partBytes, nullptr, GL_STATIC_DRAW));
+            GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, partBytes));
+
+            offset += partBytes;
+        }
+    }
+
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+    if (ring)
+    {
+        GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+        staging->Fence();
+    }
+}
+
+void Chunk::SwapMesh(MeshUpload& upload)
+{
+    if (m_Stage != Stage::Built && m_Stage != Stage::Uploaded)
+    {
+        GLCall(glDeleteBuffers(4, upload.buffers));
+        return;
+    }
+
+    m_Sectioned = upload.mesh.sections;
+    m_Spliced = upload.mesh.lod == 0;
+    m_DirtySections = 0;
+
+    ++m_TVersion;
+
+    for (int stream = 0; stream < 2; ++stream)
+    {
+        m_Streams[stream] = std::move(upload.streams[stream]);
+        (stream == 0 ? m_IndicesCount : m_TIndicesCount) = upload.indicesCounts[stream];
+
+        // An empty stream keeps its buffers, nothing of them is drawn
+        if (upload.buffers[stream * 2] == 0)
+            continue;
+
+        GLCall(glDeleteBuffers(2, &m_VBIO[stream * 2]));
+
+        m_VBIO[stream * 2]     = upload.buffers[stream * 2];
+        m_VBIO[stream * 2 + 1] = upload.buffers[stream * 2 + 1];
+        (stream == 0 ? m_BufferSize : m_TBufferSize) = (uint32_t)m_Streams[stream].vertices.size();
+
+        BindStreamBuffers(stream);
+    }
+
+    // Its vertex buffer is gone, a new sort makes it again with the new one
+    if (m_SortVAO && upload.buffers[2] != 0)
+    {
+        GLCall(glDeleteVertexArrays(1, &m_SortVAO));
+        GLCall(glDeleteBuffers(1, &m_SortIBO));
+
+        m_SortVAO = m_SortIBO = m_SortIBOSize = 0;
+    }
+
+    std::copy_n(upload.sectionMin, SECTION_COUNT, m_SectionMin);
+    std::copy_n(upload.sectionMax, SECTION_COUNT, m_SectionMax);
+    m_BoundsMin = upload.boundsMin;
+    m_BoundsMax = upload.boundsMax;
+
+    m_Stage = Stage::Uploaded;
+}
+
+void Chunk::UploadSlices(const Mesh& mesh, const glm::ivec3& from, const glm::ivec3& to)
+{
+    SpliceStream(0, mesh.vertices,  mesh.indices,  from, to);
+    SpliceStream(1, mesh.tvertices, mesh.tindices, from, to);
+
+    UpdateBounds();
+}
+
+static inline uint32_t QuadSide(const uint32_t* vertices)
+{
+    return (vertices[1] >> 12) & 0x7;
+}
+
+static inline uint16_t QuadSlice(const uint32_t* vertices)
+{
+    // The first vertex lies on the plane of the quad
+    const uint32_t side = QuadSide(vertices), d = 2 - side / 2;
+    return (uint16_t)(side * (CHUNK_SIZE + 1) + ((vertices[0] >> (6 * d)) & 0x3F));
+}
+
+static inline int QuadSection(const uint32_t* vertices)
+{
+    // The block owning the face: the first vertex is on the plane after it for a front face, before it for a back face
+    const uint32_t side = QuadSide(vertices), d = 2 - side / 2;
+
+    int block[3];
+    for (int a = 0; a < 3; ++a)
+        block[a] = (vertices[0] >> (6 * a)) & 0x3F;
+
+    block[d] -= (side & 1) ? 0 : 1;
+    block[d] = block[d] < 0 ? 0 : block[d] > CHUNK_SIZE - 1 ? CHUNK_SIZE - 1 : block[d];
+
+    return SECTION_ID(block[0] / SECTION_SIZE, block[1] / SECTION_SIZE, block[2] / SECTION_SIZE);
+}
+
+static inline bool IsSliceInRange(uint16_t slice, const glm::ivec3& from, const glm::ivec3& to)
+{
+    // Same planes as GenerateSlices, shifted by one as the quad stores the plane after x[d]
+    const int side = slice / (CHUNK_SIZE + 1), plane = slice % (CHUNK_SIZE + 1), d = 2 - side / 2;
+    return plane >= (from[d] > 0 ? from[d] : 0) && plane <= (to[d] < CHUNK_SIZE - 1 ? to[d] : CHUNK_SIZE - 1) + 1;
+}
+
+uint8_t Chunk::VisibleFaces(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& position)
+{
+    // A face is seen from the side its normal points to, every face of the box lies between min and max
+    uint8_t faces = 0;
+    faces |= (position.z > boxMin.z) << FaceSide::Front;
+    faces |= (position.z < boxMax.z) << FaceSide::Back;
+    faces |= (position.y > boxMin.y) << FaceSide::Top;
+    faces |= (position.y < boxMax.y) << FaceSide::Bottom;
+    faces |= (position.x > boxMin.x) << FaceSide::Right;
+    faces |= (position.x < boxMax.x) << FaceSide::Left;
+    return faces;
+}
+
+int Chunk::QuadRange(const uint32_t* vertices) const
+{
+    return QuadRange(vertices, m_Sectioned);
+}
+
+int Chunk::QuadRange(const uint32_t* vertices, bool sectioned)
+{
+    return (sectioned ? QuadSection(vertices) * MESH_SIDES : 0) + QuadSide(vertices);
+}
+
+void Chunk::SetStream(int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices)
+{
+    m_TVersion += stream == 1;
+
+    LayoutStream(m_Streams[stream], vertices, indices, m_Sectioned, m_Spliced);
+
+    (stream == 0 ? m_IndicesCount : m_TIndicesCount) = (uint32_t)(vertices.size() / QUAD_VERTICES * QUAD_INDICES);
+
+    const uint32_t total = (uint32_t)m_Streams[stream].slices.size();
+    if (total == 0)
+        return;
+
+    ReserveBuffers(stream);
+    UploadQuads(stream, 0, total);
+}
+
+void Chunk::LayoutStream(MeshStream& meshStream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, bool sectioned, bool spliced)
+{
+    std::vector<uint8_t> quadRanges;
+    const uint32_t total = LayoutRanges(meshStream, vertices, sectioned, spliced, quadRanges);
+
+    LayoutQuads(meshStream, vertices, indices, quadRanges, total, nullptr);
+}
+
+uint32_t Chunk::LayoutRanges(MeshStream& meshStream, const std::vector<uint32_t>& vertices, bool sectioned, bool spliced, std::vector<uint8_t>& quadRanges)
+{
+    const uint32_t quads = (uint32_t)(vertices.size() / QUAD_VERTICES);
+
+    quadRanges.resize(quads);
+    uint32_t counts[MESH_RANGES]{};
+    for (uint32_t k = 0; k < quads; ++k)
+        ++counts[quadRanges[k] = QuadRange(&vertices[k * QUAD_VERTICES], sectioned)];
+
+    // A mesh that can be spliced keeps a quarter of free quads in every range, an edit that fits is written in place
+    uint32_t total = 0;
+    for (int r = 0; r < MESH_RANGES; ++r)
+    {
+        MeshRange& range = meshStream.ranges[r];
+        range.first    = total;
+        range.count    = 0;
+        range.capacity = counts[r] + (spliced && counts[r] > 0 ? counts[r] / 4 + 2 : 0);
+
+        total += range.capacity;
+    }
+
+    return total;
+}
+
+void Chunk::LayoutQuads(MeshStream& meshStream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices,
+    const std::vector<uint8_t>& quadRanges, uint32_t total, uint8_t* out)
+{
+    meshStream.freeQuads.clear();
+
+    // The mesh quad in every slot, in order, so both copies are written front to back (out may be write-combined)
+    std::vector<uint32_t> slotQuads(total, UINT32_MAX);
+    for (uint32_t k = 0; k < (uint32_t)quadRanges.size(); ++k)
+    {
+        MeshRange& range = meshStream.ranges[quadRanges[k]];
+        slotQuads[range.first + range.count++] = k;
+    }
+
+    meshStream.vertices.resize((size_t)total * QUAD_VERTICES);
+    meshStream.indices .resize((size_t)total * QUAD_INDICES);
+    meshStream.slices  .resize(total);
+
+    uint32_t* outVertices = (uint32_t*)out;
+    uint32_t* outIndices  = outVertices + (size_t)total * QUAD_VERTICES;
+
+    for (uint32_t q = 0; q < total; ++q)
+    {
+        uint32_t* quadVertices = &meshStream.vertices[q * QUAD_VERTICES];
+        uint32_t* quadIndices  = &meshStream.indices[q * QUAD_INDICES];
+
+        // Free slots are degenerate quads
+        const uint32_t k = slotQuads[q];
+        if (k == UINT32_MAX)
+        {
+            std::fill_n(quadVertices, QUAD_VERTICES, 0);
+            std::fill_n(quadIndices, QUAD_INDICES, q * 4);
+            meshStream.slices[q] = MESH_SLICE_FREE;
+        }
+        else
+        {
+            std::copy_n(&vertices[k * QUAD_VERTICES], QUAD_VERTICES, quadVertices);
+            for (int i = 0; i < QUAD_INDICES; ++i)
+                quadIndices[i] = indices[k * QUAD_INDICES + i] - k * 4 + q * 4;
+
+            meshStream.slices[q] = QuadSlice(quadVertices);
+        }
+
+        if (out)
+        {
+            std::copy_n(quadVertices, QUAD_VERTICES, &outVertices[q * QUAD_VERTICES]);
+            std::copy_n(quadIndices, QUAD_INDICES, &outIndices[q * QUAD_INDICES]);
+        }
+    }
+}
+
+void Chunk::RelayoutStream(int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, uint32_t firstQuad)
+{
+    const MeshStream& meshStream = m_Streams[stream];
+
+    std::vector<uint32_t> streamVertices, streamIndices;
+
+    const auto append = [&streamVertices, &streamIndices](const uint32_t* quadVertices, const uint32_t* quadIndices, uint32_t base)
+    {
+        const uint32_t q = (uint32_t)(streamVertices.size() / QUAD_VERTICES);
+
+        streamVertices.insert(streamVertices.end(), quadVertices, quadVertices + QUAD_VERTICES);
+        for (int i = 0; i < QUAD_INDICES; ++i)
+            streamIndices.push_back(quadIndices[i] - base * 4 + q * 4);
+    };
+
+    for (uint32_t q = 0; q < meshStream.slices.size(); ++q)
+        if (meshStream.slices[q] != MESH_SLICE_FREE)
+            append(&meshStream.vertices[q * QUAD_VERTICES], &meshStream.indices[q * QUAD_INDICES], q);
+
+    for (uint32_t k = firstQuad; k < vertices.size() / QUAD_VERTICES; ++k)
+        append(&vertices[k * QUAD_VERTICES], &indices[k * QUAD_INDICES], k);
+
+    SetStream(stream, streamVertices, streamIndices);
+}
+
+void Chunk::FreeQuad(int stream, uint32_t q)
+{
+    MeshStream& meshStream = m_Streams[stream];
+
+    meshStream.slices[q] = MESH_SLICE_FREE;
+    std::fill_n(&meshStream.indices[q * QUAD_INDICES], QUAD_INDICES, q * 4);
+
+    (stream == 0 ? m_IndicesCount : m_TIndicesCount) -= QUAD_INDICES;
+}
+
+void Chunk::SpliceStream(int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, const glm::ivec3& from, const glm::ivec3& to)
+{
+    MeshStream& meshStream = m_Streams[stream];
+
+    m_TVersion += stream == 1;
+
+    std::vector<uint32_t> changed;
+
+    // The old quads of the slices become degenerate free slots
+    for (uint32_t q = 0; q < meshStream.slices.size(); ++q)
+    {
+        if (meshStream.slices[q] == MESH_SLICE_FREE || !IsSliceInRange(meshStream.slices[q], from, to))
+            continue;
+
+        FreeQuad(stream, q);
+
+        meshStream.freeQuads.push_back(q);
+        changed.push_back(q);
+    }
+
+    const uint32_t quads = (uint32_t)(vertices.size() / QUAD_VERTICES);
+    for (uint32_t k = 0; k < quads; ++k)
+    {
+        // A free slot of the range of its direction, or the first one after the range
+        MeshRange& range = meshStream.ranges[QuadRange(&vertices[k * QUAD_VERTICES])];
+
+        const auto freeQuad = std::find_if(meshStream.freeQuads.begin(), meshStream.freeQuads.end(),
+            [&range](uint32_t q) { return q >= range.first && q < range.first + range.count; });
+
+        uint32_t q;
+        if (freeQuad != meshStream.freeQuads.end())
+        {
+            q = *freeQuad;
+            meshStream.freeQuads.erase(freeQuad);
+        }
+        else if (range.count < range.capacity)
+            q = range.first + range.count++;
+        else
+        {
+            // Out of room, lay out the whole stream again with the rest of the new quads
+            RelayoutStream(stream, vertices, indices, k);
+            return;
+        }
+
+        std::copy_n(&vertices[k * QUAD_VERTICES], QUAD_VERTICES, &meshStream.vertices[q * QUAD_VERTICES]);
+        for (int i = 0; i < QUAD_INDICES; ++i)
+            meshStream.indices[q * QUAD_INDICES + i] = indices[k * QUAD_INDICES + i] - k * 4 + q * 4;
+
+        meshStream.slices[q] = QuadSlice(&meshStream.vertices[q * QUAD_VERTICES]);
+        (stream == 0 ? m_IndicesCount : m_TIndicesCount) += QUAD_INDICES;
+
+        changed.push_back(q);
+    }
+
+    // Free slots at the end of a range are not drawn at all
+    for (MeshRange& range : meshStream.ranges)
+        while (range.count > 0 && meshStream.slices[range.first + range.count - 1] == MESH_SLICE_FREE)
+            --range.count;
+
+    std::erase_if(meshStream.freeQuads, [this, &meshStream](uint32_t q)
+    {
+        const MeshRange& range = meshStream.ranges[QuadRange(&meshStream.vertices[q * QUAD_VERTICES])];
+        return q >= range.first + range.count;
+    });
+
+    if (changed.empty())
+        return;
+
+    std::sort(changed.begin(), changed.end());
+
+    // Only the changed quads, one call for each run of them
+    for (size_t i = 0; i < changed.size();)
+    {
+        size_t j = i + 1;
+        while (j < changed.size() && changed[j] <= changed[j - 1] + 1)
+            ++j;
+
+        UploadQuads(stream, changed[i], changed[j - 1] - changed[i] + 1);
+        i = j;
+    }
+}
+
+void Chunk::UploadSection(int section, const Mesh& mesh)
+{
+    SpliceSection(0, section, mesh.vertices,  mesh.indices);
+    SpliceSection(1, section, mesh.tvertices, mesh.tindices);
+
+    UpdateSectionBounds(section);
+    UpdateBounds();
+}
+
+void Chunk::SpliceSection(int stream, int section, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices)
+{
+    MeshStream& meshStream = m_Streams[stream];
+
+    m_TVersion += stream == 1;
+
+    const uint32_t quads = (uint32_t)(vertices.size() / QUAD_VERTICES);
+
+    uint32_t counts[MESH_SIDES]{};
+    for (uint32_t k = 0; k < quads; ++k)
+        ++counts[QuadSide(&vertices[k * QUAD_VERTICES])];
+
+    MeshRange* ranges = &meshStream.ranges[section * MESH_SIDES];
+
+    // The section is written in place only if every direction fits in its range
+    bool fits = true;
+    for (int side = 0; side < MESH_SIDES; ++side)
+        fits = fits && counts[side] <= ranges[side].capacity;
+
+    uint32_t oldCounts[MESH_SIDES];
+    for (int side = 0; side < MESH_SIDES; ++side)
+    {
+        oldCounts[side] = ranges[side].count;
+
+        for (uint32_t q = ranges[side].first; q < ranges[side].first + ranges[side].count; ++q)
+            FreeQuad(stream, q);
+
+        ranges[side].count = 0;
+    }
+
+    if (!fits)
+    {
+        RelayoutStream(stream, vertices, indices, 0);
+        return;
+    }
+
+    for (uint32_t k = 0; k < quads; ++k)
+    {
+        MeshRange& range = ranges[QuadSide(&vertices[k * QUAD_VERTICES])];
+        const uint32_t q = range.first + range.count++;
+
+        std::copy_n(&vertices[k * QUAD_VERTICES], QUAD_VERTICES, &meshStream.vertices[q * QUAD_VERTICES]);
+        for (int i = 0; i < QUAD_INDICES; ++i)
+            meshStream.indices[q * QUAD_INDICES + i] = indices[k * QUAD_INDICES + i] - k * 4 + q * 4;
+
+        meshStream.slices[q] = QuadSlice(&vertices[k * QUAD_VERTICES]);
+    }
+
+    (stream == 0 ? m_IndicesCount : m_TIndicesCount) += quads * QUAD_INDICES;
+
+    // The ranges of a section are next to each other, the quads it lost are degenerate now
+    const uint32_t first = ranges[0].first;
+    uint32_t last = first;
+    for (int side = 0; side < MESH_SIDES; ++side)
+    {
+        const uint32_t changed = ranges[side].count > oldCounts[side] ? ranges[side].count : oldCounts[side];
+        if (changed > 0)
+            last = ranges[side].first + changed;
+    }
+
+    if (last > first)
+        UploadQuads(stream, first, last - first);
+}
+
+void Chunk::RangesBounds(const MeshStream streams[2], int rangeFrom, int rangeTo, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    boundsMin = glm::vec3{ CHUNK_SIZE + 1 };
+    boundsMax = glm::vec3{ -1.0f };
+
+    for (int stream = 0; stream < 2; ++stream)
+        for (int r = rangeFrom; r < rangeTo; ++r)
+        {
+            const MeshStream& meshStream = streams[stream];
+            const MeshRange& range = meshStream.ranges[r];
+            for (uint32_t q = range.first; q < range.first + range.count; ++q)
+            {
+                if (meshStream.slices[q] == MESH_SLICE_FREE)
+                    continue;
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    const uint32_t vertex = meshStream.vertices[(q * 4 + i) * 2];
+                    const glm::vec3 position{ vertex & 0x3F, (vertex >> 6) & 0x3F, (vertex >> 12) & 0x3F };
+
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        boundsMin[a] = position[a] < boundsMin[a] ? position[a] : boundsMin[a];
+                        boundsMax[a] = position[a] > boundsMax[a] ? position[a] : boundsMax[a];
+                    }
+                }
+            }
+        }
+}
+
+void Chunk::UpdateSectionBounds(int section)
+{
+    RangesBounds(m_Streams, section * MESH_SIDES, (section + 1) * MESH_SIDES, m_SectionMin[section], m_SectionMax[section]);
+}
+
+void Chunk::UpdateBounds()
+{
+    if (!m_Sectioned)
+    {
+        RangesBounds(m_Streams, 0, MESH_SIDES, m_BoundsMin, m_BoundsMax);
+        return;
+    }
+
+    // Union of the sections, already up to date
+    SectionsBounds(m_SectionMin, m_SectionMax, m_BoundsMin, m_BoundsMax);
+}
+
+void Chunk::SectionsBounds(const glm::vec3 sectionMin[SECTION_COUNT], const glm::vec3 sectionMax[SECTION_COUNT], glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    boundsMin = glm::vec3{ CHUNK_SIZE + 1 };
+    boundsMax = glm::vec3{ -1.0f };
+
+    for (int s = 0; s < SECTION_COUNT; ++s)
+        for (int a = 0; a < 3; ++a)
+        {
+            boundsMin[a] = sectionMin[s][a] < boundsMin[a] ? sectionMin[s][a] : boundsMin[a];
+            boundsMax[a] = sectionMax[s][a] > boundsMax[a] ? sectionMax[s][a] : boundsMax[a];
+        }
+}
+
+bool Chunk::GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    if (m_BoundsMin.x > m_BoundsMax.x)
+        return false;
+
+    boundsMin = m_BoundsMin;
+    boundsMax = m_BoundsMax;
+    return true;
+}
+
+bool Chunk::GetSectionBounds(int section, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+    if (m_SectionMin[section].x > m_SectionMax[section].x)
+        return false;
+
+    boundsMin = m_SectionMin[section];
+    boundsMax = m_SectionMax[section];
+    return true;
+}
+
+void Chunk::MarkSectionsDirty(const glm::ivec3& from, const glm::ivec3& to)
+{
+    const glm::ivec3 sectionFrom = glm::clamp(from, glm::ivec3{ 0 }, glm::ivec3{ CHUNK_SIZE - 1 }) / SECTION_SIZE;
+    const glm::ivec3 sectionTo   = glm::clamp(to,   glm::ivec3{ 0 }, glm::ivec3{ CHUNK_SIZE - 1 }) / SECTION_SIZE;
+
+    for (int z = sectionFrom.z; z <= sectionTo.z; ++z)
+        for (int y = sectionFrom.y; y <= sectionTo.y; ++y)
+            for (int x = sectionFrom.x; x <= sectionTo.x; ++x)
+                m_DirtySections |= 1 << SECTION_ID(x, y, z);
+}
+
+bool Chunk::ReserveBuffers(int stream)
+{
+    const MeshStream& meshStream = m_Streams[stream];
+
+    // A buffer twice the size of the stream (a chunk meshed again at a coarser level) is allocated again smaller
+    uint32_t& bufferSize = stream == 0 ? m_BufferSize : m_TBufferSize;
+    if (bufferSize >= meshStream.vertices.size() && bufferSize <= 2 * meshStream.vertices.size())
+        return false;
+
+    if (bufferSize == 0) // Create new buffer
+    {
+        GLCall(glGenBuffers(2, &m_VBIO[stream * 2]));
+        BindStreamBuffers(stream);
+    }
+
+    bufferSize = (uint32_t)meshStream.vertices.size();
+
+    // The element buffer binding belongs to the VAO
+    GLCall(glBindVertexArray(m_VAO[stream]));
+
+    GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[stream * 2]));
+    GLCall(glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(uint32_t), nullptr, GL_STATIC_DRAW));
+
+    GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, bufferSize / QUAD_VERTICES * QUAD_INDICES * sizeof(uint32_t), nullptr, GL_STATIC_DRAW));
+    return true;
+}
+
+void Chunk::BindStreamBuffers(int stream)
+{
+    if (m_VAO[stream] == 0)
+    {
+        GLCall(glGenVertexArrays(1, &m_VAO[stream]));
+    }
+
+    GLCall(glBindVertexArray(m_VAO[stream]));
+
+    GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[stream * 2]));
+    GLCall(glEnableVertexAttribArray(0));
+    GLCall(glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)0));
+    GLCall(glEnableVertexAttribArray(1));
+    GLCall(glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)(sizeof(uint32_t))));
+
+    GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_VBIO[stream * 2 + 1]));
+}
+
+void Chunk::UploadQuads(int stream, uint32_t first, uint32_t count)
+{
+    const MeshStream& meshStream = m_Streams[stream];
+
+    GLCall(glBindVertexArray(m_VAO[stream]));
+
+    GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[stream * 2]));
+    GLCall(glBufferSubData(GL_ARRAY_BUFFER, first * QUAD_VERTICES * sizeof(uint32_t), count * QUAD_VERTICES * sizeof(uint32_t), &meshStream.vertices[first * QUAD_VERTICES]));
+
+    GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * QUAD_INDICES * sizeof(uint32_t), count * QUAD_INDICES * sizeof(uint32_t), &meshStream.indices[first * QUAD_INDICES]));
+}
+
+void Chunk::Render(RenderStats& stats, uint8_t sections, uint8_t faces) const
+{
+    if (m_IndicesCount == 0)
+        return;
+
+    GLCall(glVertexAttribI1ui(CHUNK_DRAW_ATTRIB, m_DrawIndex));
+
+    DrawStream(0, stats, sections, faces);
+}
+
+void Chunk::RenderT(RenderStats& stats, uint8_t sections, bool sorted) const
+{
+    if (m_TIndicesCount == 0)
+        return;
+
+    GLCall(glVertexAttribI1ui(CHUNK_DRAW_ATTRIB, m_DrawIndex));
+
+    // Drawn without face culling, water is seen from below too
+    if (!sorted || m_SortedVersion != m_TVersion)
+    {
+        DrawStream(1, stats, sections, 0x3F);
+        return;
+    }
+
+    // The whole chunk back to front, the sections outside the view too
+    GLCall(glBindVertexArray(m_SortVAO));
+    GLCall(glDrawElements(GL_TRIANGLES, m_SortedCount, GL_UNSIGNED_INT, nullptr));
+
+    ++stats.DrawCalls;
+    stats.Quads += m_SortedCount / QUAD_INDICES;
+}
+
+bool Chunk::TakeTranslucentSort(const glm::vec3& position, TranslucentSort& sort)
+{
+    if (m_SortPending || m_TIndicesCount == 0)
+        return false;
+
+    // Past a chunk from it the order changes slowly, the cells there are the ones at the border
+    glm::vec3 local = position - m_Coord;
+    for (int a = 0; a < 3; ++a)
+        local[a] = local[a] < -CHUNK_SIZE ? -CHUNK_SIZE : local[a] > 2 * CHUNK_SIZE ? 2 * CHUNK_SIZE : local[a];
+
+    const glm::ivec3 cell = glm::ivec3(glm::floor(local / (float)TRANSLUCENT_SORT_CELL));
+    if (cell == m_SortCell && m_SortedVersion == m_TVersion)
+        return false;
+
+    const MeshStream& meshStream = m_Streams[1];
+
+    // The centroids are kept until the quads change, a new cell only sorts them again
+    if (m_TCentroidsVersion != m_TVersion)
+    {
+        m_TCentroids.clear();
+        for (uint32_t q = 0; q < meshStream.slices.size(); ++q)
+        {
+            if (meshStream.slices[q] == MESH_SLICE_FREE)
+                continue;
+
+            glm::vec3 centroid{ 0.0f };
+            for (int i = 0; i < 4; ++i)
+            {
+                const uint32_t vertex = meshStream.vertices[(q * 4 + i) * 2];
+                centroid += glm::vec3{ vertex & 0x3F, (vertex >> 6) & 0x3F, (vertex >> 12) & 0x3F };
+            }
+
+            m_TCentroids.push_back(centroid * 0.25f);
+        }
+
+        m_TCentroidsVersion = m_TVersion;
+    }
+
+    sort.chunk = this;
+    sort.version = m_TVersion;
+    sort.position = position - m_Coord;
+    sort.centroids = m_TCentroids;
+
+    sort.indices.clear();
+    sort.indices.reserve(m_TCentroids.size() * QUAD_INDICES);
+    for (uint32_t q = 0; q < meshStream.slices.size(); ++q)
+        if (meshStream.slices[q] != MESH_SLICE_FREE)
+            sort.indices.insert(sort.indices.end(), &meshStream.indices[q * QUAD_INDICES], &meshStream.indices[(q + 1) * QUAD_INDICES]);
+
+    m_SortCell = cell;
+    m_SortPending = true;
+    return true;
+}
+
+void TranslucentSort::Sort()
+{
+    std::vector<std::pair<float, uint32_t>> order(centroids.size());
+    for (uint32_t k = 0; k < centroids.size(); ++k)
+    {
+        const glm::vec3 d = centroids[k] - position;
+        order[k] = { glm::dot(d, d), k };
+    }
+
+    std::sort(order.begin(), order.end(), [](const std::pair<float, uint32_t>& o1, const std::pair<float, uint32_t>& o2) { return o1.first > o2.first; });
+
+    std::vector<uint32_t> sorted(indices.size());
+    for (uint32_t k = 0; k < order.size(); ++k)
+        std::copy_n(&indices[order[k].second * QUAD_INDICES], QUAD_INDICES, &sorted[k * QUAD_INDICES]);
+
+    indices = std::move(sorted);
+}
+
+void Chunk::UploadTranslucentOrder(const TranslucentSort& sort)
+{
+    m_SortPending = false;
+
+    // Taken again by the next TakeTranslucentSort
+    if (sort.version != m_TVersion || sort.indices.empty())
+        return;
+
+    if (m_SortVAO == 0)
+    {
+        GLCall(glGenVertexArrays(1, &m_SortVAO));
+        GLCall(glGenBuffers(1, &m_SortIBO));
+
+        // The vertices of the translucent stream, with an element buffer of its own
+        GLCall(glBindVertexArray(m_SortVAO));
+
+        GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_VBIO[2]));
+        GLCall(glEnableVertexAttribArray(0));
+        GLCall(glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)0));
+        GLCall(glEnableVertexAttribArray(1));
+        GLCall(glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, 2 * sizeof(uint32_t), (GLvoid*)(sizeof(uint32_t))));
+
+        GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SortIBO));
+    }
+
+    GLCall(glBindVertexArray(m_SortVAO));
+
+    m_SortedCount = (uint32_t)sort.indices.size();
+    if (m_SortedCount > m_SortIBOSize)
+    {
+        m_SortIBOSize = m_SortedCount;
+        GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_SortIBOSize * sizeof(uint32_t), sort.indices.data(), GL_DYNAMIC_DRAW));
+    }
+    else
+    {
+        GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m_SortedCount * sizeof(uint32_t), sort.indices.data()));
+    }
+
+    m_SortedVersion = sort.version;
+}
+
+void Chunk::DrawStream(int stream, RenderStats& stats, uint8_t sections, uint8_t faces) const
+{
+    GLsizei counts[MESH_RANGES];
+    const void* offsets[MESH_RANGES];
+    GLsizei draws = 0;
+
+    // The slack after each range is not drawn
+    const MeshRange* ranges = m_Streams[stream].ranges;
+    const int rangeCount = m_Sectioned ? MESH_RANGES : MESH_SIDES;
+    for (int r = 0; r < rangeCount; ++r)
+    {
+        if (ranges[r].count == 0 || !(faces & (1 << (r % MESH_SIDES))) || (m_Sectioned && !(sections & (1 << (r / MESH_SIDES)))))
+            continue;
+
+        counts [draws] = (GLsizei)(ranges[r].count * QUAD_INDICES);
+        offsets[draws] = (const void*)(ranges[r].first * QUAD_INDICES * sizeof(uint32_t));
+        ++draws;
+
+        stats.Quads += ranges[r].count;
+    }
+
+    if (draws == 0)
+        return;
+
+    GLCall(glBindVertexArray(m_VAO[stream]));
+
+    // One call for every range of the chunk
+    if (draws == 1)
+    {
+        GLCall(glDrawElements(GL_TRIANGLES, counts[0], GL_UNSIGNED_INT, offsets[0]));
+    }
+    else
+    {
+        GLCall(glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, draws));
+    }
+
+    ++stats.DrawCalls;
+}
+
+ChunkBlock Chunk::GetNeighborBlock(Chunk* chunks[26], int x[3], int d, bool isNeighF, int v) const
+{
+    int neighborIndex = 0, x_ = x[0], y_ = x[1], z_ = x[2];
+    if (d == 0) { neighborIndex = isNeighF ? 14 : 12; x_ = v; }
+    else if (d == 1)
+    {
+        if (isNeighF)
+        {
+            if (m_Coord.y == CHUNK_MAX_HEIGHT - CHUNK_SIZE)
+                return ChunkBlock{};
+
+            neighborIndex = 16;
+        }
+        else
+        {
+            if (m_Coord.y == 0)
+                return ChunkBlock{};
+
+            neighborIndex = 10;
+        }
+        y_ = v;
+    }
+    else { neighborIndex = isNeighF ? 22 : 4; z_ = v; }
+
+    return chunks[neighborIndex]->GetBlock(ID(x_, y_, z_));
+}
+
+void Chunk::RemoveTileEntity(const glm::vec3& coord)
+{
+    m_TileEntitiesToRemove.push(coord);
+}
+
+void Chunk::Update(CubeWorld* world)
+{
+    for (auto& [_, tileEntity] : m_TileEntities)
+        tileEntity->Update(world);
+}
+
+void Chunk::PostUpdate()
+{
+    while (m_TileEntitiesToRemove.size() > 0)
+    {
+        const glm::vec3& coord = m_TileEntitiesToRemove.front();
+        m_TileEntities.erase(coord);
+
+        m_TileEntitiesToRemove.pop();
+    }
+}
+
+void Chunk::CalculateAO(Chunk* chunks[26], AO& ao, int x, int y, int z, int du[3], int dv[3]) const
+{
+    // V0 (0, 0)
+    int sMV = GetAONeighborBlock(chunks, x - dv[0], y - dv[1], z - dv[2]);
     int sPV = GetAONeighborBlock(chunks, x + dv[0], y + dv[1], z + dv[2]);
     int sMU = GetAONeighborBlock(chunks, x - du[0], y - du[1], z - du[2]);
     int sPU = GetAONeighborBlock(chunks, x + du[0], y + du[1], z + du[2]);
@@ -547,6 +1712,20 @@ int Chunk::GetAONeighborBlock(Chunk* chunks[26], int x, int y, int z) const
         return !BlocksManager::GetBlock(chunks[neighborIndx]->GetBlock(ID(x, y, z)))->m_IsTransparent;
 }
 
+uint8_t Chunk::GetNeighborLight(Chunk* chunks[26], int x, int y, int z) const
+{
+    int neighborIndx = 0;
+    bool upBorder = false, downBorder = false;
+    if (CoordinateInBound(&x, &y, &z, &neighborIndx, &upBorder, &downBorder))
+        return GetLight(ID(x, y, z));
+    else if (upBorder && m_Coord.y == CHUNK_MAX_HEIGHT - CHUNK_SIZE)
+        return LIGHT_FULL_SKY;
+    else if (downBorder && m_Coord.y == 0)
+        return 0;
+    else
+        return chunks[neighborIndx]->GetLight(ID(x, y, z));
+}
+
 bool Chunk::CoordinateInBound(int* x, int* y, int* z, int* neighborIndx, bool* upBorder, bool* downBorder) const
 {
     int indx;
@@ -15,6 +15,7 @@
 #include <vector>
 #include <queue>
 #include <mutex>
+#include <atomic>
 
 #define CHUNK_SIZE 32
 #define CHUNK_SIZES CHUNK_SIZE * CHUNK_SIZE
@@ -39,17 +40,113 @@
 // X 6 Bit - Y 6 Bit - Z 6 Bit | Width 5 Bit | Heigth 5 Bit | UV 2 Bit | AO 2 Bit
 #define VBO(x, y, z, w, h, uv, ao) (x) | ((y) << 6) | ((z) << 12) | ((w) << 18) | ((h) << 23) | ((uv) << 28) | ((ao) << 30)
 
-// ID 12 Bit | Norm 3 Bit | Flip 1 Bit | EMPTY 19 Bit
-#define VBO1(id, norm) (id) | ((norm) << 12)
+// ID 12 Bit | Norm 3 Bit | Flip 1 Bit | Light 8 Bit (Block 4 Bit | Sky 4 Bit) | EMPTY 8 Bit
+#define VBO1(id, norm, light) (id) | ((norm) << 12) | ((light) << 16)
 
 #define ID(x, y, z) (y) + (x) * CHUNK_SIZE + (z) * CHUNK_SIZES
 
+// Sky 4 Bit | Block 4 Bit
+#define LIGHT_MAX 15
+#define LIGHT_SKY(light) ((light) >> 4)
+#define LIGHT_BLOCK(light) ((light) & 0xF)
+// Light of the blocks above the world and of the chunks that were never lit
+#define LIGHT_FULL_SKY (LIGHT_MAX << 4)
+
+// 2 uint per vertex, 4 vertices per quad
+#define QUAD_VERTICES 8
+#define QUAD_INDICES 6
+
+// Slice: the quads of one face side on one of the 33 planes between the layers of blocks (side * 33 + plane)
+#define MESH_SLICE_FREE 0xFFFF
+
+// Optional layout: 2x2x2 mesh sections per chunk, with their own range in the buffers and bounds
+#define SECTION_SIZE 16
+#define SECTION_AXIS (CHUNK_SIZE / SECTION_SIZE)
+#define SECTION_COUNT (SECTION_AXIS * SECTION_AXIS * SECTION_AXIS)
+#define SECTION_ID(x, y, z) ((x) + (y) * SECTION_AXIS + (z) * SECTION_AXIS * SECTION_AXIS)
+
+// The quads of every face direction (of every section) have their own range in the buffers
+#define MESH_SIDES 6
+#define MESH_RANGES (SECTION_COUNT * MESH_SIDES)
+
+// Distant chunks are meshed from blocks downsampled 2x, 4x or 8x per level
+#define LOD_LEVELS 4
+
+// Cells of the solid heights used as occluders
+#define OCCLUDER_CELL 8
+#define OCCLUDER_AXIS (CHUNK_SIZE / OCCLUDER_CELL)
+#define OCCLUDER_CELLS (OCCLUDER_AXIS * OCCLUDER_AXIS)
+
+// Blocks on a side of the cells of the camera around a chunk, its translucent quads are sorted again in a new one
+#define TRANSLUCENT_SORT_CELL 4
+
+// Vertex attribute of the chunk draw index, a constant value (no array) set before each draw
+#define CHUNK_DRAW_ATTRIB 2
+
 static glm::vec3 CHUNK_SIZE3{ CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE };
 
 struct Mesh
 {
 	std::vector<uint32_t> vertices, tvertices;
 	std::vector<uint32_t> indices, tindices;
+
+	bool sections = false; // Quads grouped by section, none crosses one
+	int lod = 0;
+};
+
+struct RenderStats
+{
+	uint32_t DrawCalls = 0, Quads = 0;
+	uint32_t TranslucentSorts = 0; // Started
+};
+
+// Quads first to first + count (free ones degenerate), then free ones up to capacity
+struct MeshRange
+{
+	uint32_t first = 0, count = 0, capacity = 0;
+};
+
+// Copy of the uploaded quads, the slices or sections of an edit are spliced in place
+struct MeshStream
+{
+	std::vector<uint32_t> vertices, indices;
+
+	std::vector<uint16_t> slices;    // Slice of every quad, MESH_SLICE_FREE for a free (degenerate) one
+	std::vector<uint32_t> freeQuads; // Free quads before the end of their range
+
+	MeshRange ranges[MESH_RANGES];   // By face direction, by section then direction in the section layout
+};
+
+class Chunk;
+
+// A whole mesh laid out and written to buffers of its own by Chunk::PrepareUpload, on any thread with a context
+// sharing the window's, then swapped in by Chunk::SwapMesh on the render thread
+struct MeshUpload
+{
+	Chunk* chunk = nullptr;
+	Mesh mesh; // Only its layout once prepared, the quads are in the streams
+
+	MeshStream streams[2];
+	uint32_t indicesCounts[2]{ 0, 0 };
+	uint32_t buffers[4]{ 0, 0, 0, 0 }; // Vertex and element buffers of both streams, none for an empty one
+
+	glm::vec3 sectionMin[SECTION_COUNT], sectionMax[SECTION_COUNT];
+	glm::vec3 boundsMin{ 1.0f }, boundsMax{ -1.0f };
+};
+
+// The translucent quads of a chunk in back to front order from a camera, sorted on a worker thread
+struct TranslucentSort
+{
+	Chunk* chunk = nullptr;
+	uint32_t version = 0; // Of the translucent quads it was taken from
+
+	glm::vec3 position{ 0.0f }; // Local to the chunk
+
+	std::vector<glm::vec3> centroids;
+	std::vector<uint32_t> indices; // Of each quad, in the new order once sorted
+
+	// Sort the quads and their indices by the distance of their centroids, the farthest first
+	void Sort();
 };
 
 struct AO
@@ -70,29 +167,32 @@ struct FaceMask
 public:
 	ChunkBlock block;
 	AO ao;
+	uint32_t light;
 
 public:
-	void reset() { block.data = 0; ao.data = 0; }
+	void reset() { block.data = 0; ao.data = 0; light = 0; }
 
 	bool operator==(const FaceMask& o)
 	{
-		return block == o.block && ao.data == o.ao.data;
+		return block == o.block && ao.data == o.ao.data && light == o.light;
 	}
 
 	bool operator!=(const FaceMask& o)
 	{
-		return block != o.block || ao.data != o.ao.data;
+		return block != o.block || ao.data != o.ao.data || light != o.light;
 	}
 };
 
 enum FaceSide { Front, Back, Top, Bottom, Right, Left };
 
 class CubeWorld;
+class WorldStorage;
+class StagingRing;
 
 class Chunk
 {
 public:
-	enum Stage { Initialized, Filling, Filled, WaitingNeighbors, Building, Built, Uploaded };
+	enum Stage { Initialized, Filling, Filled, WaitingNeighbors, WaitingLight, Building, Built, Uploaded };
 
 	// T for Translucent
 
@@ -102,20 +202,76 @@ public:
 
 	std::mutex m_Lock;
 
+	// Last frame the cave culling reached the chunk
+	uint32_t m_CaveFrame = 0;
+
+	// Of its offset in the draw data of the frame, set by the renderer before Render
+	uint32_t m_DrawIndex = 0;
+
+	// Position in the render list front to back, UINT32_MAX until it is added
+	uint32_t m_RenderRank = UINT32_MAX;
+
 public:
 	Chunk(const glm::vec3& coord)
 		: m_Coord(coord) {}
 
 	~Chunk();
 
-	void Fill(SimplexNoise* noise);
+	void Fill(SimplexNoise* noise, uint32_t seed);
 
-	void GenerateMesh(CubeWorld* world, Mesh& mesh);
+	bool Load(WorldStorage* storage);
+
+	// Copy the blocks if modified since the last snapshot, under the chunk lock
+	bool Snapshot(ChunkBlock* data);
+
+	// A snapshot that never reached the disk, the next one copies the blocks again
+	void RestoreModified();
+
+	void GenerateMesh(CubeWorld* world, Mesh& mesh, bool sections = false);
+
+	// Neighbors in ZYX order (see GetChunkNeighbors), nullptr above and below the world
+	void GenerateMesh(Chunk* chunks[27], Mesh& mesh, bool sections = false);
+
+	// Mesh the faces of the blocks of one section, appended to mesh
+	void GenerateSection(Chunk* chunks[27], int section, Mesh& mesh);
+
+	// Mesh the blocks downsampled by 2^lod, with skirts on the sides of the chunk
+	void GenerateLodMesh(Chunk* chunks[27], int lod, Mesh& mesh);
+
+	// Mesh only the slices a change of the blocks from-to can alter (local, one outside the chunk for a neighbor edit)
+	void GenerateSlices(Chunk* chunks[27], const glm::ivec3& from, const glm::ivec3& to, Mesh& mesh);
+
+	// Hash of every block and light value the mesh depends on, the chunk and the border layer of its neighbors
+	uint64_t ContentHash(Chunk* chunks[27]) const;
 	
-	void UploadMesh(const Mesh& mesh);
+	// Lay out upload.mesh and write it to new buffers, through the staging ring if it is mapped. The chunk is not
+	// touched (upload thread)
+	static void PrepareUpload(MeshUpload& upload, StagingRing* staging);
+
+	// Draw the buffers of a prepared upload from now on, once they are written (render thread). The buffers are
+	// deleted instead if the chunk was reset since
+	void SwapMesh(MeshUpload& upload);
+
+	// Replace the quads of the slices of from-to with the ones of GenerateSlices, only the changed ranges are uploaded
+	void UploadSlices(const Mesh& mesh, const glm::ivec3& from, const glm::ivec3& to);
+
+	// Replace the quads of one section with the ones of GenerateSection, only its range is uploaded if they fit
+	void UploadSection(int section, const Mesh& mesh);
 
-	void Render (Shader* shader) const;
-	void RenderT(Shader* shader) const;
+	// Sections (only used by the section layout) and faces (by FaceSide) are bit masks of what to draw
+	void Render (RenderStats& stats, uint8_t sections = 0xFF, uint8_t faces = 0x3F) const;
+	// The sorted order of the translucent quads if it is current, else (or if not sorted) the ranges as meshed
+	void RenderT(RenderStats& stats, uint8_t sections = 0xFF, bool sorted = true) const;
+
+	// A sort of the translucent quads if the camera entered a new cell around the chunk (or they changed) and none is
+	// in flight, the current order is drawn until UploadTranslucentOrder
+	bool TakeTranslucentSort(const glm::vec3& position, TranslucentSort& sort);
+
+	// The order of a sort from TakeTranslucentSort, dropped if the quads changed since
+	void UploadTranslucentOrder(const TranslucentSort& sort);
+
+	// The face directions of a box that can face a camera at position
+	static uint8_t VisibleFaces(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& position);
 
 	void RemoveTileEntity(const glm::vec3& coord);
 
@@ -140,6 +296,7 @@ public:
 			m_TileEntities[coord] = block->CreateTileEntity(coord);
 
 		m_Data[id].SetBlock(data, side);
+		m_Modified = true;
 	}
 
 	inline const void PlaceBlockS(uint32_t indx, uint32_t data, Block::Side side = Block::Side::Front)
@@ -151,25 +308,154 @@ public:
 	inline void  SetStage(const Stage& stage)       { m_Stage = stage; }
 	inline bool  IsStage (const Stage& stage) const { return m_Stage == stage; }
 
+	inline bool IsModified() const { return m_Modified; }
+
+	inline const ChunkBlock* GetData() const { return m_Data; }
+
+	// Allocated (dark) when the light engine lights the column
+	inline void AllocateLight() { if (m_Light == nullptr) m_Light = new uint8_t[CHUNK_SIZEQ]{}; }
+
+	inline       uint8_t* GetLightData()       { return m_Light; }
+	inline const uint8_t* GetLightData() const { return m_Light; }
+
+	inline uint8_t GetLight(int index) const { return m_Light ? m_Light[index] : LIGHT_FULL_SKY; }
+
+	inline bool HasSections() const { return m_Sectioned; }
+
+	// Vertex and element buffers
+	inline size_t GetBufferBytes() const { return (size_t)(m_BufferSize + m_TBufferSize) * sizeof(uint32_t) / QUAD_VERTICES * (QUAD_VERTICES + QUAD_INDICES); }
+
+	// The level the chunk is meshed at, set before meshing
+	inline int  GetLod() const  { return m_Lod; }
+	inline void SetLod(int lod) { m_Lod = lod; }
+
+	// Local bounds of the quads of a section, false if it has none
+	bool GetSectionBounds(int section, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+	// Local bounds of all the quads, false if it has none
+	bool GetBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+	// The sections holding the blocks from-to (local, clamped to the chunk)
+	void MarkSectionsDirty(const glm::ivec3& from, const glm::ivec3& to);
+
+	inline uint8_t TakeDirtySections() { const uint8_t dirty = m_DirtySections; m_DirtySections = 0; return dirty; }
+
+	// Flood fill the open blocks to find the faces they connect, before meshing and after an edit
+	void UpdateVisibility();
+
+	// Whether the open blocks connect two faces (by FaceSide), all of them until UpdateVisibility
+	inline bool IsConnected(int from, int to) const { return (m_Visibility >> (from * MESH_SIDES + to)) & 1; }
+
+	// Opaque blocks from the bottom of the chunk up in every column of a cell (x + z * OCCLUDER_AXIS), from UpdateVisibility
+	inline int GetSolidHeight(int cell) const { return (int)((m_SolidHeights[cell / 8] >> (cell % 8 * 8)) & 0xFF); }
+
+	// Set by the light engine once the light of the chunk and its neighbors is final
+	inline bool IsLightReady() const { return m_LightReady; }
+	inline void SetLightReady()      { m_LightReady = true; }
+
 private:
+	// The planes (x[d] of the mesher) of each facing and the blocks in u and v to mesh
+	struct FaceRange
+	{
+		glm::ivec3 planeFrom[2], planeTo[2]; // Front, Back
+		glm::ivec3 from, to;
+	};
+
+	void GenerateFaces(Chunk* chunks[27], const FaceRange& range, Mesh& mesh);
+
+	// Greedy merge of one plane of faces into quads, the mask has stride cells per row and each covers scale blocks
+	static void MergeFaces(FaceMask* mask, int stride, int scale, int x[3], int d, FaceSide side, bool backFace,
+		const glm::ivec3& from, const glm::ivec3& to, Mesh& mesh, uint32_t& indicesCount, uint32_t& indicesTCount);
+
+	// Vote the block of a scale^3 cell from its local origin, it can reach into the neighbors
+	void DownsampleCell(Chunk* chunks[27], const glm::ivec3& origin, int scale, ChunkBlock& cell, uint8_t& light) const;
+
 	ChunkBlock GetNeighborBlock(Chunk* chunks[26], int x[3], int d, bool isNeighF, int v) const;
 
 	void CalculateAO(Chunk* chunks[26], AO& ao, int x, int y, int z, int du[3], int dv[3]) const;
 
 	int GetAONeighborBlock(Chunk* chunks[26], int x, int y, int z) const;
 
+	uint8_t GetNeighborLight(Chunk* chunks[26], int x, int y, int z) const;
+
 	bool CoordinateInBound(int* x, int* y, int* z, int* neighborIndx, bool* upBorder, bool* downBorder) const;
 
+	void SetStream   (int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices);
+	void SpliceStream(int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, const glm::ivec3& from, const glm::ivec3& to);
+
+	void SpliceSection(int stream, int section, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices);
+
+	// SetStream with the quads in use and the new ones from firstQuad on
+	void RelayoutStream(int stream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, uint32_t firstQuad);
+
+	void FreeQuad(int stream, uint32_t q);
+
+	int QuadRange(const uint32_t* vertices) const;
+	static int QuadRange(const uint32_t* vertices, bool sectioned);
+
+	// Free quads and ranges for the quads of a whole mesh, as SetStream lays them out
+	static void LayoutStream(MeshStream& meshStream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices, bool sectioned, bool spliced);
+
+	// The ranges of the layout and the range of every quad, the quads it takes in all
+	static uint32_t LayoutRanges(MeshStream& meshStream, const std::vector<uint32_t>& vertices, bool sectioned, bool spliced, std::vector<uint8_t>& quadRanges);
+
+	// The quads in their ranges, in order. Also written to out (vertices then indices) in the same pass if given
+	static void LayoutQuads(MeshStream& meshStream, const std::vector<uint32_t>& vertices, const std::vector<uint32_t>& indices,
+		const std::vector<uint8_t>& quadRanges, uint32_t total, uint8_t* out);
+
+	// Bounds of the quads of the ranges from-to of both streams (min > max if none)
+	static void RangesBounds(const MeshStream streams[2], int rangeFrom, int rangeTo, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	// Union of the bounds of the sections
+	static void SectionsBounds(const glm::vec3 sectionMin[SECTION_COUNT], const glm::vec3 sectionMax[SECTION_COUNT], glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	void UpdateSectionBounds(int section);
+	void UpdateBounds();
+
+	void DrawStream(int stream, RenderStats& stats, uint8_t sections, uint8_t faces) const;
+
+	// Size the buffers for the stream, true if they were reallocated (and are empty)
+	bool ReserveBuffers(int stream);
+	// The vertex layout of the stream on its current buffers, its VAO created if there is none
+	void BindStreamBuffers(int stream);
+	void UploadQuads(int stream, uint32_t first, uint32_t count);
+
 private:
 	ChunkBlock* m_Data = nullptr;
 
+	uint8_t* m_Light = nullptr;
+	std::atomic<bool> m_LightReady = false;
+
+	std::atomic<uint64_t> m_Visibility = ~0ull; // Bit from * MESH_SIDES + to
+	std::atomic<uint64_t> m_SolidHeights[OCCLUDER_CELLS / 8]{}; // A byte per cell
+
 	std::unordered_map<glm::vec3, TileEntity*> m_TileEntities;
 	std::queue<glm::vec3> m_TileEntitiesToRemove;
 
 	Stage m_Stage = Stage::Initialized;
 
+	bool m_Modified = false;
+
 	uint32_t m_VAO [2]{ 0, 0 };
 	uint32_t m_VBIO[4]{ 0, 0, 0, 0 };
 
 	uint32_t m_BufferSize = 0, m_TBufferSize = 0;
+
+	MeshStream m_Streams[2]; // Opaque, Translucent
+
+	// The translucent quads sorted from the camera cell m_SortCell, drawn instead of their ranges while m_SortedVersion is current
+	uint32_t m_SortVAO = 0, m_SortIBO = 0, m_SortIBOSize = 0, m_SortedCount = 0;
+	uint32_t m_TVersion = 0, m_SortedVersion = UINT32_MAX;
+	glm::ivec3 m_SortCell{ INT32_MIN };
+	bool m_SortPending = false;
+
+	std::vector<glm::vec3> m_TCentroids; // Of the translucent quads in use, by slot order
+	uint32_t m_TCentroidsVersion = UINT32_MAX;
+
+	bool m_Sectioned = false, m_Spliced = true;
+	std::atomic<int> m_Lod = 0;
+	uint8_t m_DirtySections = 0;
+
+	glm::vec3 m_SectionMin[SECTION_COUNT], m_SectionMax[SECTION_COUNT];
+	glm::vec3 m_BoundsMin{ 1.0f }, m_BoundsMax{ -1.0f };
 };
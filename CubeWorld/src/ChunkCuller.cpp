@@ -0,0 +1,227 @@
+#include "ChunkCuller.h"
+
+#include "utils/Timer.h"
+
+#include <cfloat>
+#include <bit>
+
+template<int N>
+void ChunkCuller::BoundsArray<N>::Set(int i, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	minX[i] = boundsMin.x; minY[i] = boundsMin.y; minZ[i] = boundsMin.z;
+	maxX[i] = boundsMax.x; maxY[i] = boundsMax.y; maxZ[i] = boundsMax.z;
+}
+
+template<int N>
+void ChunkCuller::BoundsArray<N>::Merge(int i, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	boundsMin = glm::vec3{ minX[i] < boundsMin.x ? minX[i] : boundsMin.x, minY[i] < boundsMin.y ? minY[i] : boundsMin.y, minZ[i] < boundsMin.z ? minZ[i] : boundsMin.z };
+	boundsMax = glm::vec3{ maxX[i] > boundsMax.x ? maxX[i] : boundsMax.x, maxY[i] > boundsMax.y ? maxY[i] : boundsMax.y, maxZ[i] > boundsMax.z ? maxZ[i] : boundsMax.z };
+}
+
+void ChunkCuller::Update(Chunk* chunk)
+{
+	const glm::ivec3 chunkCoord = glm::ivec3(glm::floor(chunk->m_Coord / (float)CHUNK_SIZE));
+	if (chunkCoord.y < 0 || chunkCoord.y >= CHUNK_Y_COUNT)
+		return;
+
+	glm::vec3 boundsMin, boundsMax;
+	const bool hasQuads = chunk->GetBounds(boundsMin, boundsMax);
+
+	const glm::ivec2 regionCoord{ (int)std::floor(chunkCoord.x / (float)CULL_REGION_SIZE), (int)std::floor(chunkCoord.z / (float)CULL_REGION_SIZE) };
+
+	auto it = m_RegionIndex.find(regionCoord);
+	if (it == m_RegionIndex.end())
+	{
+		if (!hasQuads)
+			return;
+
+		it = m_RegionIndex.insert({ regionCoord, (uint32_t)m_Regions.size() }).first;
+
+		m_Regions.push_back(std::make_unique<CullRegion>());
+		if (m_Regions.size() > m_RegionBounds.size() * 4)
+			m_RegionBounds.emplace_back();
+	}
+
+	const uint32_t regionIndex = it->second;
+	CullRegion& region = *m_Regions[regionIndex];
+
+	const int columnIndex = (chunkCoord.x - regionCoord.x * CULL_REGION_SIZE) + (chunkCoord.z - regionCoord.y * CULL_REGION_SIZE) * CULL_REGION_SIZE;
+	CullColumn& column = region.columns[columnIndex];
+
+	// The chunk, then the bounds of its column and region again
+	column.chunks[chunkCoord.y] = chunk;
+	if (hasQuads)
+	{
+		column.chunkBounds.Set(chunkCoord.y, chunk->m_Coord + boundsMin, chunk->m_Coord + boundsMax);
+		column.alive |= 1 << chunkCoord.y;
+	}
+	else
+		column.alive &= ~(1 << chunkCoord.y);
+
+	boundsMin = glm::vec3{ FLT_MAX };
+	boundsMax = glm::vec3{ -FLT_MAX };
+	for (int y = 0; y < CHUNK_Y_COUNT; ++y)
+		if (column.alive & (1 << y))
+			column.chunkBounds.Merge(y, boundsMin, boundsMax);
+
+	region.columnBounds.Set(columnIndex, boundsMin, boundsMax);
+	if (column.alive)
+		region.alive |= 1ull << columnIndex;
+	else
+		region.alive &= ~(1ull << columnIndex);
+
+	boundsMin = glm::vec3{ FLT_MAX };
+	boundsMax = glm::vec3{ -FLT_MAX };
+	for (int c = 0; c < CULL_REGION_COLUMNS; ++c)
+		if (region.alive & (1ull << c))
+			region.columnBounds.Merge(c, boundsMin, boundsMax);
+
+	m_RegionBounds[regionIndex / 4].Set(regionIndex % 4, boundsMin, boundsMax);
+}
+
+void ChunkCuller::Cull(const Frustum& frustum, std::vector<Chunk*>& visible)
+{
+	Timer timer;
+
+	// The cave fields are from CullCaves just before
+	m_Stats.Regions       = m_Stats.Columns       = m_Stats.Chunks       = 0;
+	m_Stats.RegionsCulled = m_Stats.ColumnsCulled = m_Stats.ChunksCulled = 0;
+	m_Stats.CaveCulled = 0;
+
+	if (!m_CaveCulling)
+	{
+		m_Stats.CaveReached = 0;
+		m_Stats.CaveMicros = 0.0f;
+	}
+
+	for (uint32_t first = 0; first < m_Regions.size(); first += 4)
+	{
+		const int inside = m_RegionBounds[first / 4].Intersect4(frustum, 0);
+
+		for (uint32_t i = first; i < first + 4 && i < m_Regions.size(); ++i)
+		{
+			const CullRegion& region = *m_Regions[i];
+			if (!region.alive)
+				continue;
+
+			++m_Stats.Regions;
+			if (!(inside & (1 << (i - first))))
+			{
+				++m_Stats.RegionsCulled;
+				continue;
+			}
+
+			CullRegionColumns(frustum, region, visible);
+		}
+	}
+
+	m_CaveCulling = false;
+
+	m_Stats.CullMicros = timer.ElapsedMillis() * 1000.0f;
+}
+
+void ChunkCuller::CullCaves(const Frustum& frustum, const glm::vec3& position, const std::unordered_map<glm::vec3, Chunk*>& chunks)
+{
+	Timer timer;
+
+	m_Stats.CaveReached = 0;
+	m_CaveCulling = false;
+
+	auto start = chunks.find(glm::floor(position / (float)CHUNK_SIZE) * (float)CHUNK_SIZE);
+	if (start == chunks.end())
+	{
+		m_Stats.CaveMicros = timer.ElapsedMillis() * 1000.0f;
+		return;
+	}
+
+	static const glm::vec3 offsets[MESH_SIDES]{ { 0, 0, CHUNK_SIZE }, { 0, 0, -CHUNK_SIZE }, { 0, CHUNK_SIZE, 0 }, { 0, -CHUNK_SIZE, 0 }, { CHUNK_SIZE, 0, 0 }, { -CHUNK_SIZE, 0, 0 } };
+
+	++m_CaveFrame;
+	m_CaveCulling = true;
+
+	m_CaveSteps.clear();
+	m_CaveSteps.push_back({ start->second, -1, 0 });
+	start->second->m_CaveFrame = m_CaveFrame;
+
+	for (size_t i = 0; i < m_CaveSteps.size(); ++i)
+	{
+		const CaveStep step = m_CaveSteps[i];
+
+		for (int dir = 0; dir < MESH_SIDES; ++dir)
+		{
+			// Opposite directions only differ in the lowest bit
+			if (step.directions & (1 << (dir ^ 1)))
+				continue;
+
+			if (step.from >= 0 && !step.chunk->IsConnected(step.from, dir))
+				continue;
+
+			const glm::vec3 coord = step.chunk->m_Coord + offsets[dir];
+			if (coord.y < 0.0f || coord.y >= CHUNK_MAX_HEIGHT)
+				continue;
+
+			auto it = chunks.find(coord);
+			if (it == chunks.end() || it->second->m_CaveFrame == m_CaveFrame)
+				continue;
+
+			if (!frustum.AABBIntersect(coord, coord + (float)CHUNK_SIZE))
+				continue;
+
+			it->second->m_CaveFrame = m_CaveFrame;
+			m_CaveSteps.push_back({ it->second, dir ^ 1, (uint8_t)(step.directions | (1 << dir)) });
+		}
+	}
+
+	m_Stats.CaveReached = (uint32_t)m_CaveSteps.size();
+	m_Stats.CaveMicros = timer.ElapsedMillis() * 1000.0f;
+}
+
+void ChunkCuller::CullRegionColumns(const Frustum& frustum, const CullRegion& region, std::vector<Chunk*>& visible)
+{
+	for (int first = 0; first < CULL_REGION_COLUMNS; first += 4)
+	{
+		const int alive = (int)((region.alive >> first) & 0xF);
+		if (!alive)
+			continue;
+
+		const int inside = region.columnBounds.Intersect4(frustum, first) & alive;
+
+		m_Stats.Columns       += std::popcount((uint32_t)alive);
+		m_Stats.ColumnsCulled += std::popcount((uint32_t)(alive & ~inside));
+
+		for (int i = 0; i < 4; ++i)
+			if (inside & (1 << i))
+				CullColumnChunks(frustum, region.columns[first + i], visible);
+	}
+}
+
+void ChunkCuller::CullColumnChunks(const Frustum& frustum, const CullColumn& column, std::vector<Chunk*>& visible)
+{
+	for (int first = 0; first < CHUNK_Y_COUNT; first += 4)
+	{
+		const int alive = (column.alive >> first) & 0xF;
+		if (!alive)
+			continue;
+
+		const int inside = column.chunkBounds.Intersect4(frustum, first) & alive;
+
+		m_Stats.Chunks       += std::popcount((uint32_t)alive);
+		m_Stats.ChunksCulled += std::popcount((uint32_t)(alive & ~inside));
+
+		for (int i = 0; i < 4; ++i)
+		{
+			if (!(inside & (1 << i)))
+				continue;
+
+			Chunk* chunk = column.chunks[first + i];
+			if (m_CaveCulling && chunk->m_CaveFrame != m_CaveFrame)
+			{
+				++m_Stats.CaveCulled;
+				continue;
+			}
+
+			visible.push_back(chunk);
+		}
+	}
+}
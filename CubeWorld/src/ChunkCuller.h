@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Chunk.h"
+#include "Frustum.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+#define CULL_REGION_SIZE 8 // Columns on a side of a region
+#define CULL_REGION_COLUMNS (CULL_REGION_SIZE * CULL_REGION_SIZE)
+
+struct CullStats
+{
+	// Tested and rejected at each level, only the ones with something to draw
+	uint32_t Regions = 0, Columns = 0, Chunks = 0;
+	uint32_t RegionsCulled = 0, ColumnsCulled = 0, ChunksCulled = 0;
+
+	// Chunks the cave culling walked to, and in the frustum but not reached
+	uint32_t CaveReached = 0, CaveCulled = 0;
+
+	float CullMicros = 0.0f, CaveMicros = 0.0f; // Last Cull and CullCaves
+};
+
+// Frustum culling of the meshed chunks by the tight bounds of their quads. The test goes
+// from the regions of CULL_REGION_SIZE^2 columns to their columns and the chunks in them,
+// the bounds of each level are stored component by component to test four boxes at once.
+// Not thread safe, the world updates and culls on the main thread.
+class ChunkCuller
+{
+public:
+	// Add a chunk or refresh its bounds after it was meshed, one without quads is skipped
+	void Update(Chunk* chunk);
+
+	// Append the chunks in the frustum
+	void Cull(const Frustum& frustum, std::vector<Chunk*>& visible);
+
+	// Walk from the chunk at position through the faces the open blocks of each chunk connect,
+	// never back toward it, the next Cull drops the chunks not reached. Nothing is dropped when
+	// there is no chunk at position (above the world).
+	void CullCaves(const Frustum& frustum, const glm::vec3& position, const std::unordered_map<glm::vec3, Chunk*>& chunks);
+
+	inline size_t GetRegionsCount() const { return m_Regions.size(); }
+
+	inline const CullStats& GetStats() const { return m_Stats; }
+
+private:
+	template<int N>
+	struct BoundsArray
+	{
+		alignas(16) float minX[N]{}, minY[N]{}, minZ[N]{};
+		alignas(16) float maxX[N]{}, maxY[N]{}, maxZ[N]{};
+
+		void Set(int i, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+		void Merge(int i, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+		inline int Intersect4(const Frustum& frustum, int first) const
+		{
+			return frustum.AABBIntersect4(&minX[first], &minY[first], &minZ[first], &maxX[first], &maxY[first], &maxZ[first]);
+		}
+	};
+
+	static_assert(CHUNK_Y_COUNT % 4 == 0 && CULL_REGION_COLUMNS % 4 == 0, "Levels are tested four boxes at a time");
+
+	struct CullColumn
+	{
+		BoundsArray<CHUNK_Y_COUNT> chunkBounds;
+		Chunk* chunks[CHUNK_Y_COUNT]{};
+
+		uint8_t alive = 0; // Chunks with quads
+	};
+
+	struct CullRegion
+	{
+		BoundsArray<CULL_REGION_COLUMNS> columnBounds;
+		CullColumn columns[CULL_REGION_COLUMNS];
+
+		uint64_t alive = 0; // Columns with quads
+	};
+
+	struct CaveStep
+	{
+		Chunk* chunk;
+		int from;           // Face it was entered from, -1 for the first
+		uint8_t directions; // Taken on the way, by FaceSide
+	};
+
+	void CullRegionColumns(const Frustum& frustum, const CullRegion& region, std::vector<Chunk*>& visible);
+
+	void CullColumnChunks(const Frustum& frustum, const CullColumn& column, std::vector<Chunk*>& visible);
+
+private:
+	std::vector<std::unique_ptr<CullRegion>> m_Regions;
+	std::vector<BoundsArray<4>> m_RegionBounds; // Four regions each
+
+	std::unordered_map<glm::ivec2, uint32_t> m_RegionIndex;
+
+	std::vector<CaveStep> m_CaveSteps;
+	uint32_t m_CaveFrame = 0;
+	bool m_CaveCulling = false; // For the next Cull
+
+	CullStats m_Stats;
+};
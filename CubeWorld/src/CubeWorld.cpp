@@ -9,6 +9,8 @@
 
 #include "Application.h"
 
+#include <glm/gtc/constants.hpp>
+
 void CubeWorld::Init()
 {
 	SettupOpenGLSettings();
@@ -16,8 +18,18 @@ void CubeWorld::Init()
 	InitFramebuffer();
 	InitCrosshair();
 	InitInteract();
+	InitDrawData();
 
 	m_ThreadPool = std::make_unique<ThreadPool>(std::thread::hardware_concurrency() - 1);
+
+	m_Storage = std::make_unique<WorldStorage>(m_Settings.SavePath);
+	if (!m_Storage->LoadSeed(&m_GenerationSettings.Seed))
+		m_Storage->SaveSeed(m_GenerationSettings.Seed);
+
+	m_Saver = std::make_unique<ChunkSaver>(m_Storage.get(), m_Settings.SaveInterval);
+
+	if (m_Settings.UseMeshCache)
+		m_MeshCache = std::make_unique<MeshCache>(m_Settings.SavePath);
 	
 	m_Noise = std::make_unique<SimplexNoise>(m_GenerationSettings.Frequency, m_GenerationSettings.Amplitude, m_GenerationSettings.Lacunarity, m_GenerationSettings.Persistence);
 
@@ -30,12 +42,21 @@ void CubeWorld::Init()
 	m_Camera->RecalculateView();
 
 	m_Frustum = std::make_unique<Frustum>();
+	m_Culler = std::make_unique<ChunkCuller>();
 
-	m_Texture = std::make_unique<Texture>("res/textures/terrain.png", GL_NEAREST, GL_NEAREST, true, true, true);
+	// A few bands, the pool of the chunks keeps the other cores busy
+	const unsigned int occlusionBands = std::thread::hardware_concurrency() / 4;
+	m_Occlusion = std::make_unique<OcclusionBuffer>(occlusionBands < 1 ? 1 : occlusionBands > 4 ? 4 : occlusionBands);
+	m_Queries = std::make_unique<OcclusionQueries>();
+	m_RenderList = std::make_unique<RenderList>();
+
+	// 16 pixel tiles, a layer each
+	m_Texture = std::make_unique<TextureArray>("res/textures/terrain.png", 16, GL_NEAREST_MIPMAP_LINEAR, GL_NEAREST, true, true);
 
 	m_Shader = std::make_unique<Shader>("res/shaders/terrain.shader");
 	m_Shader->Bind();
 	m_Shader->SetUniform1i("u_Texture", 0);
+	m_WeightedBlendLocation = m_Shader->GetUniformLocation("u_WeightedBlend");
 
 	m_GenerationTimer.Reset();
 
@@ -53,6 +74,8 @@ void CubeWorld::Init()
 	m_CrosshairShader->Bind();
 	m_CrosshairShader->SetUniform1i("u_Texture", 0);
 
+	m_CrosshairVPLocation = m_CrosshairShader->GetUniformLocation("u_VP");
+
 	// Crosshair
 	{
 		const float crosshairSize = 85.0f, halfCrosshairSize = crosshairSize / 2;
@@ -80,35 +103,39 @@ void CubeWorld::Init()
 
 	// Blocks Manager
 	{
-		float stepX = 1.0f / (m_Texture->GetWidth() / 16.0f);
-		float stepY = 1.0f / (m_Texture->GetHeight() / 16.0f);
-		m_AtlasStep = glm::vec2{ stepX, stepY };
+		m_AtlasStep = m_Texture->GetStep();
 
-		m_Shader->Bind();
-		m_Shader->SetUniform2f("u_Step", m_AtlasStep.x, m_AtlasStep.y);
+		RegisterBlocks(m_AtlasStep);
 
-		Block* block;
-		block = new Block("Air",     { { 10 * stepX, 14 * stepY } });
-		block->m_IsTransparent = true;
+		BlocksManager::UploadBlocks(*m_Texture);
 
-		block = new Block("Dirt",    { {  2 * stepX, 15 * stepY } });
-		block = new Block("Grass",   { {  0 * stepX, 15 * stepY } });
-		block = new Block("Stone",   { {  1 * stepX, 15 * stepY } });
+		m_LightEngine = std::make_unique<LightEngine>();
+	}
 
-		block = new Block("Water",   { { 13 * stepX,  3 * stepY } });
-		block->m_IsTransparent = true;
-		block->m_IsTranslucent = true;
-		block->m_IsLiquid      = true;
+	// Journal (Needs the blocks to replay the edits)
+	{
+		ReplayJournal();
 
-		block = new Block("Glass",   { {  1 * stepX, 12 * stepY } });
-		block->m_IsTransparent = true;
+		m_Journal = std::make_unique<WorldJournal>(m_Settings.SavePath, m_Settings.JournalCommitInterval, m_Settings.JournalCheckpointInterval);
+		m_Journal->SetCheckpointCallback([this]()
+		{
+			// Both, a failed flush still leaves chunks written that want the sync
+			const bool flushed = m_Saver->Flush();
+			return m_Storage->Sync() && flushed;
+		});
+		m_Journal->Open();
 
-		block = new Block("Sand",    { {  2 * stepX, 14 * stepY } });
-		block = new Block("Snow",    { {  2 * stepX, 11 * stepY } });
+		m_Saver->SetJournal(m_Journal.get());
+	}
 
-		block = new Block("Bedrock", { {  1 * stepX, 14 * stepY } });
+	// Streams around the camera from now on, the render thread (this one) keeps the GL context
+	{
+		m_ViewPosition = m_Camera->GetPosition();
+		m_ViewDirection = m_Camera->GetDirection();
+		m_ViewSettings = m_TickSettings = m_Settings;
 
-		BlocksManager::UploadBlocks();
+		m_WorldThreadRunning = true;
+		m_WorldThread = std::thread(&CubeWorld::RunWorldThread, this);
 	}
 
 	// To Implement
@@ -135,31 +162,42 @@ void CubeWorld::SettupOpenGLSettings()
 
 void CubeWorld::InitFramebuffer()
 {
-	m_Width = m_Specification->Width;
-	m_Height = m_Specification->Height;
-
-	m_WidthScaled = (uint32_t)(m_Width * m_Specification->ScreenScaleFactor);
-	m_HeightScaled = (uint32_t)(m_Height * m_Specification->ScreenScaleFactor);
-
-
 	GLCall(glGenFramebuffers(1, &m_FBO));
 	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_FBO));
 
+	// Read by the downsample, filtered bilinearly only when smaller than the window
 	GLCall(glGenTextures(1, &m_FBOColor));
 	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOColor));
-	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_WidthScaled, m_HeightScaled, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 
-	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_FBOColor, 0));
-
 	GLCall(glGenRenderbuffers(1, &m_FBODepth));
-	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_FBODepth));
-	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_WidthScaled, m_HeightScaled));
 
+	// Weighted blended transparency targets, drawn to only by the translucent pass and read with texelFetch
+	GLCall(glGenTextures(1, &m_FBOAccum));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOAccum));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+
+	GLCall(glGenTextures(1, &m_FBORevealage));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBORevealage));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+
+	ResizeFramebuffer();
+
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_FBOColor, 0));
 	GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_FBODepth));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_FBOAccum, 0));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_FBORevealage, 0));
+
+	GLCall(glGenQueries(TRANSPARENCY_TIMERS, m_TransparencyTimers));
+
+	m_Resolution = std::make_unique<ResolutionScaler>();
+
+	m_Uploader = std::make_unique<MeshUploader>();
 
 
 	{
@@ -173,7 +211,15 @@ void CubeWorld::InitFramebuffer()
 
 
 	// Frame Buffer Quad
-	m_FBOShader = std::make_unique<Shader>("res/shaders/uv.shader");
+	m_FBOShader = std::make_unique<Shader>("res/shaders/downsample.shader");
+	m_FBOShader->Bind();
+	m_FBOShader->SetUniform1i("u_Texture", 0);
+	m_FBOScaleLocation = m_FBOShader->GetUniformLocation("u_Scale");
+
+	m_CompositeShader = std::make_unique<Shader>("res/shaders/composite.shader");
+	m_CompositeShader->Bind();
+	m_CompositeShader->SetUniform1i("u_Accum", 0);
+	m_CompositeShader->SetUniform1i("u_Revealage", 1);
 
 	float quad[] =
 	{
@@ -199,6 +245,50 @@ void CubeWorld::InitFramebuffer()
 	GLCall(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float))));
 }
 
+void CubeWorld::ResizeFramebuffer()
+{
+	m_Width = m_Specification->Width;
+	m_Height = m_Specification->Height;
+
+	m_WidthScaled = (uint32_t)(m_Width * m_Specification->ScreenScaleFactor);
+	m_HeightScaled = (uint32_t)(m_Height * m_Specification->ScreenScaleFactor);
+
+	// Storage given again to the same names, the attachments of m_FBO stay as they are
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOColor));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_WidthScaled, m_HeightScaled, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_FBODepth));
+	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_WidthScaled, m_HeightScaled));
+
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOAccum));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_WidthScaled, m_HeightScaled, 0, GL_RGBA, GL_HALF_FLOAT, NULL));
+
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_FBORevealage));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_WidthScaled, m_HeightScaled, 0, GL_RED, GL_UNSIGNED_BYTE, NULL));
+
+	if (m_Camera)
+	{
+		m_Camera->WindowResize(m_WidthScaled, m_HeightScaled);
+		m_Camera->RecalculateView();
+	}
+
+	// Centered again, 85 pixels at the default scale of 3
+	if (m_CrosshairVBO)
+	{
+		const float crosshairSize = 85.0f / 3.0f * m_Specification->ScreenScaleFactor, halfCrosshairSize = crosshairSize / 2;
+		const glm::vec2 center = { m_WidthScaled / 2, m_HeightScaled / 2 };
+		const float positions[] = {
+			center.x + halfCrosshairSize, center.y - halfCrosshairSize, 1.0f, 0.0f,
+			center.x + halfCrosshairSize, center.y + halfCrosshairSize, 1.0f, 1.0f,
+			center.x - halfCrosshairSize, center.y - halfCrosshairSize, 0.0f, 0.0f,
+			center.x - halfCrosshairSize, center.y + halfCrosshairSize, 0.0f, 1.0f
+		};
+
+		GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_CrosshairVBO));
+		GLCall(glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(positions), positions));
+	}
+}
+
 void CubeWorld::InitCrosshair()
 {
 	m_CrosshairTexture = std::make_unique<Texture>("res/textures/crosshair.png", GL_NEAREST, GL_NEAREST);
@@ -207,6 +297,8 @@ void CubeWorld::InitCrosshair()
 	m_CrosshairShader->Bind();
 	m_CrosshairShader->SetUniform1i("u_Texture", 0);
 
+	m_CrosshairVPLocation = m_CrosshairShader->GetUniformLocation("u_VP");
+
 	// Crosshair
 	{
 		const float crosshairSize = 85.0f, halfCrosshairSize = crosshairSize / 2;
@@ -303,40 +395,93 @@ void CubeWorld::InitInteract()
 	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * 6 * sizeof(uint32_t), indices, GL_STATIC_DRAW));
 }
 
+void CubeWorld::InitDrawData()
+{
+	GLCall(glGenBuffers(1, &m_FrameUBO));
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_FrameUBO));
+	GLCall(glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW));
+
+	// Sized by every frame
+	GLCall(glGenBuffers(1, &m_ChunkDrawSSBO));
+}
+
 CubeWorld::~CubeWorld()
 {
+	// Nothing is streamed or relit anymore
+	m_WorldThreadRunning = false;
+	if (m_WorldThread.joinable())
+		m_WorldThread.join();
+
+	// Writes the last dirty chunks and empties the journal
+	m_Journal->Close();
+	m_Journal->Checkpoint();
+
+	m_Saver.reset();
+	m_Journal.reset();
+
+	m_MeshCache.reset();
+
 	BlocksManager::Dispose();
 
 	GLCall(glDeleteVertexArrays(1, &m_CrosshairVAO));
 	GLCall(glDeleteBuffers(1, &m_CrosshairVBO));
 
+	GLCall(glDeleteBuffers(1, &m_FrameUBO));
+	GLCall(glDeleteBuffers(1, &m_ChunkDrawSSBO));
+
 	GLCall(glDeleteVertexArrays(1, &m_FBOQuadVAO));
 	GLCall(glDeleteBuffers(1, &m_FBOQuadVBO));
 
 	GLCall(glDeleteTextures(1, &m_FBOColor));
+	GLCall(glDeleteTextures(1, &m_FBOAccum));
+	GLCall(glDeleteTextures(1, &m_FBORevealage));
+	GLCall(glDeleteQueries(TRANSPARENCY_TIMERS, m_TransparencyTimers));
 	GLCall(glDeleteRenderbuffers(1, &m_FBODepth));
 	GLCall(glDeleteFramebuffers(1, &m_FBO));
 }
 
-void CubeWorld::Update(float timestep)
+void CubeWorld::RunWorldThread()
 {
-	if (Input::IsKeyDown(KeyCode::H))
-		m_Settings.MaxRenderDistance++;
+	m_TickPacer.Reset();
 
-	if (Input::IsKeyDown(KeyCode::G))
-		m_Settings.MaxRenderDistance--;
+	while (m_WorldThreadRunning)
+	{
+		// Fixed ticks, nothing in a tick scales with the time it took
+		m_TickPacer.Wait(m_Specification->TickDeltaTime);
+		Tick();
+	}
+}
 
-	const glm::vec3 cameraPosition = m_Camera->GetPosition();
-	const glm::vec3 cameraChunk = glm::floor(cameraPosition * CHUNK_SIZE_INV);
+void CubeWorld::Tick()
+{
+	Timer tickTimer;
+
+	{
+		std::lock_guard<std::mutex> viewL(m_ViewLock);
+		m_StreamPosition = m_ViewPosition;
+		m_StreamDirection = m_ViewDirection;
+
+		const int renderDistance = m_TickSettings.RenderDistance;
+		m_TickSettings = m_ViewSettings;
+		m_TickSettings.RenderDistance = renderDistance;
+	}
+
+	const glm::vec3 cameraChunk = glm::floor(m_StreamPosition * CHUNK_SIZE_INV);
 
 	{
-		int renderDist = m_Settings.RenderDistance, maxRenderDist = m_Settings.MaxRenderDistance;
+		int renderDist = m_TickSettings.RenderDistance, maxRenderDist = m_TickSettings.MaxRenderDistance;
+
+		size_t generating;
+		{
+			std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+			generating = m_GeneratingChunks.size();
+		}
 
-		if (m_GeneratingChunks.size() < 100 && std::abs(maxRenderDist - renderDist) > 0)
+		if (generating < 100 && std::abs(maxRenderDist - renderDist) > 0)
 		{
-			m_Settings.RenderDistance += glm::sign(maxRenderDist - renderDist);
+			m_TickSettings.RenderDistance += glm::sign(maxRenderDist - renderDist);
 
-			renderDist = m_Settings.RenderDistance;
+			renderDist = m_TickSettings.RenderDistance;
 
 			int i = 0;
 			m_UpdateCoord.resize((size_t)(renderDist * 2 + 1) * (size_t)(renderDist * 2 + 1) * CHUNK_Y_COUNT);
@@ -356,74 +501,190 @@ void CubeWorld::Update(float timestep)
 		BuildChunk(coord);
 	}
 
+	PrefetchChunks(cameraChunk);
+	m_Storage->UpdateStats();
 
-	m_Camera->OnUpdate(timestep);
-
-
-	uint16_t uploaded = 0;
-	while (m_ChunksUpload.size() > 0 && uploaded < 15)
 	{
-		const auto& [chunk, mesh] = m_ChunksUpload.front();
-
-		// I take the chunk and if it has a mesh I upload it to the GPU
-		const glm::vec3& coord = chunk->m_Coord;
+		std::vector<std::pair<Chunk*, glm::ivec3>> changes;
 		{
-			size_t vertices = mesh.vertices.size();
-			size_t tvertices = mesh.tvertices.size();
-			if (vertices <= 0 && tvertices <= 0)
-			{
-				std::lock_guard<std::mutex> uploadL(m_ChunksUploadLock);
-
-				m_ChunksUpload.pop();
-				continue;
-			}
+			std::lock_guard<std::mutex> changesL(m_LightChangesLock);
+			changes.swap(m_LightChanges);
+		}
 
-			chunk->UploadMesh(mesh);
+		// The chunks reached by the new light are meshed again once it settles
+		for (const auto& [chunk, localCoord] : changes)
+			m_LightEngine->OnBlockChanged(chunk, localCoord);
 
+		m_LightEngine->Update(m_TickSettings.LightBudget);
 
-			std::lock_guard<std::mutex> chunkL(m_MeshedChunksLock);
+		std::vector<Chunk*> litChunks;
+		m_LightEngine->TakeDirtyChunks(litChunks);
 
-			if (!m_MeshedChunks.contains(coord))
+		for (Chunk* chunk : litChunks)
+		{
+			// Still meshing with the old light, asked again next tick
+			bool isGenerating;
 			{
-				m_MeshedChunks[coord] = chunk;
-				m_TotalBytes += vertices * sizeof(uint32_t) + tvertices * sizeof(uint32_t);
+				std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+				isGenerating = m_GeneratingChunks.contains(chunk->m_Coord);
 			}
-		}
 
-		{
-			std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
-			m_GeneratingChunks.erase(coord);
+			if (isGenerating)
+				m_LightEngine->MarkDirty(chunk);
+			else
+				SetChunkDirty(chunk, chunk->m_Coord);
 		}
+	}
+
+	UpdateLods();
+
+	{
+		std::lock_guard<std::mutex> dirtyLock(m_DirtyChunksLock);
 
+		while (m_DirtyChunks.size() > 0)
 		{
-			std::lock_guard<std::mutex> uploadL(m_ChunksUploadLock);
-			m_ChunksUpload.pop();
-		}
+			Chunk* chunk = m_DirtyChunks.front();
 
-		uploaded++;
-	}
+			UpdateChunkMesh(chunk);
 
-	//if (uploaded > 0)
-	//	std::cout << "Chunks Uploaded: " << uploaded << std::endl;
+			m_DirtyChunks.pop();
+		}
+	}
 
-	if (m_Settings.RenderDistance == m_Settings.MaxRenderDistance && m_ThreadPool->GetTaksCount() <= 0 && m_ChunksUpload.size() == 0 && !m_WorldGenerated)
+	if (m_TickSettings.RenderDistance == m_TickSettings.MaxRenderDistance && m_ThreadPool->GetTaksCount() <= 0 && m_ChunksUpload.size() == 0 && !m_WorldGenerated)
 	{
 		m_WorldGenerated = true;
 		std::cout << "World Generation in " << m_GenerationTimer.ElapsedMillis() << " ms" << std::endl;
 	}
 
+	// Worker throughput, what the other threads leave them shows here
+	++m_Ticks;
+	if (m_WorkerTimer.ElapsedSeconds() >= 1.0f)
+	{
+		const uint64_t completed = m_ThreadPool->GetCompletedCount();
+		m_WorkerTasksPerSecond = (completed - m_WorkerTasks) / m_WorkerTimer.ElapsedSeconds();
+		m_TicksPerSecond = (m_Ticks - m_TimerTicks) / m_WorkerTimer.ElapsedSeconds();
+		m_WorkerTasks = completed;
+		m_TimerTicks = m_Ticks;
+		m_WorkerTimer.Reset();
+	}
 
+	// The render thread has not taken the last packet, the meshes wait in the queue for the next one
+	if (m_WorldPackets.IsPending())
+		return;
+
+	WorldPacket& packet = m_WorldPackets.Back();
+	packet.Tick = m_Ticks;
+	packet.StreamCenter = cameraChunk;
+
+	packet.Uploads.clear();
 	{
-		std::lock_guard<std::mutex> dirtyLock(m_DirtyChunksLock);
+		std::lock_guard<std::mutex> uploadL(m_ChunksUploadLock);
+		for (; !m_ChunksUpload.empty(); m_ChunksUpload.pop())
+			packet.Uploads.push_back(std::move(m_ChunksUpload.front()));
+	}
 
-		while (m_DirtyChunks.size() > 0)
+	packet.RenderDistance = m_TickSettings.RenderDistance;
+	{
+		std::lock_guard<std::mutex> chunksL(m_ChunksLock);
+		packet.Chunks = m_Chunks.size();
+	}
+	{
+		std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+		packet.GeneratingChunks = m_GeneratingChunks.size();
+	}
+	packet.TotalBytes = m_TotalBytes;
+	packet.TickMillis = tickTimer.ElapsedMillis();
+	packet.TicksPerSecond = m_TicksPerSecond;
+	packet.WorkerTasksPerSecond = m_WorkerTasksPerSecond;
+	packet.Light = m_LightEngine->GetStats();
+	packet.Storage = m_Storage->GetStats();
+
+	m_WorldPackets.Publish();
+}
+
+void CubeWorld::Update(float timestep)
+{
+	// Frame time of the current translucent path, the overlay compares both
+	{
+		float& frameMillis = m_TransparencyStats.FrameMillis[m_Settings.OrderIndependentTransparency];
+		frameMillis = frameMillis == 0.0f ? timestep * 1000.0f : frameMillis + (timestep * 1000.0f - frameMillis) * 0.05f;
+	}
+
+	if (Input::IsKeyDown(KeyCode::H))
+		m_Settings.MaxRenderDistance++;
+
+	if (Input::IsKeyDown(KeyCode::G))
+		m_Settings.MaxRenderDistance--;
+
+	const glm::vec3 cameraPosition = m_Camera->GetPosition();
+
+	m_Camera->OnUpdate(timestep);
+
+	{
+		std::lock_guard<std::mutex> viewL(m_ViewLock);
+		m_ViewPosition = m_Camera->GetPosition();
+		m_ViewDirection = m_Camera->GetDirection();
+		m_ViewSettings = m_Settings;
+	}
+
+	// Rasterized while the rest of the frame goes on
+	if (m_Settings.OcclusionCulling)
+		BeginOcclusion();
+
+	// The meshes of the last tick wait their turn after the ones before
+	if (WorldPacket* packet = m_WorldPackets.Acquire())
+	{
+		for (auto& upload : packet->Uploads)
+			m_PendingUploads.push_back(std::move(upload));
+
+		packet->Uploads.clear();
+		std::swap(m_WorldStats, *packet);
+	}
+
+	// Written to their buffers on the upload thread, only swapped in here
+	{
+		Timer uploadTimer;
+
+		std::vector<MeshUpload> finished;
+		m_Uploader->TakeFinished(finished);
+
+		for (MeshUpload& upload : finished)
 		{
-			Chunk* chunk = m_DirtyChunks.front();
+			Chunk* chunk = upload.chunk;
+			const glm::vec3& coord = chunk->m_Coord;
 
-			UpdateChunkMesh(chunk);
+			{
+				// The world thread reads the stage, level and buffer sizes of the meshed chunks under it
+				std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
 
-			m_DirtyChunks.pop();
+				chunk->SwapMesh(upload);
+
+				if (!m_MeshedChunks.contains(coord))
+				{
+					m_MeshedChunks[coord] = chunk;
+					m_RenderList->Add(chunk);
+				}
+
+				m_Culler->Update(chunk);
+			}
+
+			// An edit until now meshed the chunk whole, the slices of the old mesh would have been lost
+			FinishChunkMesh(chunk);
+		}
+
+		while (m_PendingUploads.size() > 0 && m_Uploader->CanSubmit())
+		{
+			auto& [chunk, mesh] = m_PendingUploads.front();
+
+			if (mesh.vertices.size() > 0 || mesh.tvertices.size() > 0)
+				m_Uploader->Submit(chunk, std::move(mesh));
+
+			m_PendingUploads.pop_front();
 		}
+
+		const float millis = uploadTimer.ElapsedMillis();
+		m_UploadMillis = m_UploadMillis == 0.0f ? millis : m_UploadMillis + (millis - m_UploadMillis) * 0.05f;
 	}
 
 
@@ -432,10 +693,111 @@ void CubeWorld::Update(float timestep)
 
 	if (Input::IsKeyDown(KeyCode::Q))
 		PlaceBlock(cameraPosition, BlocksManager::GetBlock("Air"), FaceSide::Front);
+
+	if (Input::IsKeyDown(KeyCode::R))
+		PlaceBlock(cameraPosition, BlocksManager::GetBlock("Glowstone"), FaceSide::Front);
+
+	// The sections of this frame's edits
+	RemeshSections();
+}
+
+void CubeWorld::BeginOcclusion()
+{
+	const int distance = m_Settings.OcclusionDistance, cells = (distance * 2 + 1) * OCCLUDER_AXIS;
+	const glm::vec3 cameraChunk = glm::floor(m_Camera->GetPosition() * CHUNK_SIZE_INV);
+	const glm::vec3 origin = glm::vec3{ cameraChunk.x - distance, 0.0f, cameraChunk.z - distance } * (float)CHUNK_SIZE;
+
+	// Solid from the bottom of the world up, through the chunks solid in the whole cell
+	std::vector<int> heights((size_t)cells * cells, 0);
+	{
+		std::lock_guard<std::mutex> chunksL(m_ChunksLock);
+
+		for (int z = 0; z < distance * 2 + 1; ++z)
+			for (int x = 0; x < distance * 2 + 1; ++x)
+				for (int y = 0; y < CHUNK_Y_COUNT; ++y)
+				{
+					auto chunkIT = m_Chunks.find(glm::vec3{ origin.x + x * CHUNK_SIZE, y * CHUNK_SIZE, origin.z + z * CHUNK_SIZE });
+					if (chunkIT == m_Chunks.end())
+						break;
+
+					bool solid = false;
+					for (int cell = 0; cell < OCCLUDER_CELLS; ++cell)
+					{
+						int& height = heights[(x * OCCLUDER_AXIS + cell % OCCLUDER_AXIS) + (z * OCCLUDER_AXIS + cell / OCCLUDER_AXIS) * cells];
+						if (height != y * CHUNK_SIZE)
+							continue;
+
+						height += chunkIT->second->GetSolidHeight(cell);
+						solid = solid || height == (y + 1) * CHUNK_SIZE;
+					}
+
+					if (!solid)
+						break;
+				}
+	}
+
+	auto height = [&](int x, int z) { return x < 0 || z < 0 || x >= cells || z >= cells ? 0 : heights[x + z * cells]; };
+
+	// The tops, a quad for each run of cells as high along x, and the sides above the lower cells around
+	std::vector<OccluderQuad> occluders;
+	for (int z = 0; z < cells; ++z)
+		for (int x = 0; x < cells;)
+		{
+			const int top = height(x, z);
+
+			int end = x + 1;
+			while (end < cells && height(end, z) == top)
+				++end;
+
+			if (top > 0)
+				occluders.push_back({ origin + glm::vec3{ x * OCCLUDER_CELL, top, z * OCCLUDER_CELL }, origin + glm::vec3{ end * OCCLUDER_CELL, top, (z + 1) * OCCLUDER_CELL }, 1, 1.0f });
+
+			x = end;
+		}
+
+	for (int z = 0; z < cells; ++z)
+		for (int x = 0; x < cells; ++x)
+		{
+			const int top = height(x, z);
+			const glm::vec3 cell = origin + glm::vec3{ x * OCCLUDER_CELL, 0, z * OCCLUDER_CELL };
+
+			for (int side = 0; side < 4; ++side)
+			{
+				const int axis = side < 2 ? 0 : 2;
+				const float normal = side % 2 ? -1.0f : 1.0f;
+
+				const int below = axis == 0 ? height(x + (int)normal, z) : height(x, z + (int)normal);
+				if (below >= top)
+					continue;
+
+				glm::vec3 quadMin = cell + glm::vec3{ 0, below, 0 }, quadMax = cell + glm::vec3{ OCCLUDER_CELL, top, OCCLUDER_CELL };
+				if (normal > 0.0f)
+					quadMin[axis] = quadMax[axis];
+				else
+					quadMax[axis] = quadMin[axis];
+
+				occluders.push_back({ quadMin, quadMax, axis, normal });
+			}
+		}
+
+	m_Occlusion->Begin(m_Camera->GetViewProjection(), m_Camera->GetPosition(), std::move(occluders));
 }
 
 void CubeWorld::Render()
 {
+	// A step of scale at a time, from the GPU time of the frames before
+	if (m_Settings.DynamicResolution)
+	{
+		const float scale = m_Resolution->Update(m_Specification->ScreenScaleFactor, m_Settings.MinResolutionScale, m_Settings.MaxResolutionScale, m_Settings.TargetGpuMillis);
+		if (scale != m_Specification->ScreenScaleFactor)
+		{
+			m_Specification->ScreenScaleFactor = scale;
+			ResizeFramebuffer();
+		}
+	}
+
+	m_Resolution->BeginFrame();
+
 	glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
 	glViewport(0, 0, m_WidthScaled, m_HeightScaled);
 
@@ -445,44 +807,215 @@ void CubeWorld::Render()
 	const glm::mat4& VP = m_Camera->GetViewProjection();
 
 	m_Shader->Bind();
-	m_Shader->SetUniformMat4f("u_VP", VP);
 
 	m_Texture->Bind();
 
 	const glm::vec3& camPos = m_Camera->GetPosition();
-	m_Shader->SetUniform3fv("u_CamPos", 1, &camPos.x);
 
-	m_Shader->SetUniform1i("u_DebugNormal", m_DebugNormal);
-	m_Shader->SetUniform1i("u_DebugUV", m_DebugUV);
+	// Read by the terrain and the occlusion shaders
+	const FrameUniforms frameUniforms{ VP, camPos, m_DebugNormal, m_DebugUV };
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_FrameUBO));
+	GLCall(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frameUniforms));
+	GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, m_FrameUBO));
 
 	m_Frustum->Update(m_Camera.get());
 
-	BlocksManager::Bind();
+	BlocksManager::Bind(BLOCK_LAYERS_BINDING);
 
 	m_RenderedChunk = 0;
+	m_RenderStats = RenderStats{};
+
+	if (m_Settings.CaveCulling)
+	{
+		std::lock_guard<std::mutex> chunksL(m_ChunksLock);
+		m_Culler->CullCaves(*m_Frustum, camPos, m_Chunks);
+	}
 
 	{
 		std::lock_guard<std::mutex> chunksL(m_MeshedChunksLock);
 
-		std::vector<std::tuple<glm::vec3, Chunk*>> inFrustum;
-		inFrustum.reserve(m_MeshedChunks.size());
+		std::vector<Chunk*> visible;
+		visible.reserve(m_MeshedChunks.size());
+
+		m_Culler->Cull(*m_Frustum, visible);
+
+		// Front to back, the nearest ones fill the depth first
+		m_RenderList->Update(camPos);
+		m_RenderList->Order(visible, [](Chunk* chunk) { return chunk; });
 
-		Shader* shader = m_Shader.get();
-		for (auto& [coord, chunk] : m_MeshedChunks)
+		// The offsets of every chunk that may be drawn, a single upload before the first draw
+		m_ChunkDraws.clear();
+		for (Chunk* chunk : visible)
 		{
-			if (!m_Frustum->SphereIntersect(coord + HCHUNK_SIZE, SPHERE_CHUNK_RADIUS))
+			chunk->m_DrawIndex = (uint32_t)m_ChunkDraws.size();
+			m_ChunkDraws.push_back(glm::vec4{ chunk->m_Coord, 0.0f });
+		}
+
+		GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ChunkDrawSSBO));
+		GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, m_ChunkDraws.size() * sizeof(glm::vec4), m_ChunkDraws.data(), GL_STREAM_DRAW));
+		GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CHUNK_DRAW_BINDING, m_ChunkDrawSSBO));
+
+		// Waits for the bands started in Update
+		const bool occlusion = m_Occlusion->Finish() && m_Settings.OcclusionCulling;
+
+		// The chunks hidden at their last query are drawn after the rest, if their column passes
+		const bool queries = m_Settings.GpuOcclusion;
+
+		std::vector<Chunk*> hidden;
+		if (queries)
+		{
+			m_Queries->BeginFrame();
+			m_Queries->Split(visible, hidden);
+		}
+
+		// The drawn chunks with water or glass, and the query their draw is conditioned on
+		std::vector<std::tuple<Chunk*, uint8_t, uint32_t>> translucent;
+
+		// The sections and faces of a chunk to draw, false if none
+		auto prepare = [&](Chunk* chunk, uint8_t& sections, uint8_t& faces)
+		{
+			const glm::vec3& coord = chunk->m_Coord;
+
+			// Culled chunks have quads, so bounds
+			glm::vec3 boundsMin, boundsMax;
+			chunk->GetBounds(boundsMin, boundsMax);
+
+			if (occlusion && m_Occlusion->IsOccluded(coord + boundsMin, coord + boundsMax))
+				return false;
+
+			// The sections of a chunk at the edge of the view are culled one by one
+			sections = 0xFF;
+			if (chunk->HasSections())
+			{
+				sections = 0;
+
+				glm::vec3 sectionMin, sectionMax;
+				for (int s = 0; s < SECTION_COUNT; ++s)
+					if (chunk->GetSectionBounds(s, sectionMin, sectionMax) && m_Frustum->AABBIntersect(coord + sectionMin, coord + sectionMax))
+						sections |= 1 << s;
+
+				if (sections == 0)
+					return false;
+			}
+
+			faces = m_Settings.CullBackFaces ? Chunk::VisibleFaces(coord + boundsMin, coord + boundsMax, camPos) : 0x3F;
+			return true;
+		};
+
+		for (Chunk* chunk : visible)
+		{
+			uint8_t sections, faces;
+			if (!prepare(chunk, sections, faces))
 				continue;
 
-			chunk->Render(shader);
-			inFrustum.push_back({ coord, chunk });
+			if (queries)
+				m_Queries->BeginDraw(chunk);
+
+			chunk->Render(m_RenderStats, sections, faces);
+
+			if (queries)
+				m_Queries->EndDraw();
+
+			if (chunk->m_TIndicesCount > 0)
+				translucent.push_back({ chunk, sections, 0 });
+
 			++m_RenderedChunk;
 		}
 
-		// Order Chunks based on distance from camera
-		std::sort(inFrustum.begin(), inFrustum.end(), [&camPos](const std::tuple<glm::vec3, Chunk*>& c1, const std::tuple<glm::vec3, Chunk*>& c2)
+		if (!hidden.empty())
 		{
-			return glm::distance(std::get<0>(c1) + HCHUNK_SIZE, camPos) > glm::distance(std::get<0>(c2) + HCHUNK_SIZE, camPos);
-		});
+			std::vector<Chunk*> tested;
+			std::vector<std::pair<uint8_t, uint8_t>> masks;
+			for (Chunk* chunk : hidden)
+			{
+				uint8_t sections, faces;
+				if (!prepare(chunk, sections, faces))
+					continue;
+
+				tested.push_back(chunk);
+				masks.push_back({ sections, faces });
+			}
+
+			std::vector<uint32_t> conditions;
+			m_Queries->TestHidden(camPos, tested, conditions);
+
+			m_Shader->Bind();
+
+			// The GPU waits for the box queries issued just before, the CPU never does
+			for (size_t i = 0; i < tested.size(); ++i)
+			{
+				Chunk* chunk = tested[i];
+				const auto [sections, faces] = masks[i];
+
+				if (conditions[i])
+				{
+					GLCall(glBeginConditionalRender(conditions[i], GL_QUERY_WAIT));
+				}
+
+				chunk->Render(m_RenderStats, sections, faces);
+
+				if (conditions[i])
+				{
+					GLCall(glEndConditionalRender());
+				}
+
+				if (chunk->m_TIndicesCount > 0)
+					translucent.push_back({ chunk, sections, conditions[i] });
+
+				++m_RenderedChunk;
+			}
+		}
+
+		// Blended in any order into the weighted targets, nothing is sorted
+		const bool weighted = m_Settings.OrderIndependentTransparency;
+
+		// The result of the timer issued TRANSPARENCY_TIMERS frames ago, skipped if it is not there yet
+		const uint32_t timerSlot = m_TransparencyFrame++ % TRANSPARENCY_TIMERS;
+		if (m_TransparencyFrame > TRANSPARENCY_TIMERS)
+		{
+			GLuint available = GL_FALSE;
+			GLCall(glGetQueryObjectuiv(m_TransparencyTimers[timerSlot], GL_QUERY_RESULT_AVAILABLE, &available));
+			if (available)
+			{
+				GLuint64 nanos = 0;
+				GLCall(glGetQueryObjectui64v(m_TransparencyTimers[timerSlot], GL_QUERY_RESULT, &nanos));
+
+				float& passMillis = m_TransparencyStats.PassMillis[m_TransparencyTimerModes[timerSlot]];
+				passMillis = passMillis == 0.0f ? nanos * 1e-6f : passMillis + (nanos * 1e-6f - passMillis) * 0.05f;
+			}
+		}
+
+		m_TransparencyTimerModes[timerSlot] = weighted;
+		GLCall(glBeginQuery(GL_TIME_ELAPSED, m_TransparencyTimers[timerSlot]));
+
+		// Back to front for the blending
+		if (!weighted)
+			m_RenderList->Order(translucent, [](const std::tuple<Chunk*, uint8_t, uint32_t>& entry) { return std::get<0>(entry); }, true);
+
+		// The orders sorted since the last frame (the ones still in flight after a switch too),
+		// then a new sort for the chunks the camera moved around enough
+		{
+			std::lock_guard<std::mutex> sortsL(m_TranslucentSortsLock);
+			for (; !m_TranslucentSorts.empty(); m_TranslucentSorts.pop())
+				m_TranslucentSorts.front().chunk->UploadTranslucentOrder(m_TranslucentSorts.front());
+		}
+
+		for (const auto& [chunk, sections, condition] : translucent)
+		{
+			TranslucentSort sort;
+			if (weighted || !chunk->TakeTranslucentSort(camPos, sort))
+				continue;
+
+			++m_RenderStats.TranslucentSorts;
+
+			m_ThreadPool->enqueue([this, sort = std::move(sort)]() mutable
+			{
+				sort.Sort();
+
+				std::lock_guard<std::mutex> sortsL(m_TranslucentSortsLock);
+				m_TranslucentSorts.push(std::move(sort));
+			});
+		}
 
 		// Render Transparence Faces
 		GLCall(glEnable(GL_BLEND));
@@ -490,11 +1023,63 @@ void CubeWorld::Render()
 
 		GLCall(glDepthMask(GL_FALSE));
 
-		for (const auto& [_, chunk] : inFrustum)
+		if (weighted)
+		{
+			// Only the two targets, cleared to no color and fully revealed
+			const GLenum buffers[] = { GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+			GLCall(glDrawBuffers(3, buffers));
+
+			const float accumClear[] = { 0.0f, 0.0f, 0.0f, 0.0f }, revealageClear[] = { 1.0f, 0.0f, 0.0f, 0.0f };
+			GLCall(glClearBufferfv(GL_COLOR, 1, accumClear));
+			GLCall(glClearBufferfv(GL_COLOR, 2, revealageClear));
+
+			// Sum of the weighted colors, product of (1 - alpha)
+			GLCall(glBlendFunci(1, GL_ONE, GL_ONE));
+			GLCall(glBlendFunci(2, GL_ZERO, GL_ONE_MINUS_SRC_COLOR));
+
+			m_Shader->Bind();
+			m_Shader->SetUniform1i(m_WeightedBlendLocation, 1);
+		}
+
+		for (const auto& [chunk, sections, condition] : translucent)
 		{
-			chunk->RenderT(shader);
+			if (condition)
+			{
+				GLCall(glBeginConditionalRender(condition, GL_QUERY_WAIT));
+			}
+
+			chunk->RenderT(m_RenderStats, sections, !weighted);
+
+			if (condition)
+			{
+				GLCall(glEndConditionalRender());
+			}
+		}
+
+		if (weighted)
+		{
+			m_Shader->SetUniform1i(m_WeightedBlendLocation, 0);
+
+			const GLenum buffer = GL_COLOR_ATTACHMENT0;
+			GLCall(glDrawBuffers(1, &buffer));
+			GLCall(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+
+			// The average color of the faces over the opaque ones, covering (1 - revealage) of them
+			m_CompositeShader->Bind();
+			GLCall(glBindVertexArray(m_FBOQuadVAO));
+
+			GLCall(glActiveTexture(GL_TEXTURE1));
+			GLCall(glBindTexture(GL_TEXTURE_2D, m_FBORevealage));
+			GLCall(glActiveTexture(GL_TEXTURE0));
+			GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOAccum));
+
+			GLCall(glDisable(GL_DEPTH_TEST));
+			GLCall(glDrawArrays(GL_TRIANGLES, 0, 6));
+			GLCall(glEnable(GL_DEPTH_TEST));
 		}
 
+		GLCall(glEndQuery(GL_TIME_ELAPSED));
+
 		GLCall(glDepthMask(GL_TRUE));
 	}
 
@@ -503,7 +1088,7 @@ void CubeWorld::Render()
 	{
 		// Render 2D Objects (UI)
 		m_CrosshairShader->Bind();
-		m_CrosshairShader->SetUniformMat4f("u_VP", m_Camera->GetProjectionOrtho());
+		m_CrosshairShader->SetUniformMat4f(m_CrosshairVPLocation, m_Camera->GetProjectionOrtho());
 
 		m_CrosshairTexture->Bind();
 
@@ -526,13 +1111,17 @@ void CubeWorld::Render()
 
 		GLCall(glActiveTexture(GL_TEXTURE0));
 		GLCall(glBindTexture(GL_TEXTURE_2D, m_FBOColor));
-		glGenerateMipmap(GL_TEXTURE_2D);
+
+		// Filtered in the same pass, without a mip chain
+		m_FBOShader->SetUniform2f(m_FBOScaleLocation, (float)m_WidthScaled / m_Width, (float)m_HeightScaled / m_Height);
 
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 
 		glEnable(GL_DEPTH_TEST);
 	}
 
+	m_Resolution->EndFrame();
+
 	GLCall(glDisable(GL_BLEND));
 	glEnable(GL_CULL_FACE);
 }
@@ -551,15 +1140,111 @@ void CubeWorld::ImGuiRender()
 	const glm::vec3& camDir = m_Camera->GetDirection();
 	ImGui::Text("Camera Direction: %.1f, %.1f, %.1f", camDir.x, camDir.y, camDir.z);
 
-	ImGui::Text("Render Distance: %d/%d", m_Settings.RenderDistance, m_Settings.MaxRenderDistance);
+	ImGui::Text("Render Distance: %d/%d", m_WorldStats.RenderDistance, m_Settings.MaxRenderDistance);
 
 
-	ImGui::Text("Chunks: %d/%d/%d", m_RenderedChunk, m_MeshedChunks.size(), m_Chunks.size());
+	ImGui::Text("Chunks: %d/%zu/%zu", m_RenderedChunk, m_MeshedChunks.size(), m_WorldStats.Chunks);
+	ImGui::Text("Draw Calls: %u (%u quads), %u translucent sorts", m_RenderStats.DrawCalls, m_RenderStats.Quads, m_RenderStats.TranslucentSorts);
+
+	const TransparencyStats& transparency = m_TransparencyStats;
+	ImGui::Text("Transparency: sorted %.2f ms GPU (%.2f ms/frame), weighted blended %.2f ms GPU (%.2f ms/frame)", transparency.PassMillis[0], transparency.FrameMillis[0], transparency.PassMillis[1], transparency.FrameMillis[1]);
+
+	const ResolutionStats& resolutionStats = m_Resolution->GetStats();
+	ImGui::Text("Resolution: %.2fx (%ux%u), GPU %.2f ms, %u changes", m_Specification->ScreenScaleFactor, m_WidthScaled, m_HeightScaled, resolutionStats.GpuMillis, resolutionStats.Changes);
+
+	const MeshUploaderStats& uploaderStats = m_Uploader->GetStats();
+	ImGui::Text("Uploads: %s, %.3f ms/frame render thread, %.2f ms/mesh upload thread, %u in flight, %llu done", uploaderStats.Threaded ? "shared context" : "render thread", m_UploadMillis, uploaderStats.UploadMillis, m_Uploader->GetInFlight(), uploaderStats.Uploaded);
+	ImGui::Text("Staging Ring: %s, %s written, %u waits", uploaderStats.Staging.Mapped ? "persistent mapped" : "off (glBufferData)", BytesToText((double)uploaderStats.Staging.Bytes).c_str(), uploaderStats.Staging.Waits);
+
+	const CullStats& cullStats = m_Culler->GetStats();
+	ImGui::Text("Culling: %.1f us, %zu regions", cullStats.CullMicros, m_Culler->GetRegionsCount());
+	ImGui::Text("Culled: %u/%u regions, %u/%u columns, %u/%u chunks", cullStats.RegionsCulled, cullStats.Regions, cullStats.ColumnsCulled, cullStats.Columns, cullStats.ChunksCulled, cullStats.Chunks);
+	ImGui::Text("Caves: %u chunks reached, %u culled (%.1f us)", cullStats.CaveReached, cullStats.CaveCulled, cullStats.CaveMicros);
+
+	const OcclusionStats& occlusionStats = m_Occlusion->GetStats();
+	const QueryStats& queryStats = m_Queries->GetStats();
+	ImGui::Text("Queries: %u issued, %u in flight, %u chunks hidden, %u draws saved, latency %.1f frames (max %u)", queryStats.Issued, queryStats.Pending, queryStats.Hidden, queryStats.Saved, queryStats.LatencyFrames, queryStats.MaxLatency);
+
+	ImGui::Text("Occluded: %u/%u chunks (%.1f us), %u occluders, %u triangles (%.2f ms)", occlusionStats.Occluded, occlusionStats.Tested, occlusionStats.TestMicros, occlusionStats.Occluders, occlusionStats.Triangles, occlusionStats.RasterMillis);
+
+	const RenderListStats& listStats = m_RenderList->GetStats();
+	ImGui::Text("Render list: %u chunks, %u sorts (%.1f us)", listStats.Chunks, listStats.Sorts, listStats.SortMicros);
+
+	ImGui::Text("Generating Chunks: %zu", m_WorldStats.GeneratingChunks);
+	ImGui::Text("Workers: %zu threads, %.0f tasks/s, %zu queued", m_ThreadPool->GetThreadCount(), m_WorldStats.WorkerTasksPerSecond, m_ThreadPool->GetTaksCount());
+	ImGui::Text("World Thread: %.1f ticks/s, %.2f ms/tick, %zu uploads pending", m_WorldStats.TicksPerSecond, m_WorldStats.TickMillis, m_PendingUploads.size());
+
+	ImGui::Text("RAM Used: %s",  BytesToText((double)(m_WorldStats.Chunks * CHUNK_SIZEQ * sizeof(uint32_t))).c_str());
+	ImGui::Text("VRAM Used: %s", BytesToText(m_WorldStats.TotalBytes).c_str());
+
+	const StorageStats& storageStats = m_WorldStats.Storage;
+	ImGui::Text("Chunks Loaded: %llu (%.2f MB/s, zlib %.1f MB/s)", storageStats.ChunksLoaded, storageStats.DecompressedMBs, storageStats.DecompressThroughput);
+	ImGui::Text("Page Faults: %llu (%.0f/s)", storageStats.PageFaults, storageStats.PageFaultsPerSecond);
+
+	const JournalStats journalStats = m_Journal->GetStats();
+	ImGui::Text("Journal: %llu edits (%.2f us/edit), fsync %.2f ms", journalStats.Edits, journalStats.AppendMicros, journalStats.CommitMillis);
+
+	const SaverStats saverStats = m_Saver->GetStats();
+	ImGui::Text("Chunks Saved: %llu (%s, %zu pending, %llu failed batches)", saverStats.ChunksSaved, BytesToText((double)saverStats.BytesWritten).c_str(),
+		saverStats.Pending, saverStats.FailedBatches);
+
+	if (ImGui::SliderFloat("Save Interval", &m_Settings.SaveInterval, 0.5f, 60.0f, "%.1f s"))
+		m_Saver->SetFlushInterval(m_Settings.SaveInterval);
+
+	if (m_MeshCache)
+	{
+		const MeshCacheStats meshCacheStats = m_MeshCache->GetStats();
+		ImGui::Text("Mesh Cache: %llu hits, %llu misses, %llu stored (%s)", meshCacheStats.Hits, meshCacheStats.Misses, meshCacheStats.Stored, BytesToText((double)meshCacheStats.BytesWritten).c_str());
+	}
 
-	ImGui::Text("Generating Chunks: %d", m_GeneratingChunks.size());
+	const LightStats& lightStats = m_WorldStats.Light;
+	ImGui::Text("Light: %llu columns, %llu nodes, %zu queued (%.2f ms)", lightStats.ColumnsLit, lightStats.NodesProcessed, lightStats.Queued, lightStats.UpdateMillis);
+	ImGui::SliderFloat("Light Budget", &m_Settings.LightBudget, 0.5f, 16.0f, "%.1f ms");
 
-	ImGui::Text("RAM Used: %s",  BytesToText((double)(m_Chunks.size() * CHUNK_SIZEQ * sizeof(uint32_t))).c_str());
-	ImGui::Text("VRAM Used: %s", BytesToText(m_TotalBytes).c_str());
+	ImGui::Text("Last Edit Remesh: %.3f ms", m_EditMillis);
+
+	// The chunks past the new boundaries are meshed again by UpdateLods
+	ImGui::SliderInt("LOD Distance", &m_Settings.LodDistance, 0, 32, "%d chunks");
+
+	ImGui::Checkbox("Cull Back Faces", &m_Settings.CullBackFaces);
+	ImGui::Checkbox("Cave Culling", &m_Settings.CaveCulling);
+	ImGui::Checkbox("Occlusion Culling", &m_Settings.OcclusionCulling);
+	ImGui::SliderInt("Occlusion Distance", &m_Settings.OcclusionDistance, 1, 16, "%d chunks");
+	ImGui::Checkbox("GPU Occlusion", &m_Settings.GpuOcclusion);
+	ImGui::Checkbox("Dynamic Resolution", &m_Settings.DynamicResolution);
+	if (m_Settings.DynamicResolution)
+		ImGui::SliderFloat("Target GPU Time", &m_Settings.TargetGpuMillis, 1.0f, 33.0f, "%.1f ms");
+	else
+	{
+		// By steps, each one reallocates the framebuffer
+		float scale = m_Specification->ScreenScaleFactor;
+		if (ImGui::SliderFloat("Resolution Scale", &scale, m_Settings.MinResolutionScale, m_Settings.MaxResolutionScale, "%.2fx"))
+		{
+			scale = std::round(scale / RESOLUTION_STEP) * RESOLUTION_STEP;
+			if (scale != m_Specification->ScreenScaleFactor)
+			{
+				m_Specification->ScreenScaleFactor = scale;
+				ResizeFramebuffer();
+				m_Resolution->Reset();
+			}
+		}
+	}
+
+	ImGui::Checkbox("Order Independent Transparency", &m_Settings.OrderIndependentTransparency);
+
+	// Every mesh is built again in the new layout
+	if (ImGui::Checkbox("Mesh Sections", &m_Settings.UseSections))
+	{
+		std::vector<Chunk*> meshed;
+		{
+			std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
+			for (const auto& [_, chunk] : m_MeshedChunks)
+				meshed.push_back(chunk);
+		}
+
+		for (Chunk* chunk : meshed)
+			SetChunkDirty(chunk, chunk->m_Coord);
+	}
 
 	ImGui::Checkbox("Debug Normal: ", &m_DebugNormal);
 	if (m_DebugNormal) m_DebugUV = false;
@@ -596,13 +1281,16 @@ void CubeWorld::BuildChunk(const glm::vec3& coord, bool requestMesh)
 	m_ThreadPool->enqueue([&, coord, requestMesh]()
 	{
 		Chunk* chunk = new Chunk{ coord };
-		chunk->Fill(m_Noise.get());
+		if (!chunk->Load(m_Storage.get()))
+			chunk->Fill(m_Noise.get(), m_GenerationSettings.Seed);
 
 		{
 			std::lock_guard<std::mutex> chunkL(m_ChunksLock);
 			m_Chunks[coord] = chunk;
 		}
 
+		m_LightEngine->AddChunk(chunk);
+
 		if (!requestMesh)
 		{
 			{
@@ -626,7 +1314,11 @@ void CubeWorld::SetChunkDirty(Chunk* chunk, const glm::vec3& coord, bool isGener
 	{
 		std::lock_guard<std::mutex> generationL(m_GeneratingChunksLock);
 		if (!m_GeneratingChunks.insert({ coord, chunk }).second)
+		{
+			// The mesh on its way may predate the change (an edit), it is meshed again once it is in
+			m_RemeshAfterBuild.insert(coord);
 			return;
+		}
 	}
 
 	{
@@ -635,6 +1327,20 @@ void CubeWorld::SetChunkDirty(Chunk* chunk, const glm::vec3& coord, bool isGener
 	}
 }
 
+void CubeWorld::FinishChunkMesh(Chunk* chunk)
+{
+	const glm::vec3& coord = chunk->m_Coord;
+	{
+		std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+		m_GeneratingChunks.erase(coord);
+
+		if (!m_RemeshAfterBuild.erase(coord))
+			return;
+	}
+
+	SetChunkDirty(chunk, coord);
+}
+
 void CubeWorld::BuildChunkNotify(const glm::vec3& coord)
 {
 	const glm::vec3 max{ coord.x + CHUNK_SIZE, coord.y + CHUNK_SIZE, coord.z + CHUNK_SIZE };
@@ -658,10 +1364,61 @@ void CubeWorld::BuildChunkNotify(const glm::vec3& coord)
 			}
 }
 
-void CubeWorld::GenerateChunkMesh(Chunk* chunk)
+void CubeWorld::GenerateChunkMesh(Chunk* chunk, bool useSections)
 {
+	// Meshed again by the light engine once its column and the ones around are lit
+	if (!chunk->IsLightReady())
+	{
+		chunk->SetStage(Chunk::Stage::WaitingLight);
+
+		std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+		m_GeneratingChunks.erase(chunk->m_Coord);
+		return;
+	}
+
+	// For the cave culling, with or without quads
+	chunk->UpdateVisibility();
+
 	Mesh mesh;
-	chunk->GenerateMesh(this, mesh);
+
+	// Only full detail meshes are split in sections
+	const int lod = chunk->GetLod();
+	const bool sections = useSections && lod == 0;
+
+	if (m_MeshCache)
+	{
+		chunk->SetStage(Chunk::Stage::Building);
+
+		Chunk* chunks[27];
+		if (GetChunkNeighbors(chunk, chunk->m_Coord, chunks))
+		{
+			// The two layouts and the levels have different quads, each has its own entry
+			const uint64_t hash = chunk->ContentHash(chunks) ^ (sections ? 0x5EC7105ull : 0) ^ ((uint64_t)lod << 40);
+			if (m_MeshCache->Load(chunk->m_Coord, hash, mesh))
+			{
+				mesh.sections = sections;
+				mesh.lod = lod;
+				chunk->SetStage(Chunk::Stage::Built);
+			}
+			else
+			{
+				if (lod > 0)
+					chunk->GenerateLodMesh(chunks, lod, mesh);
+				else
+					chunk->GenerateMesh(chunks, mesh, sections);
+
+				m_MeshCache->Store(chunk->m_Coord, hash, mesh);
+			}
+		}
+	}
+	else if (lod > 0)
+	{
+		Chunk* chunks[27];
+		if (GetChunkNeighbors(chunk, chunk->m_Coord, chunks))
+			chunk->GenerateLodMesh(chunks, lod, mesh);
+	}
+	else
+		chunk->GenerateMesh(this, mesh, sections);
 
 	if (mesh.vertices.size() > 0 || mesh.tvertices.size() > 0)
 	{
@@ -673,8 +1430,7 @@ void CubeWorld::GenerateChunkMesh(Chunk* chunk)
 	{
 		chunk->SetStage(Chunk::Stage::Uploaded);
 
-		std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
-		m_GeneratingChunks.erase(chunk->m_Coord);
+		FinishChunkMesh(chunk);
 	}
 }
 
@@ -696,7 +1452,52 @@ void CubeWorld::UpdateChunkMesh(Chunk* chunk)
 		}
 	}
 
-	m_ThreadPool->enqueue([&, chunk]() { GenerateChunkMesh(chunk); });
+	chunk->SetLod(GetLodLevel(coord, chunk->GetLod()));
+
+	// Taken here, the tick settings change while the workers mesh
+	const bool useSections = m_TickSettings.UseSections;
+	m_ThreadPool->enqueue([&, chunk, useSections]() { GenerateChunkMesh(chunk, useSections); });
+}
+
+int CubeWorld::GetLodLevel(const glm::vec3& coord, int current) const
+{
+	if (m_TickSettings.LodDistance <= 0)
+		return 0;
+
+	// The whole column is at one level, there are no seams between its chunks
+	const glm::vec3& cameraPosition = m_StreamPosition;
+	const float distance = glm::length(glm::vec2{ coord.x + HCHUNK_SIZE - cameraPosition.x, coord.z + HCHUNK_SIZE - cameraPosition.z }) * CHUNK_SIZE_INV;
+
+	const float lodDistance = (float)m_TickSettings.LodDistance;
+
+	int lod = current;
+	while (lod < LOD_LEVELS - 1 && distance >= (lod + 1) * lodDistance + m_TickSettings.LodHysteresis)
+		++lod;
+	while (lod > 0 && distance < lod * lodDistance - m_TickSettings.LodHysteresis)
+		--lod;
+
+	return lod;
+}
+
+void CubeWorld::UpdateLods()
+{
+	std::vector<Chunk*> changed;
+
+	m_TotalBytes = 0;
+	{
+		std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
+		for (const auto& [coord, chunk] : m_MeshedChunks)
+		{
+			m_TotalBytes += chunk->GetBufferBytes();
+
+			if (chunk->IsStage(Chunk::Stage::Uploaded) && GetLodLevel(coord, chunk->GetLod()) != chunk->GetLod())
+				changed.push_back(chunk);
+		}
+	}
+
+	// The old mesh is drawn until the new one is uploaded
+	for (Chunk* chunk : changed)
+		SetChunkDirty(chunk, chunk->m_Coord);
 }
 
 bool CubeWorld::CheckNeighborsChunks(Chunk* chunk, const glm::vec3& coord)
@@ -780,23 +1581,142 @@ bool CubeWorld::GetChunk(const glm::vec3& coord, Chunk** chunk)
 
 void CubeWorld::PlaceBlock(Chunk* chunk, glm::vec3 coord, int data, FaceSide side)
 {
-	chunk->PlaceBlock((uint32_t)coord.x, (uint32_t)coord.y, (uint32_t)coord.z, data, (Block::Side)side);
+	ChunkBlock block;
+	block.SetBlock(data, (Block::Side)side);
+
+	m_Journal->Append(glm::ivec3(chunk->m_Coord + coord), block.data, [&]()
+	{
+		chunk->PlaceBlock((uint32_t)coord.x, (uint32_t)coord.y, (uint32_t)coord.z, data, (Block::Side)side);
+		m_Saver->MarkDirty(chunk);
+	});
+
+	// The neighbors hash the border too, their stale entries never match again
+	if (m_MeshCache)
+		m_MeshCache->Invalidate(chunk->m_Coord);
+
+	// The chunks reached by the new light are meshed again once it settles, on the world thread
+	{
+		std::lock_guard<std::mutex> changesL(m_LightChangesLock);
+		m_LightChanges.push_back({ chunk, glm::ivec3(coord) });
+	}
+
+	Timer timer;
+
+	// Only the slices or sections around the block are meshed again and spliced in the uploaded meshes
+	const glm::ivec3 local(coord);
+	RemeshBlocks(chunk, local, local);
+
+	for (const glm::ivec3& dir : { glm::ivec3{ -1, 0, 0 }, glm::ivec3{ 1, 0, 0 }, glm::ivec3{ 0, -1, 0 }, glm::ivec3{ 0, 1, 0 }, glm::ivec3{ 0, 0, -1 }, glm::ivec3{ 0, 0, 1 } })
+	{
+		const glm::ivec3 next = local + dir;
+		if (next.x >= 0 && next.x < CHUNK_SIZE && next.y >= 0 && next.y < CHUNK_SIZE && next.z >= 0 && next.z < CHUNK_SIZE)
+			continue;
+
+		// The block is one outside the neighbor
+		Chunk* neighbor;
+		if (GetChunk(chunk->m_Coord + glm::vec3(dir) * CHUNK_SIZE3, &neighbor))
+			RemeshBlocks(neighbor, local - dir * CHUNK_SIZE, local - dir * CHUNK_SIZE);
+	}
+
+	m_EditMillis = timer.ElapsedMillis();
+}
+
+void CubeWorld::RemeshBlocks(Chunk* chunk, const glm::ivec3& from, const glm::ivec3& to)
+{
+	bool isGenerating;
+	{
+		std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+		isGenerating = m_GeneratingChunks.contains(chunk->m_Coord);
+	}
+
+	// Not uploaded yet, a full mesh is on its way or at a coarser level, it is meshed whole
+	Chunk* chunks[27];
+	if (isGenerating || !chunk->IsStage(Chunk::Stage::Uploaded) || chunk->GetLod() > 0 || !GetChunkNeighbors(chunk, chunk->m_Coord, chunks))
+	{
+		SetChunkDirty(chunk, chunk->m_Coord);
+		return;
+	}
+
+	// Only an edit inside the chunk changes the faces its open blocks connect
+	if (glm::all(glm::greaterThanEqual(to, glm::ivec3{ 0 })) && glm::all(glm::lessThan(from, glm::ivec3{ CHUNK_SIZE })))
+		chunk->UpdateVisibility();
+
+	// The faces and the AO of the blocks around can change too, the edits of a frame are meshed together
+	if (chunk->HasSections())
+	{
+		chunk->MarkSectionsDirty(from - 1, to + 1);
+		m_SectionsToRemesh.insert(chunk);
+		return;
+	}
+
+	Mesh mesh;
+	chunk->GenerateSlices(chunks, from, to, mesh);
 
-	const glm::vec3& chunkCoord = chunk->m_Coord;
-	SetChunkDirty(chunk, chunkCoord);
+	// The buffers can grow, the world thread reads their sizes under it
+	std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
+	chunk->UploadSlices(mesh, from, to);
 
-	if (coord.x == 0)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x - CHUNK_SIZE, chunkCoord.y, chunkCoord.z });
-	if (coord.x == CHUNK_SIZE - 1)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x + CHUNK_SIZE, chunkCoord.y, chunkCoord.z });
-	if (coord.y == 0 && chunk->m_Coord.y > 0)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x, chunkCoord.y - CHUNK_SIZE, chunkCoord.z });
-	if (coord.y == CHUNK_SIZE - 1)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x, chunkCoord.y + CHUNK_SIZE, chunkCoord.z });
-	if (coord.z == 0)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x, chunkCoord.y, chunkCoord.z - CHUNK_SIZE });
-	if (coord.z == CHUNK_SIZE - 1)
-		SetChunkDirty(chunk, glm::vec3{ chunkCoord.x, chunkCoord.y, chunkCoord.z + CHUNK_SIZE });
+	// A chunk that was empty is drawn from now on, the bounds of any other can change
+	if (chunk->m_IndicesCount > 0 || chunk->m_TIndicesCount > 0)
+	{
+		m_MeshedChunks.insert({ chunk->m_Coord, chunk });
+		m_RenderList->Add(chunk);
+	}
+
+	m_Culler->Update(chunk);
+}
+
+void CubeWorld::RemeshSections()
+{
+	if (m_SectionsToRemesh.empty())
+		return;
+
+	Timer timer;
+
+	for (Chunk* chunk : m_SectionsToRemesh)
+	{
+		const uint8_t dirty = chunk->TakeDirtySections();
+
+		bool isGenerating;
+		{
+			std::lock_guard<std::mutex> generatingL(m_GeneratingChunksLock);
+			isGenerating = m_GeneratingChunks.contains(chunk->m_Coord);
+		}
+
+		// Meshed whole since the edit, or in the other layout now
+		Chunk* chunks[27];
+		if (isGenerating || !chunk->HasSections() || !chunk->IsStage(Chunk::Stage::Uploaded) || !GetChunkNeighbors(chunk, chunk->m_Coord, chunks))
+		{
+			SetChunkDirty(chunk, chunk->m_Coord);
+			continue;
+		}
+
+		for (int s = 0; s < SECTION_COUNT; ++s)
+		{
+			if (!(dirty & (1 << s)))
+				continue;
+
+			Mesh mesh;
+			chunk->GenerateSection(chunks, s, mesh);
+
+			// The buffers can grow, the world thread reads their sizes under it
+			std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
+			chunk->UploadSection(s, mesh);
+		}
+
+		std::lock_guard<std::mutex> meshedL(m_MeshedChunksLock);
+		if (chunk->m_IndicesCount > 0 || chunk->m_TIndicesCount > 0)
+		{
+			m_MeshedChunks.insert({ chunk->m_Coord, chunk });
+			m_RenderList->Add(chunk);
+		}
+
+		m_Culler->Update(chunk);
+	}
+
+	m_SectionsToRemesh.clear();
+
+	m_EditMillis += timer.ElapsedMillis();
 }
 
 void CubeWorld::PlaceBlock(glm::vec3 coord, Block* block, FaceSide side)
@@ -811,6 +1731,131 @@ void CubeWorld::PlaceBlock(glm::vec3 coord, Block* block, FaceSide side)
 		PlaceBlock(chunk, coord, block->m_ID, side);
 }
 
+void CubeWorld::PrefetchChunks(const glm::vec3& cameraChunk)
+{
+	const glm::vec3& camDir = m_StreamDirection;
+
+	glm::vec2 dir{ camDir.x, camDir.z };
+	if (glm::length(dir) < 0.001f)
+		return;
+
+	dir = glm::normalize(dir);
+
+	// Read ahead only when the camera enters a new chunk or turns toward another octant
+	const int octant = (int)std::floor((std::atan2(dir.y, dir.x) + glm::pi<float>()) / glm::quarter_pi<float>()) & 7;
+	if (cameraChunk == m_PrefetchChunk && octant == m_PrefetchOctant)
+		return;
+
+	m_PrefetchChunk = cameraChunk;
+	m_PrefetchOctant = octant;
+
+	const glm::vec2 origin{ cameraChunk.x, cameraChunk.z }, side{ -dir.y, dir.x };
+
+	const int renderDist = m_TickSettings.RenderDistance;
+	for (int d = renderDist + 1; d <= renderDist + m_TickSettings.PrefetchDistance; d++)
+		for (int s = -d; s <= d; s++)
+		{
+			const glm::vec2 column = glm::round(origin + dir * (float)d + side * (float)s);
+
+			for (int y = 0; y < CHUNK_Y_COUNT; y++)
+				m_Storage->Prefetch(glm::vec3{ column.x * CHUNK_SIZE, y * CHUNK_SIZE, column.y * CHUNK_SIZE });
+		}
+}
+
+void CubeWorld::ReplayJournal()
+{
+	std::vector<JournalRecord> records;
+	WorldJournal::ReadRecords(m_Settings.SavePath, records);
+
+	if (records.empty())
+	{
+		WorldJournal::Clear(m_Settings.SavePath);
+		return;
+	}
+
+	Timer timer;
+
+	// Edits grouped by chunk, in log order
+	std::unordered_map<glm::vec3, std::vector<JournalRecord>> chunkEdits;
+	for (const JournalRecord& record : records)
+		chunkEdits[glm::floor(glm::vec3{ record.x, record.y, record.z } * CHUNK_SIZE_INV) * CHUNK_SIZE3].push_back(record);
+
+	std::vector<ChunkSnapshot> snapshots(chunkEdits.size());
+
+	std::vector<std::future<Chunk*>> replays;
+	replays.reserve(chunkEdits.size());
+
+	size_t i = 0;
+	for (const auto& [chunkCoord, edits] : chunkEdits)
+	{
+		ChunkSnapshot& snapshot = snapshots[i++];
+		snapshot.coord = chunkCoord;
+
+		replays.push_back(m_ThreadPool->enqueue([this, &snapshot, &edits]()
+		{
+			Chunk* chunk = new Chunk{ snapshot.coord };
+			if (!chunk->Load(m_Storage.get()))
+				chunk->Fill(m_Noise.get(), m_GenerationSettings.Seed);
+
+			for (const JournalRecord& record : edits)
+			{
+				const ChunkBlock block{ record.data };
+				chunk->PlaceBlock(record.x - (int)snapshot.coord.x, record.y - (int)snapshot.coord.y, record.z - (int)snapshot.coord.z, block.GetID(), block.GetSide());
+			}
+
+			std::vector<ChunkBlock> data(CHUNK_SIZEQ);
+			chunk->Snapshot(data.data());
+			RegionFile::Compress(data.data(), CHUNK_SIZEQ * sizeof(ChunkBlock), snapshot.compressed);
+
+			return chunk;
+		}));
+	}
+
+	// Chunks are deleted here, the GL objects belong to this thread
+	for (std::future<Chunk*>& replay : replays)
+		delete replay.get();
+
+	if (!m_Storage->SaveChunks(snapshots) || !m_Storage->Sync())
+	{
+		std::cout << "Failed to replay the journal, it is kept for the next run!" << std::endl;
+		return;
+	}
+
+	WorldJournal::Clear(m_Settings.SavePath);
+
+	std::cout << "Journal Replay of " << records.size() << " edits (" << snapshots.size() << " chunks) in " << timer.ElapsedMillis() << " ms" << std::endl;
+}
+
+void CubeWorld::RegisterBlocks(const glm::vec2& atlasStep)
+{
+	const float stepX = atlasStep.x, stepY = atlasStep.y;
+
+	Block* block;
+	block = new Block("Air",     { { 10 * stepX, 14 * stepY } });
+	block->m_IsTransparent = true;
+
+	block = new Block("Dirt",    { {  2 * stepX, 15 * stepY } });
+	block = new Block("Grass",   { {  0 * stepX, 15 * stepY }, { 3 * stepX, 15 * stepY }, { 2 * stepX, 15 * stepY } });
+	block = new Block("Stone",   { {  1 * stepX, 15 * stepY } });
+
+	block = new Block("Water",   { { 13 * stepX,  3 * stepY } });
+	block->m_IsTransparent = true;
+	block->m_IsTranslucent = true;
+	block->m_IsLiquid      = true;
+	block->m_LightOpacity  = 1;
+
+	block = new Block("Glass",   { {  1 * stepX, 12 * stepY } });
+	block->m_IsTransparent = true;
+
+	block = new Block("Sand",    { {  2 * stepX, 14 * stepY } });
+	block = new Block("Snow",    { {  2 * stepX, 11 * stepY } });
+
+	block = new Block("Bedrock", { {  1 * stepX, 14 * stepY } });
+
+	block = new Block("Glowstone", { { 9 * stepX, 9 * stepY } });
+	block->m_LightEmission = LIGHT_MAX;
+}
+
 glm::vec3 CubeWorld::WorldToChunkPos(glm::vec3& worldPos)
 {
 	const glm::vec3 chunkCoord = glm::floor(worldPos * CHUNK_SIZE_INV) * CHUNK_SIZE3;
@@ -826,14 +1871,10 @@ glm::vec3 CubeWorld::WorldToChunkPos(glm::vec3& worldPos)
 
 void CubeWorld::OnWindowResize()
 {
-	m_Width  = m_Specification->Width;
-	m_Height = m_Specification->Height;
+	ResizeFramebuffer();
 
-	m_WidthScaled  = (uint32_t)(m_Width  * m_Specification->ScreenScaleFactor);
-	m_HeightScaled = (uint32_t)(m_Height * m_Specification->ScreenScaleFactor);
-
-	m_Camera->WindowResize(m_WidthScaled, m_HeightScaled);
-	m_Camera->RecalculateView();
+	// Another pixel count, the frames measured before do not tell the cost of the next ones
+	m_Resolution->Reset();
 }
 
 std::string CubeWorld::BytesToText(double bytes)
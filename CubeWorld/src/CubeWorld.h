@@ -3,13 +3,28 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Frustum.h"
+#include "ChunkCuller.h"
+#include "OcclusionBuffer.h"
+#include "OcclusionQueries.h"
+#include "RenderList.h"
+#include "ResolutionScaler.h"
+#include "MeshUploader.h"
 #include "Texture.h"
+#include "TextureArray.h"
 
 #include "Chunk.h"
+#include "LightEngine.h"
+
+#include "storage/WorldStorage.h"
+#include "storage/ChunkSaver.h"
+#include "storage/WorldJournal.h"
+#include "storage/MeshCache.h"
 
 #include "utils/Timer.h"
 #include "utils/ThreadPool.h"
 #include "utils/SimplexNoise.h"
+#include "utils/TripleBuffer.h"
+#include "utils/FramePacer.h"
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -19,11 +34,55 @@
 #include <unordered_set>
 #include <memory>
 #include <queue>
+#include <deque>
+#include <thread>
+#include <atomic>
 
 struct WindowSpecification;
 
 #define min(a, b) a < b ? a : b
 
+#define FRAME_UNIFORM_BINDING 1
+#define CHUNK_DRAW_BINDING 0   // Shader storage
+#define BLOCK_LAYERS_BINDING 1 // Shader storage
+
+// Camera state of the shaders, uploaded once a frame (std140)
+struct FrameUniforms
+{
+	glm::mat4 VP{ 1.0f };
+	glm::vec3 CamPos{ 0.0f };
+	uint32_t DebugNormal = 0;
+	uint32_t DebugUV = 0;
+	uint32_t Padding[3]{};
+};
+
+// GPU timer queries of the translucent pass in flight, one a frame
+#define TRANSPARENCY_TIMERS 4
+
+// Cost of each way to draw the translucent faces, 0 sorted and 1 weighted blended, averaged over the frames drawn with it
+struct TransparencyStats
+{
+	float PassMillis[2] = { 0.0f, 0.0f }; // GPU time of the translucent pass, composite included
+	float FrameMillis[2] = { 0.0f, 0.0f };
+};
+
+// What the world thread hands over to the render thread each tick, read only once published
+struct WorldPacket
+{
+	uint64_t Tick = 0;
+	glm::vec3 StreamCenter{ 0.0f }; // Camera chunk the chunks were streamed around
+
+	std::vector<std::tuple<Chunk*, Mesh>> Uploads; // Meshed since the last packet, in order
+
+	int RenderDistance = 0;
+	size_t Chunks = 0, GeneratingChunks = 0;
+	double TotalBytes = 0;
+	float TickMillis = 0.0f, TicksPerSecond = 0.0f;
+	float WorkerTasksPerSecond = 0.0f;
+	LightStats Light;
+	StorageStats Storage;
+};
+
 struct WorldSettings
 {
 	int MaxRenderDistance = 10;
@@ -32,10 +91,63 @@ struct WorldSettings
 	int RenderDistanceUnload = RenderDistance + 3;
 
 	float ChunkScale = 0.00055f;
+
+	std::string SavePath = "saves/world";
+
+	// Seconds between background writes of the modified chunks
+	float SaveInterval = 5.0f;
+
+	// Milliseconds between journal fsyncs (edits lost at most on a crash)
+	float JournalCommitInterval = 50.0f;
+	// Seconds between journal checkpoints into the region files
+	float JournalCheckpointInterval = 60.0f;
+
+	// Chunk columns beyond the render distance read ahead in the camera direction
+	int PrefetchDistance = 2;
+
+	// Keep the chunk meshes on disk, a restart uploads them without meshing again
+	bool UseMeshCache = true;
+
+	// Milliseconds of light propagation per frame, the rest waits for the next one
+	float LightBudget = 3.0f;
+
+	// Chunks (horizontally) before each coarser mesh level, 0 keeps every chunk at full detail
+	int LodDistance = 6;
+	// Chunks past a level boundary before a chunk switches level, back and forth moves do not remesh
+	float LodHysteresis = 1.0f;
+
+	// Skip the face directions of a chunk that all point away from the camera
+	bool CullBackFaces = true;
+
+	// Skip the chunks the camera cannot see through the open blocks of the ones in between
+	bool CaveCulling = true;
+
+	// Skip the chunks behind the solid ground of the columns around the camera, rasterized on the CPU
+	bool OcclusionCulling = true;
+	// Chunks (horizontally) of columns used as occluders
+	int OcclusionDistance = 6;
+
+	// Skip the chunks the GPU found behind the ones drawn, with queries read back frames later
+	bool GpuOcclusion = true;
+
+	// Scale the offscreen framebuffer (to the window) to keep the GPU time of a frame around the target
+	bool DynamicResolution = true;
+	float TargetGpuMillis = 6.0f;
+	float MinResolutionScale = 0.5f, MaxResolutionScale = 3.0f;
+
+	// Blend the translucent faces with weighted blended order independent transparency instead of
+	// drawing them back to front, nothing is sorted
+	bool OrderIndependentTransparency = false;
+
+	// Split the chunk meshes in 16^3 sections, culled one by one and meshed again alone after an edit
+	bool UseSections = false;
 };
 
 struct WorldGenerationSettings
 {
+	// Stored with the world, a saved world keeps its own
+	uint32_t Seed = 0;
+
 	float Frequency   = 4.012f,
 		  Amplitude   = 2.151f,
 		  Lacunarity  = 2.267f,
@@ -48,6 +160,9 @@ public:
 	static std::string BytesToText(double bytes);
 	static std::string FormatFloat(double n, int digit);
 
+	// Needs no GL context, the step is the size of a tile in the atlas
+	static void RegisterBlocks(const glm::vec2& atlasStep);
+
 public:
 	CubeWorld(WindowSpecification* specification)
 		: m_Specification(specification) {}
@@ -55,6 +170,7 @@ public:
 
 	void Init();
 
+	// Once a frame on the render thread, before Render
 	void Update(float timestep);
 
 	void Render();
@@ -65,11 +181,28 @@ public:
 
 	void SetChunkDirty(Chunk* chunk, const glm::vec3& coord, bool isGenerating = false);
 
+	// Its mesh is in (or empty), meshed again if it was asked to meanwhile
+	void FinishChunkMesh(Chunk* chunk);
+
 	void BuildChunkNotify(const glm::vec3& coord);
 
-	void GenerateChunkMesh(Chunk* chunk);
+	void GenerateChunkMesh(Chunk* chunk, bool useSections);
 	void UpdateChunkMesh(Chunk* chunk);
 
+	// Level of a chunk column at its distance from the camera, current is the level it has now
+	int GetLodLevel(const glm::vec3& coord, int current) const;
+
+	// Mesh again the chunks that changed level, and sum the VRAM they use
+	void UpdateLods();
+
+	// Mesh again around the blocks from-to (local): the slices now, the sections by the next RemeshSections
+	void RemeshBlocks(Chunk* chunk, const glm::ivec3& from, const glm::ivec3& to);
+
+	void RemeshSections();
+
+	// Start rasterizing the solid ground of the columns around the camera, Render waits for it
+	void BeginOcclusion();
+
 	bool CheckNeighborsChunks(Chunk* chunk, const glm::vec3& coord);
 	bool GetChunkNeighbors(Chunk* chunk, const glm::vec3& coord, Chunk* chunks[26]);
 
@@ -87,8 +220,18 @@ private:
 	void SettupOpenGLSettings();
 
 	void InitFramebuffer();
+	void ResizeFramebuffer(); // Attachments at the window size times ScreenScaleFactor
 	void InitCrosshair();
 	void InitInteract();
+	void InitDrawData();
+
+	// The world thread: fixed ticks of streaming, light, LODs and meshing requests, no GL
+	void RunWorldThread();
+	void Tick();
+
+	void PrefetchChunks(const glm::vec3& cameraChunk);
+
+	void ReplayJournal();
 
 private:
 	WindowSpecification* m_Specification;
@@ -99,7 +242,24 @@ private:
 	// Framebuffer
 	uint32_t m_FBO = 0, m_FBOColor = 0, m_FBODepth = 0, m_FBOQuadVAO = 0, m_FBOQuadVBO = 0;
 
+	// Filters the framebuffer down (or up) to the window in one pass, no mipmaps
 	std::unique_ptr<Shader> m_FBOShader;
+	int m_FBOScaleLocation = -1;
+
+	// Weighted blended transparency targets on m_FBO, the sum of the weighted premultiplied colors and
+	// the product of (1 - alpha) of the translucent faces, composited over the color
+	uint32_t m_FBOAccum = 0, m_FBORevealage = 0;
+	std::unique_ptr<Shader> m_CompositeShader;
+	int m_WeightedBlendLocation = -1;
+
+	uint32_t m_TransparencyTimers[TRANSPARENCY_TIMERS]{};
+	uint8_t m_TransparencyTimerModes[TRANSPARENCY_TIMERS]{};
+	uint32_t m_TransparencyFrame = 0;
+	TransparencyStats m_TransparencyStats;
+
+	// Draw data, the offsets of the chunks drawn by the frame indexed by their m_DrawIndex
+	uint32_t m_FrameUBO = 0, m_ChunkDrawSSBO = 0;
+	std::vector<glm::vec4> m_ChunkDraws;
 
 	// World
 	WorldSettings m_Settings;
@@ -110,20 +270,43 @@ private:
 	std::unordered_map<glm::vec3, Chunk*> m_Chunks, m_MeshedChunks, m_GeneratingChunks;
 	std::mutex m_ChunksLock, m_MeshedChunksLock, m_GeneratingChunksLock;
 
+	// Asked to mesh again while their mesh was on its way, meshed again once it is in (under m_GeneratingChunksLock)
+	std::unordered_set<glm::vec3> m_RemeshAfterBuild;
+
 	std::queue<std::tuple<Chunk*, Mesh>> m_ChunksUpload;
 	std::mutex m_ChunksUploadLock;
 
 	std::queue<Chunk*> m_DirtyChunks;
 	std::mutex m_DirtyChunksLock;
 
+	// Edited blocks, relit by the world thread (the light engine runs on it alone)
+	std::vector<std::pair<Chunk*, glm::ivec3>> m_LightChanges;
+	std::mutex m_LightChangesLock;
+
+	std::queue<TranslucentSort> m_TranslucentSorts; // Sorted, to upload
+	std::mutex m_TranslucentSortsLock;
+
 	std::unique_ptr<ThreadPool> m_ThreadPool;
+	std::unique_ptr<WorldStorage> m_Storage;
+	std::unique_ptr<ChunkSaver> m_Saver;
+	std::unique_ptr<WorldJournal> m_Journal;
+	std::unique_ptr<MeshCache> m_MeshCache;
+	std::unique_ptr<LightEngine> m_LightEngine;
 	std::unique_ptr<SimplexNoise> m_Noise;
 	std::unique_ptr<Camera> m_Camera;
 	std::unique_ptr<Frustum> m_Frustum;
-	std::unique_ptr<Texture> m_Texture, m_CrosshairTexture;
+	std::unique_ptr<ChunkCuller> m_Culler;
+	std::unique_ptr<OcclusionBuffer> m_Occlusion;
+	std::unique_ptr<OcclusionQueries> m_Queries;
+	std::unique_ptr<RenderList> m_RenderList;
+	std::unique_ptr<ResolutionScaler> m_Resolution;
+	std::unique_ptr<MeshUploader> m_Uploader;
+	std::unique_ptr<TextureArray> m_Texture;
+	std::unique_ptr<Texture> m_CrosshairTexture;
 	std::unique_ptr<Shader> m_Shader, m_CrosshairShader, m_InteractShader;
 
 	uint32_t m_CrosshairVAO = 0, m_CrosshairVBO = 0, m_InteractVAO = 0, m_InteractVBO = 0, m_InteractIBO = 0;
+	int m_CrosshairVPLocation = -1;
 
 	glm::vec2 m_AtlasStep{ 0.0f, 0.0f };
 
@@ -132,7 +315,40 @@ private:
 	bool m_WorldGenerated = false;
 	double m_TotalBytes = 0;
 
+	float m_EditMillis = 0.0f;   // Block edit to uploaded slices or sections
+	float m_UploadMillis = 0.0f; // Render thread, swapping in the written meshes and submitting new ones, averaged
+
+	// World thread, the camera of the last frame is the one it streams around
+	std::thread m_WorldThread;
+	std::atomic<bool> m_WorldThreadRunning = false;
+
+	glm::vec3 m_ViewPosition{ 0.0f }, m_ViewDirection{ 0.0f };
+	WorldSettings m_ViewSettings; // m_Settings of the last frame, the render thread changes m_Settings at any time
+	std::mutex m_ViewLock;
+
+	TripleBuffer<WorldPacket> m_WorldPackets;
+
+	// World thread only
+	glm::vec3 m_StreamPosition{ 0.0f }, m_StreamDirection{ 0.0f };
+	WorldSettings m_TickSettings; // m_ViewSettings of the tick, its RenderDistance grows here alone
+	uint64_t m_Ticks = 0, m_TimerTicks = 0;
+	uint64_t m_WorkerTasks = 0;
+	float m_WorkerTasksPerSecond = 0.0f, m_TicksPerSecond = 0.0f;
+	Timer m_WorkerTimer;
+	FramePacer m_TickPacer;
+
+	// Render thread only, the meshes of the packets waiting for their upload and the last packet's stats
+	std::deque<std::tuple<Chunk*, Mesh>> m_PendingUploads;
+	WorldPacket m_WorldStats;
+
+	std::unordered_set<Chunk*> m_SectionsToRemesh;
+
+	RenderStats m_RenderStats;
+
 	uint16_t m_RenderedChunk = 0;
 
+	glm::vec3 m_PrefetchChunk{ 0.0f, -1.0f, 0.0f };
+	int m_PrefetchOctant = -1;
+
 	Timer m_GenerationTimer;
 };
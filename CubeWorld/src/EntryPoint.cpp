@@ -1,7 +1,14 @@
 #include "Application.h"
 
+#include "tools/Pregenerator.h"
+
+#include <cstring>
+
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--pregen") == 0)
+		return Pregenerator::Run(argc - 2, argv + 2);
+
 	Application app;
 	if (!app.Init())
 		return -1;
@@ -1,5 +1,7 @@
 #include "Frustum.h"
 
+#include <emmintrin.h>
+
 void Frustum::Update(Camera* camera)
 {
 	const glm::mat4 VP = camera->GetViewProjection();
@@ -38,7 +40,7 @@ void Frustum::Update(Camera* camera)
 		m_Planes[i].normalize();
 }
 
-bool Frustum::SphereIntersect(const glm::vec3& center, float radius)
+bool Frustum::SphereIntersect(const glm::vec3& center, float radius) const
 {
 	for (const Plane& p : m_Planes)
 	{
@@ -50,3 +52,38 @@ bool Frustum::SphereIntersect(const glm::vec3& center, float radius)
 
 	return true;
 }
+
+bool Frustum::AABBIntersect(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	for (const Plane& p : m_Planes)
+	{
+		// The corner furthest along the normal, if it is outside the whole box is
+		const glm::vec3 corner{ p.normal.x >= 0.0f ? boxMax.x : boxMin.x,
+								p.normal.y >= 0.0f ? boxMax.y : boxMin.y,
+								p.normal.z >= 0.0f ? boxMax.z : boxMin.z };
+
+		if (glm::dot(p.normal, corner) + p.distance < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+int Frustum::AABBIntersect4(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ) const
+{
+	const __m128 boxMin[3]{ _mm_loadu_ps(minX), _mm_loadu_ps(minY), _mm_loadu_ps(minZ) };
+	const __m128 boxMax[3]{ _mm_loadu_ps(maxX), _mm_loadu_ps(maxY), _mm_loadu_ps(maxZ) };
+
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	for (const Plane& p : m_Planes)
+	{
+		// The sign of the normal picks the same corner of every box
+		__m128 distance = _mm_set1_ps(p.distance);
+		for (int a = 0; a < 3; ++a)
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p.normal[a]), p.normal[a] >= 0.0f ? boxMax[a] : boxMin[a]));
+
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+	}
+
+	return _mm_movemask_ps(inside);
+}
@@ -26,7 +26,12 @@ public:
 
 	void Update(Camera* camera);
 
-	bool SphereIntersect(const glm::vec3& center, float radius);
+	bool SphereIntersect(const glm::vec3& center, float radius) const;
+
+	bool AABBIntersect(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// Four boxes at once from arrays of their bounds, bit i is set if box i intersects
+	int AABBIntersect4(const float* minX, const float* minY, const float* minZ, const float* maxX, const float* maxY, const float* maxZ) const;
 
 private:
 	Plane m_Planes[6]{};
@@ -0,0 +1,474 @@
+#include "LightEngine.h"
+
+#include "data/BlocksManager.h"
+
+// +X -X +Y -Y +Z -Z
+static const glm::ivec3 s_Directions[6]{ { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+#define LIGHT_DIR_DOWN 3
+
+static inline glm::ivec3 LocalCoord(int index)
+{
+	return { (index / CHUNK_SIZE) % CHUNK_SIZE, index % CHUNK_SIZE, index / (CHUNK_SIZE * CHUNK_SIZE) };
+}
+
+// Nodes between two looks at the clock
+#define LIGHT_BUDGET_STEP 256
+
+LightEngine::LightEngine()
+{
+	m_Opacity .resize(BlocksManager::m_Blocks.size(), LIGHT_MAX);
+	m_Emission.resize(BlocksManager::m_Blocks.size(), 0);
+
+	for (const Block* block : BlocksManager::m_Blocks)
+	{
+		m_Opacity [block->m_ID] = block->m_IsTransparent ? (block->m_LightOpacity < LIGHT_MAX ? block->m_LightOpacity : LIGHT_MAX) : LIGHT_MAX;
+		m_Emission[block->m_ID] = block->m_LightEmission < LIGHT_MAX ? block->m_LightEmission : LIGHT_MAX;
+
+		m_HasEmitters |= block->m_LightEmission > 0;
+	}
+}
+
+void LightEngine::AddChunk(Chunk* chunk)
+{
+	std::lock_guard<std::mutex> pendingL(m_PendingLock);
+	m_Pending.push_back(chunk);
+}
+
+void LightEngine::RemoveColumn(const glm::ivec2& coord)
+{
+	auto it = m_Columns.find(coord);
+	if (it == m_Columns.end())
+		return;
+
+	for (Chunk* chunk : it->second.chunks)
+		m_Changed.erase(chunk);
+
+	m_LastChanged = nullptr;
+
+	std::erase(m_NewReady, coord);
+	m_Columns.erase(it);
+}
+
+void LightEngine::OnBlockChanged(Chunk* chunk, const glm::ivec3& localCoord)
+{
+	uint8_t* light = chunk->GetLightData();
+	if (light == nullptr)
+		return;
+
+	const int index = ID(localCoord.x, localCoord.y, localCoord.z);
+	const uint8_t oldLight = light[index];
+
+	// Whatever lit the block goes away, the add pass then brings back what still reaches it
+	for (int channel = 0; channel < ChannelCount; channel++)
+	{
+		const uint8_t level = GetLevel(light, index, (Channel)channel);
+		if (level == 0)
+			continue;
+
+		SetLevel(light, index, (Channel)channel, 0);
+		m_RemoveQueue[channel].push({ chunk, (uint16_t)index, level });
+	}
+
+	const uint8_t emission = m_Emission[chunk->GetBlockID(index)];
+	if (emission > 0)
+	{
+		SetLevel(light, index, BlockLight, emission);
+		m_AddQueue[BlockLight].push({ chunk, (uint16_t)index, 0 });
+	}
+
+	for (int dir = 0; dir < 6; dir++)
+	{
+		Chunk* neighbor;
+		int neighborIndex;
+		if (!Step(chunk, index, dir, &neighbor, &neighborIndex))
+			continue;
+
+		for (int channel = 0; channel < ChannelCount; channel++)
+			if (GetLevel(neighbor->GetLightData(), neighborIndex, (Channel)channel) > 1)
+				m_AddQueue[channel].push({ neighbor, (uint16_t)neighborIndex, 0 });
+	}
+
+	// The block itself is remeshed by the edit, only a change of light needs a new mesh
+	if (light[index] != oldLight)
+		MarkChanged(chunk, index);
+
+	m_Settled = false;
+}
+
+bool LightEngine::Update(float budgetMillis)
+{
+	Timer timer;
+
+	{
+		std::vector<Chunk*> pending;
+		{
+			std::lock_guard<std::mutex> pendingL(m_PendingLock);
+			pending.swap(m_Pending);
+		}
+
+		for (Chunk* chunk : pending)
+		{
+			const glm::ivec3 coord = ChunkCoord(chunk);
+
+			LightColumn& column = m_Columns[{ coord.x, coord.z }];
+			if (column.chunks[coord.y] == nullptr && ++column.count == CHUNK_Y_COUNT)
+				m_ColumnsToLight.push({ coord.x, coord.z });
+
+			column.chunks[coord.y] = chunk;
+		}
+	}
+
+	bool done;
+	while (true)
+	{
+		// Removals first, the add pass then refills what they cleared
+		done = ProcessRemove(SkyLight, timer, budgetMillis) && ProcessRemove(BlockLight, timer, budgetMillis)
+			&& ProcessAdd(SkyLight, timer, budgetMillis) && ProcessAdd(BlockLight, timer, budgetMillis);
+
+		if (!done || m_ColumnsToLight.empty())
+			break;
+
+		if (budgetMillis > 0.0f && timer.ElapsedMillis() >= budgetMillis)
+		{
+			done = false;
+			break;
+		}
+
+		SeedColumn(m_ColumnsToLight.front());
+		m_ColumnsToLight.pop();
+	}
+
+	m_Settled = done;
+
+	m_Stats.Queued = m_ColumnsToLight.size() * CHUNK_Y_COUNT;
+	for (int channel = 0; channel < ChannelCount; channel++)
+		m_Stats.Queued += m_AddQueue[channel].size() + m_RemoveQueue[channel].size();
+
+	m_Stats.UpdateMillis = timer.ElapsedMillis();
+
+	return m_Settled;
+}
+
+void LightEngine::TakeDirtyChunks(std::vector<Chunk*>& chunks)
+{
+	if (!m_Settled)
+		return;
+
+	for (const glm::ivec2& coord : m_NewReady)
+		for (Chunk* chunk : m_Columns[coord].chunks)
+		{
+			chunk->SetLightReady();
+			m_Changed.insert(chunk);
+		}
+
+	m_NewReady.clear();
+
+	// The others are reported when their column is ready
+	for (Chunk* chunk : m_Changed)
+		if (chunk->IsLightReady())
+			chunks.push_back(chunk);
+
+	m_Changed.clear();
+	m_LastChanged = nullptr;
+}
+
+void LightEngine::MarkDirty(Chunk* chunk)
+{
+	m_Changed.insert(chunk);
+}
+
+void LightEngine::SeedColumn(const glm::ivec2& coord)
+{
+	LightColumn& column = m_Columns[coord];
+
+	for (Chunk* chunk : column.chunks)
+		chunk->AllocateLight();
+
+	// Skylight falls straight down to the first block that is not fully transparent
+	int heights[CHUNK_SIZES];
+	for (int z = 0; z < CHUNK_SIZE; z++)
+		for (int x = 0; x < CHUNK_SIZE; x++)
+		{
+			int height = -1;
+			for (int y = CHUNK_MAX_HEIGHT - 1; y >= 0; y--)
+			{
+				Chunk* chunk = column.chunks[y / CHUNK_SIZE];
+
+				const int index = ID(x, y % CHUNK_SIZE, z);
+				if (m_Opacity[chunk->GetBlockID(index)] > 0)
+				{
+					height = y;
+					break;
+				}
+
+				SetLevel(chunk->GetLightData(), index, SkyLight, LIGHT_MAX);
+			}
+
+			heights[x + z * CHUNK_SIZE] = height;
+		}
+
+	// And spreads sideways where the terrain next to it is higher than its top block
+	for (int z = 0; z < CHUNK_SIZE; z++)
+		for (int x = 0; x < CHUNK_SIZE; x++)
+		{
+			const int height = heights[x + z * CHUNK_SIZE];
+
+			int maxHeight = height;
+			if (x > 0)              maxHeight = glm::max(maxHeight, heights[x - 1 + z * CHUNK_SIZE]);
+			if (x < CHUNK_SIZE - 1) maxHeight = glm::max(maxHeight, heights[x + 1 + z * CHUNK_SIZE]);
+			if (z > 0)              maxHeight = glm::max(maxHeight, heights[x + (z - 1) * CHUNK_SIZE]);
+			if (z < CHUNK_SIZE - 1) maxHeight = glm::max(maxHeight, heights[x + (z + 1) * CHUNK_SIZE]);
+
+			// And into the top block when it lets some light through (water)
+			if (height >= 0 && height < CHUNK_MAX_HEIGHT - 1 && m_Opacity[column.chunks[height / CHUNK_SIZE]->GetBlockID(ID(x, height % CHUNK_SIZE, z))] < LIGHT_MAX)
+				maxHeight = glm::max(maxHeight, height + 1);
+
+			for (int y = height + 1; y <= maxHeight; y++)
+				m_AddQueue[SkyLight].push({ column.chunks[y / CHUNK_SIZE], (uint16_t)(ID(x, y % CHUNK_SIZE, z)), 0 });
+		}
+
+	if (m_HasEmitters)
+		for (Chunk* chunk : column.chunks)
+		{
+			uint8_t* light = chunk->GetLightData();
+			for (int i = 0; i < CHUNK_SIZEQ; i++)
+			{
+				const uint8_t emission = m_Emission[chunk->GetBlockID(i)];
+				if (emission == 0)
+					continue;
+
+				SetLevel(light, i, BlockLight, emission);
+				m_AddQueue[BlockLight].push({ chunk, (uint16_t)i, 0 });
+			}
+		}
+
+	for (Chunk* chunk : column.chunks)
+		m_Changed.insert(chunk);
+
+	column.lit = true;
+	++m_Stats.ColumnsLit;
+
+	// Light flows both ways across the borders with the columns already lit
+	PushBorder(coord, 0);
+	PushBorder(coord, 1);
+	PushBorder(coord, 4);
+	PushBorder(coord, 5);
+
+	UpdateReady(coord);
+}
+
+void LightEngine::PushBorder(const glm::ivec2& coord, int dir)
+{
+	const glm::ivec3& direction = s_Directions[dir];
+
+	auto it = m_Columns.find(coord + glm::ivec2{ direction.x, direction.z });
+	if (it == m_Columns.end() || !it->second.lit)
+		return;
+
+	auto pushPlane = [this](const LightColumn& column, const glm::ivec3& side)
+	{
+		for (Chunk* chunk : column.chunks)
+		{
+			const uint8_t* light = chunk->GetLightData();
+
+			for (int i = 0; i < CHUNK_SIZE; i++)
+				for (int y = 0; y < CHUNK_SIZE; y++)
+				{
+					const int x = side.x > 0 ? CHUNK_SIZE - 1 : side.x < 0 ? 0 : i;
+					const int z = side.z > 0 ? CHUNK_SIZE - 1 : side.z < 0 ? 0 : i;
+
+					const int index = ID(x, y, z);
+					for (int channel = 0; channel < ChannelCount; channel++)
+						if (GetLevel(light, index, (Channel)channel) > 1)
+							m_AddQueue[channel].push({ chunk, (uint16_t)index, 0 });
+				}
+		}
+	};
+
+	pushPlane(m_Columns[coord], direction);
+	pushPlane(it->second, -direction);
+}
+
+void LightEngine::UpdateReady(const glm::ivec2& coord)
+{
+	// A column is ready once it and every column around it are lit, its light can only change by edits then
+	for (int dz = -1; dz <= 1; dz++)
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			const glm::ivec2 columnCoord = coord + glm::ivec2{ dx, dz };
+
+			auto it = m_Columns.find(columnCoord);
+			if (it == m_Columns.end() || !it->second.lit || it->second.ready)
+				continue;
+
+			bool ready = true;
+			for (int nz = -1; nz <= 1 && ready; nz++)
+				for (int nx = -1; nx <= 1 && ready; nx++)
+				{
+					auto neighbor = m_Columns.find(columnCoord + glm::ivec2{ nx, nz });
+					ready = neighbor != m_Columns.end() && neighbor->second.lit;
+				}
+
+			if (!ready)
+				continue;
+
+			it->second.ready = true;
+			m_NewReady.push_back(columnCoord);
+		}
+}
+
+bool LightEngine::ProcessRemove(Channel channel, Timer& timer, float budgetMillis)
+{
+	std::queue<LightNode>& queue = m_RemoveQueue[channel];
+
+	uint32_t steps = 0;
+	while (!queue.empty())
+	{
+		if (budgetMillis > 0.0f && ++steps % LIGHT_BUDGET_STEP == 0 && timer.ElapsedMillis() >= budgetMillis)
+			return false;
+
+		const LightNode node = queue.front();
+		queue.pop();
+
+		++m_Stats.NodesProcessed;
+
+		for (int dir = 0; dir < 6; dir++)
+		{
+			Chunk* neighbor;
+			int index;
+			if (!Step(node.chunk, node.index, dir, &neighbor, &index))
+				continue;
+
+			uint8_t* light = neighbor->GetLightData();
+
+			const uint8_t level = GetLevel(light, index, channel);
+			if (level == 0)
+				continue;
+
+			// Lit by the cleared block: cleared too, otherwise it lights the hole back in the add pass
+			const bool fullSkyBelow = channel == SkyLight && dir == LIGHT_DIR_DOWN && node.level == LIGHT_MAX && level == LIGHT_MAX;
+			if (level >= node.level && !fullSkyBelow)
+			{
+				m_AddQueue[channel].push({ neighbor, (uint16_t)index, 0 });
+				continue;
+			}
+
+			SetLevel(light, index, channel, 0);
+			MarkChanged(neighbor, index);
+
+			queue.push({ neighbor, (uint16_t)index, level });
+
+			// An emitting block keeps its own light
+			const uint8_t emission = channel == BlockLight ? m_Emission[neighbor->GetBlockID(index)] : 0;
+			if (emission > 0)
+			{
+				SetLevel(light, index, channel, emission);
+				m_AddQueue[channel].push({ neighbor, (uint16_t)index, 0 });
+			}
+		}
+	}
+
+	return true;
+}
+
+bool LightEngine::ProcessAdd(Channel channel, Timer& timer, float budgetMillis)
+{
+	std::queue<LightNode>& queue = m_AddQueue[channel];
+
+	uint32_t steps = 0;
+	while (!queue.empty())
+	{
+		if (budgetMillis > 0.0f && ++steps % LIGHT_BUDGET_STEP == 0 && timer.ElapsedMillis() >= budgetMillis)
+			return false;
+
+		const LightNode node = queue.front();
+		queue.pop();
+
+		++m_Stats.NodesProcessed;
+
+		const uint8_t level = GetLevel(node.chunk->GetLightData(), node.index, channel);
+		if (level <= 1)
+			continue;
+
+		for (int dir = 0; dir < 6; dir++)
+		{
+			Chunk* neighbor;
+			int index;
+			if (!Step(node.chunk, node.index, dir, &neighbor, &index))
+				continue;
+
+			const uint8_t opacity = m_Opacity[neighbor->GetBlockID(index)];
+			if (opacity >= LIGHT_MAX)
+				continue;
+
+			// Full skylight keeps falling without fading
+			const int newLevel = channel == SkyLight && dir == LIGHT_DIR_DOWN && level == LIGHT_MAX && opacity == 0 ? LIGHT_MAX : level - 1 - opacity;
+
+			uint8_t* light = neighbor->GetLightData();
+			if (newLevel <= GetLevel(light, index, channel))
+				continue;
+
+			SetLevel(light, index, channel, (uint8_t)newLevel);
+			MarkChanged(neighbor, index);
+
+			queue.push({ neighbor, (uint16_t)index, 0 });
+		}
+	}
+
+	return true;
+}
+
+bool LightEngine::Step(Chunk* chunk, int index, int dir, Chunk** neighbor, int* neighborIndex)
+{
+	const glm::ivec3 local = LocalCoord(index) + s_Directions[dir];
+
+	if (local.x >= 0 && local.x < CHUNK_SIZE && local.y >= 0 && local.y < CHUNK_SIZE && local.z >= 0 && local.z < CHUNK_SIZE)
+	{
+		*neighbor = chunk;
+		*neighborIndex = ID(local.x, local.y, local.z);
+		return true;
+	}
+
+	*neighbor = GetLitChunk(ChunkCoord(chunk) + s_Directions[dir]);
+	if (*neighbor == nullptr)
+		return false;
+
+	// Wraps -1 to CHUNK_SIZE - 1 and CHUNK_SIZE to 0
+	*neighborIndex = ID(local.x & (CHUNK_SIZE - 1), local.y & (CHUNK_SIZE - 1), local.z & (CHUNK_SIZE - 1));
+	return true;
+}
+
+Chunk* LightEngine::GetLitChunk(const glm::ivec3& coord)
+{
+	if (coord.y < 0 || coord.y >= CHUNK_Y_COUNT)
+		return nullptr;
+
+	auto it = m_Columns.find({ coord.x, coord.z });
+	return it != m_Columns.end() && it->second.lit ? it->second.chunks[coord.y] : nullptr;
+}
+
+void LightEngine::MarkChanged(Chunk* chunk, int index)
+{
+	if (chunk != m_LastChanged)
+	{
+		m_Changed.insert(chunk);
+		m_LastChanged = chunk;
+	}
+
+	const glm::ivec3 local = LocalCoord(index);
+	if (local.x > 0 && local.x < CHUNK_SIZE - 1 && local.y > 0 && local.y < CHUNK_SIZE - 1 && local.z > 0 && local.z < CHUNK_SIZE - 1)
+		return;
+
+	// The faces of the neighbor chunk on this border show this light too
+	for (int dir = 0; dir < 6; dir++)
+	{
+		const glm::ivec3 next = local + s_Directions[dir];
+		if (next.x >= 0 && next.x < CHUNK_SIZE && next.y >= 0 && next.y < CHUNK_SIZE && next.z >= 0 && next.z < CHUNK_SIZE)
+			continue;
+
+		Chunk* neighbor = GetLitChunk(ChunkCoord(chunk) + s_Directions[dir]);
+		if (neighbor != nullptr)
+			m_Changed.insert(neighbor);
+	}
+}
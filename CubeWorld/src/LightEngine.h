@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Chunk.h"
+
+#include "utils/Timer.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <queue>
+#include <mutex>
+
+struct LightStats
+{
+	uint64_t ColumnsLit = 0, NodesProcessed = 0;
+	size_t Queued = 0;
+
+	float UpdateMillis = 0.0f; // Last Update
+};
+
+// Flood fill block light and skylight, stored in the chunks as two nibbles per block.
+// A column is lit once all its chunks are filled: the skylight falls from the heightmap,
+// the emitting blocks are seeded and the light spreads across the borders of the lit
+// columns around it. Only AddChunk is thread safe, everything else runs on one thread.
+class LightEngine
+{
+public:
+	LightEngine();
+
+	void AddChunk(Chunk* chunk);
+
+	// Forget a column before its chunks are freed, only when settled
+	void RemoveColumn(const glm::ivec2& column);
+
+	// Relight around a block after it changed, does nothing if its column is not lit yet
+	void OnBlockChanged(Chunk* chunk, const glm::ivec3& localCoord);
+
+	// Light new columns and run the queued passes for at most budget ms (0 = until done), true once settled
+	bool Update(float budgetMillis);
+
+	// Once settled: the chunks whose light changed or became final, they need a new mesh
+	void TakeDirtyChunks(std::vector<Chunk*>& chunks);
+
+	// Reported again by the next TakeDirtyChunks
+	void MarkDirty(Chunk* chunk);
+
+	inline const LightStats& GetStats() const { return m_Stats; }
+
+private:
+	struct LightColumn
+	{
+		Chunk* chunks[CHUNK_Y_COUNT]{};
+		uint32_t count = 0;
+
+		bool lit = false, ready = false;
+	};
+
+	struct LightNode
+	{
+		Chunk* chunk;
+		uint16_t index;
+		uint8_t level; // Only for removals, the level before it was cleared
+	};
+
+	enum Channel { SkyLight, BlockLight, ChannelCount };
+
+	void SeedColumn(const glm::ivec2& coord);
+
+	void PushBorder(const glm::ivec2& coord, int dir);
+
+	void UpdateReady(const glm::ivec2& coord);
+
+	bool ProcessRemove(Channel channel, Timer& timer, float budgetMillis);
+	bool ProcessAdd   (Channel channel, Timer& timer, float budgetMillis);
+
+	bool Step(Chunk* chunk, int index, int dir, Chunk** neighbor, int* neighborIndex);
+
+	Chunk* GetLitChunk(const glm::ivec3& coord);
+
+	void MarkChanged(Chunk* chunk, int index);
+
+	static inline glm::ivec3 ChunkCoord(const Chunk* chunk) { return glm::ivec3(glm::floor(chunk->m_Coord * CHUNK_SIZE_INV)); }
+
+	static inline uint8_t GetLevel(const uint8_t* light, int index, Channel channel)
+	{
+		return channel == SkyLight ? LIGHT_SKY(light[index]) : LIGHT_BLOCK(light[index]);
+	}
+
+	static inline void SetLevel(uint8_t* light, int index, Channel channel, uint8_t level)
+	{
+		light[index] = channel == SkyLight ? (light[index] & 0x0F) | (level << 4) : (light[index] & 0xF0) | level;
+	}
+
+private:
+	std::vector<uint8_t> m_Opacity, m_Emission;
+	bool m_HasEmitters = false;
+
+	std::vector<Chunk*> m_Pending;
+	std::mutex m_PendingLock;
+
+	std::unordered_map<glm::ivec2, LightColumn> m_Columns;
+	std::queue<glm::ivec2> m_ColumnsToLight;
+	std::vector<glm::ivec2> m_NewReady;
+
+	std::queue<LightNode> m_AddQueue[ChannelCount], m_RemoveQueue[ChannelCount];
+
+	std::unordered_set<Chunk*> m_Changed;
+	Chunk* m_LastChanged = nullptr;
+
+	bool m_Settled = true;
+
+	LightStats m_Stats;
+};
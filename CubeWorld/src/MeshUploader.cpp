@@ -0,0 +1,151 @@
+#include "MeshUploader.h"
+
+#include "utils/Timer.h"
+
+MeshUploader::MeshUploader()
+{
+	GLFWwindow* window = glfwGetCurrentContext();
+
+	// Never shown, only its context is used. The other hints are the ones of the window
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_Context = glfwCreateWindow(1, 1, "Upload", nullptr, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	if (!m_Context)
+	{
+		std::cout << "No shared context, the meshes are uploaded on the render thread" << std::endl;
+
+		m_Staging = std::make_unique<StagingRing>();
+		m_StagingStats = m_Staging->GetStats();
+		return;
+	}
+
+	m_Stats.Threaded = true;
+
+	m_Running = true;
+	m_Thread = std::thread(&MeshUploader::Run, this);
+}
+
+MeshUploader::~MeshUploader()
+{
+	if (m_Context)
+	{
+		{
+			std::lock_guard<std::mutex> queueL(m_QueueLock);
+			m_Running = false;
+		}
+
+		m_QueueCondition.notify_one();
+		m_Thread.join();
+
+		glfwDestroyWindow(m_Context);
+	}
+
+	m_Staging.reset();
+
+	// Buffers are shared, the window's context deletes the ones never swapped in
+	for (auto& [fence, upload] : m_Written)
+	{
+		if (fence)
+		{
+			GLCall(glDeleteSync(fence));
+		}
+
+		GLCall(glDeleteBuffers(4, upload.buffers));
+	}
+}
+
+void MeshUploader::Submit(Chunk* chunk, Mesh&& mesh)
+{
+	++m_InFlight;
+
+	MeshUpload upload;
+	upload.chunk = chunk;
+	upload.mesh = std::move(mesh);
+
+	if (!m_Context)
+	{
+		Chunk::PrepareUpload(upload, m_Staging.get());
+
+		std::lock_guard<std::mutex> writtenL(m_WrittenLock);
+		m_Written.emplace_back(nullptr, std::move(upload));
+		m_StagingStats = m_Staging->GetStats();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> queueL(m_QueueLock);
+		m_Queue.push_back(std::move(upload));
+	}
+
+	m_QueueCondition.notify_one();
+}
+
+void MeshUploader::TakeFinished(std::vector<MeshUpload>& finished)
+{
+	std::lock_guard<std::mutex> writtenL(m_WrittenLock);
+
+	m_Stats.UploadMillis = m_UploadMillis;
+	m_Stats.Staging = m_StagingStats;
+
+	while (!m_Written.empty())
+	{
+		auto& [fence, upload] = m_Written.front();
+
+		// The ones after it are not swapped in before it, a chunk can have two on the way
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				break;
+
+			GLCall(glDeleteSync(fence));
+		}
+
+		finished.push_back(std::move(upload));
+		m_Written.pop_front();
+
+		--m_InFlight;
+		++m_Stats.Uploaded;
+	}
+}
+
+void MeshUploader::Run()
+{
+	glfwMakeContextCurrent(m_Context);
+
+	m_Staging = std::make_unique<StagingRing>();
+
+	while (true)
+	{
+		MeshUpload upload;
+		{
+			std::unique_lock<std::mutex> queueL(m_QueueLock);
+			m_QueueCondition.wait(queueL, [this] { return !m_Running || !m_Queue.empty(); });
+
+			if (!m_Running)
+				break;
+
+			upload = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+
+		Timer timer;
+
+		Chunk::PrepareUpload(upload, m_Staging.get());
+
+		// Flushed, a fence never sent to the GPU is never signaled for the render thread
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GLCall(glFlush());
+
+		const float millis = timer.ElapsedMillis();
+
+		std::lock_guard<std::mutex> writtenL(m_WrittenLock);
+		m_Written.emplace_back(fence, std::move(upload));
+
+		m_UploadMillis = m_UploadMillis == 0.0f ? millis : m_UploadMillis + (millis - m_UploadMillis) * 0.05f;
+		m_StagingStats = m_Staging->GetStats();
+	}
+
+	m_Staging.reset();
+	glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Core.h"
+#include "Chunk.h"
+#include "StagingRing.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+#define UPLOADS_IN_FLIGHT 32 // Meshes submitted and not swapped in yet at most, each one holds its quads twice until then
+#define UPLOADS_PER_FRAME 15 // Written on the render thread at most between two TakeFinished, without a shared context
+
+struct MeshUploaderStats
+{
+	bool Threaded = false;       // Else written on the render thread when submitted (no shared context)
+	float UploadMillis = 0.0f;   // Of a mesh on the upload thread, averaged
+	uint64_t Uploaded = 0;       // Swapped in since the start
+
+	StagingRingStats Staging;
+};
+
+// Writes the meshes of whole chunks to new buffers on a thread of its own, with a hidden window whose context is
+// shared with the one current when it is made. The quads go through a persistent mapped staging ring when there is
+// one. Each mesh is fenced once written, the render thread takes them in
+// submit order once their fence is signaled and only swaps the buffers in. Without a shared context the meshes are
+// written on the render thread as they are submitted.
+class MeshUploader
+{
+public:
+	// The window's context must be current
+	MeshUploader();
+	~MeshUploader();
+
+	// Without a shared context every mesh submitted is taken by the next TakeFinished, so it caps the meshes of a frame
+	inline bool CanSubmit() const { return m_InFlight < (m_Context ? UPLOADS_IN_FLIGHT : UPLOADS_PER_FRAME); }
+
+	// Render thread. Laid out and written in the order submitted
+	void Submit(Chunk* chunk, Mesh&& mesh);
+
+	// Render thread. The uploads whose buffers are written, in submit order, for Chunk::SwapMesh
+	void TakeFinished(std::vector<MeshUpload>& finished);
+
+	inline uint32_t GetInFlight() const { return m_InFlight; }
+
+	inline const MeshUploaderStats& GetStats() const { return m_Stats; }
+
+private:
+	void Run();
+
+private:
+	GLFWwindow* m_Context = nullptr;
+	std::thread m_Thread;
+	std::atomic<bool> m_Running = false;
+
+	// Made and used with the context of the thread writing the meshes
+	std::unique_ptr<StagingRing> m_Staging;
+
+	std::deque<MeshUpload> m_Queue;
+	std::mutex m_QueueLock;
+	std::condition_variable m_QueueCondition;
+
+	// Written, fence signaled once the GPU has the buffers (none when written on the render thread)
+	std::deque<std::pair<GLsync, MeshUpload>> m_Written;
+	std::mutex m_WrittenLock;
+
+	uint32_t m_InFlight = 0;
+	float m_UploadMillis = 0.0f; // Upload thread, under m_WrittenLock
+	StagingRingStats m_StagingStats;
+
+	MeshUploaderStats m_Stats;
+};
@@ -0,0 +1,259 @@
+#include "OcclusionBuffer.h"
+
+#include "utils/Timer.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Points closer to the camera plane are treated as behind it
+#define OCCLUSION_NEAR 0.01f
+
+OcclusionBuffer::OcclusionBuffer(size_t bands)
+	: m_Depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 0.0f), m_BandMillis(bands, 0.0f)
+{
+	m_Workers = std::make_unique<ThreadPool>(bands);
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+	Finish();
+}
+
+void OcclusionBuffer::Begin(const glm::mat4& viewProjection, const glm::vec3& position, std::vector<OccluderQuad>&& occluders)
+{
+	Finish();
+
+	m_ViewProjection = viewProjection;
+	m_Position = position;
+	m_Occluders = std::move(occluders);
+
+	m_Stats.Occluders = (uint32_t)m_Occluders.size();
+	m_Stats.Tested = m_Stats.Occluded = 0;
+	m_Stats.TestMicros = 0.0f;
+
+	for (int band = 0; band < (int)m_BandMillis.size(); ++band)
+		m_Bands.push_back(m_Workers->enqueue([this, band]() { RasterizeBand(band); }));
+}
+
+bool OcclusionBuffer::Finish()
+{
+	if (m_Bands.empty())
+		return false;
+
+	for (std::future<void>& band : m_Bands)
+		band.wait();
+
+	m_Bands.clear();
+
+	m_Stats.RasterMillis = *std::max_element(m_BandMillis.begin(), m_BandMillis.end());
+	m_Stats.Triangles = m_Triangles;
+	return true;
+}
+
+bool OcclusionBuffer::Project(const glm::vec3& point, glm::vec3& screen) const
+{
+	const glm::vec4 clip = m_ViewProjection * glm::vec4{ point, 1.0f };
+	if (clip.w < OCCLUSION_NEAR)
+		return false;
+
+	const float invW = 1.0f / clip.w;
+	screen = glm::vec3{ (clip.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH, (clip.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT, invW };
+	return true;
+}
+
+void OcclusionBuffer::RasterizeBand(int band)
+{
+	Timer timer;
+
+	const int bands = (int)m_BandMillis.size();
+	const int rowFrom = band * OCCLUSION_HEIGHT / bands, rowTo = (band + 1) * OCCLUSION_HEIGHT / bands;
+
+	std::fill(m_Depth.begin() + rowFrom * OCCLUSION_WIDTH, m_Depth.begin() + rowTo * OCCLUSION_WIDTH, 0.0f);
+
+	uint32_t triangles = 0;
+	for (const OccluderQuad& quad : m_Occluders)
+	{
+		if ((m_Position[quad.axis] - quad.min[quad.axis]) * quad.normal <= 0.0f)
+			continue;
+
+		// A quad reaching behind the camera is skipped, leaving out an occluder is always safe
+		const int u = (quad.axis + 1) % 3, v = (quad.axis + 2) % 3;
+
+		glm::vec3 corners[4];
+		bool inFront = true;
+		float minY = FLT_MAX, maxY = -FLT_MAX;
+		for (int i = 0; i < 4 && inFront; ++i)
+		{
+			glm::vec3 corner = quad.min;
+			corner[u] = i == 1 || i == 2 ? quad.max[u] : quad.min[u];
+			corner[v] = i >= 2 ? quad.max[v] : quad.min[v];
+
+			inFront = Project(corner, corners[i]);
+
+			minY = corners[i].y < minY ? corners[i].y : minY;
+			maxY = corners[i].y > maxY ? corners[i].y : maxY;
+		}
+
+		if (!inFront)
+			continue;
+
+		triangles += 2;
+		if (maxY < rowFrom || minY > rowTo)
+			continue;
+
+		RasterizeTriangle(corners[0], corners[1], corners[2], rowFrom, rowTo);
+		RasterizeTriangle(corners[0], corners[2], corners[3], rowFrom, rowTo);
+	}
+
+	if (band == 0)
+		m_Triangles = triangles;
+
+	m_BandMillis[band] = timer.ElapsedMillis();
+}
+
+void OcclusionBuffer::RasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, int rowFrom, int rowTo)
+{
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::abs(area) < 1e-6f)
+		return;
+
+	// Counter clockwise
+	const glm::vec3* v[3]{ &v0, &v1, &v2 };
+	if (area < 0.0f)
+	{
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	const int x0 = std::max(0, (int)std::floor(std::min({ v0.x, v1.x, v2.x }))) & ~3;
+	const int x1 = std::min(OCCLUSION_WIDTH - 1, (int)std::floor(std::max({ v0.x, v1.x, v2.x })));
+	const int y0 = std::max(rowFrom, (int)std::floor(std::min({ v0.y, v1.y, v2.y })));
+	const int y1 = std::min(rowTo - 1, (int)std::floor(std::max({ v0.y, v1.y, v2.y })));
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	// Edge functions A x + B y + C, positive inside and weighting the vertex across the edge,
+	// taken at the center of the pixels so the quads sharing an edge leave no gap between them
+	float A[3], B[3], C[3];
+	glm::vec3 depth{ 0.0f }; // Plane of 1/w in x, y, 1
+	for (int e = 0; e < 3; ++e)
+	{
+		const glm::vec3& a = *v[(e + 1) % 3], & b = *v[(e + 2) % 3];
+
+		A[e] = a.y - b.y;
+		B[e] = b.x - a.x;
+		C[e] = a.x * b.y - a.y * b.x;
+
+		depth += glm::vec3{ A[e], B[e], C[e] } * (v[e]->z / area);
+
+		C[e] += 0.5f * (A[e] + B[e]);
+	}
+
+	// The farthest depth of the plane in the pixel
+	depth.z += 0.5f * (depth.x + depth.y) - 0.5f * (std::abs(depth.x) + std::abs(depth.y));
+
+	const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		// The span of the row inside every edge, A x + B y + C > 0 bounds x from one side
+		float spanFrom = (float)x0, spanTo = (float)x1;
+		for (int e = 0; e < 3; ++e)
+		{
+			const float edge = B[e] * y + C[e];
+			if (A[e] > 0.0f)
+				spanFrom = std::max(spanFrom, -edge / A[e]);
+			else if (A[e] < 0.0f)
+				spanTo = std::min(spanTo, -edge / A[e]);
+			else if (edge < 0.0f)
+				spanTo = -1.0f;
+		}
+
+		if (spanFrom > spanTo)
+			continue;
+
+		float* row = &m_Depth[y * OCCLUSION_WIDTH];
+
+		const __m128 rowEdge0 = _mm_set1_ps(B[0] * y + C[0]);
+		const __m128 rowEdge1 = _mm_set1_ps(B[1] * y + C[1]);
+		const __m128 rowEdge2 = _mm_set1_ps(B[2] * y + C[2]);
+		const __m128 rowDepth = _mm_set1_ps(depth.y * y + depth.z);
+
+		// The lanes are still tested, the span only skips the blocks of four outside it
+		const int from = (int)std::floor(spanFrom) & ~3, to = (int)std::ceil(spanTo);
+		for (int x = from; x <= to && x <= x1; x += 4)
+		{
+			const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), rowEdge0), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), rowEdge1), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), rowEdge2), zero));
+
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(depth.x), px), rowDepth);
+			const __m128 old = _mm_loadu_ps(row + x);
+
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, z)), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	Timer timer;
+
+	++m_Stats.Tested;
+
+	// The pixels the box touches and its nearest depth, a box reaching behind the camera is visible
+	glm::vec2 rectMin{ FLT_MAX }, rectMax{ -FLT_MAX };
+	float nearest = 0.0f;
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 corner;
+		if (!Project({ i & 1 ? boxMax.x : boxMin.x, i & 2 ? boxMax.y : boxMin.y, i & 4 ? boxMax.z : boxMin.z }, corner))
+		{
+			m_Stats.TestMicros += timer.ElapsedMillis() * 1000.0f;
+			return false;
+		}
+
+		rectMin = glm::min(rectMin, glm::vec2{ corner });
+		rectMax = glm::max(rectMax, glm::vec2{ corner });
+		nearest = corner.z > nearest ? corner.z : nearest;
+	}
+
+	const int x0 = std::max(0, (int)std::floor(rectMin.x)), x1 = std::min(OCCLUSION_WIDTH  - 1, (int)std::floor(rectMax.x));
+	const int y0 = std::max(0, (int)std::floor(rectMin.y)), y1 = std::min(OCCLUSION_HEIGHT - 1, (int)std::floor(rectMax.y));
+
+	bool occluded = x0 <= x1 && y0 <= y1;
+
+	const __m128 boxDepth = _mm_set1_ps(nearest);
+	const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	const __m128 first = _mm_set1_ps((float)x0), last = _mm_set1_ps((float)x1);
+
+	for (int y = y0; y <= y1 && occluded; ++y)
+	{
+		const float* row = &m_Depth[y * OCCLUSION_WIDTH];
+
+		for (int x = x0 & ~3; x <= x1; x += 4)
+		{
+			const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+			const __m128 inRect = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+
+			// Any pixel whose occluders are farther than the box
+			if (_mm_movemask_ps(_mm_and_ps(inRect, _mm_cmplt_ps(_mm_loadu_ps(row + x), boxDepth))))
+			{
+				occluded = false;
+				break;
+			}
+		}
+	}
+
+	m_Stats.Occluded += occluded;
+	m_Stats.TestMicros += timer.ElapsedMillis() * 1000.0f;
+	return occluded;
+}
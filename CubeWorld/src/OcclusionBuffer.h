@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils/ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <future>
+#include <memory>
+
+#define OCCLUSION_WIDTH 256 // Multiple of 4
+#define OCCLUSION_HEIGHT 128
+
+// Rectangle on the surface of something solid, flat along axis and seen from the side of its normal
+struct OccluderQuad
+{
+	glm::vec3 min, max;
+	int axis;
+	float normal; // 1 or -1
+};
+
+struct OcclusionStats
+{
+	uint32_t Occluders = 0, Triangles = 0;
+	uint32_t Tested = 0, Occluded = 0;
+
+	float RasterMillis = 0.0f; // Slowest band
+	float TestMicros = 0.0f;
+};
+
+// Low resolution depth buffer of solid surfaces rasterized on the CPU, in horizontal bands on
+// its own worker threads while the frame goes on. The pixels whose center an occluder covers
+// are written with its farthest depth in them, a box behind every pixel it touches is culled.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(size_t bands);
+	~OcclusionBuffer();
+
+	// Start rasterizing the occluders as seen by viewProjection from position, returns at once
+	void Begin(const glm::mat4& viewProjection, const glm::vec3& position, std::vector<OccluderQuad>&& occluders);
+
+	// Wait for the bands of the last Begin, false if there was none
+	bool Finish();
+
+	// Between Finish and the next Begin: the box is behind the occluders in every pixel it covers
+	bool IsOccluded(const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+	inline const OcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	void RasterizeBand(int band);
+
+	void RasterizeTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, int rowFrom, int rowTo);
+
+	// Pixel x, y and 1/w of a point, false if it is behind the camera
+	bool Project(const glm::vec3& point, glm::vec3& screen) const;
+
+private:
+	std::vector<float> m_Depth; // 1/w of the nearest occluder, 0 for none
+
+	glm::mat4 m_ViewProjection{ 1.0f };
+	glm::vec3 m_Position{ 0.0f };
+
+	std::vector<OccluderQuad> m_Occluders;
+
+	std::vector<std::future<void>> m_Bands;
+	std::vector<float> m_BandMillis;
+	uint32_t m_Triangles = 0; // Of the quads facing the camera, counted by the first band
+
+	OcclusionStats m_Stats;
+
+	std::unique_ptr<ThreadPool> m_Workers; // Last, joined before the rest is freed
+};
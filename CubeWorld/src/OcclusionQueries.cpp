@@ -0,0 +1,268 @@
+#include "OcclusionQueries.h"
+
+#include "Core.h"
+
+// Column boxes grow by this much, their faces stay in front of the quads they bound
+#define QUERY_BOX_MARGIN 0.05f
+// A camera this close to a box could clip it with the near plane
+#define QUERY_CAMERA_MARGIN 1.0f
+
+OcclusionQueries::OcclusionQueries()
+{
+	m_Shader = std::make_unique<Shader>("res/shaders/occlusion.shader");
+	m_MinLocation = m_Shader->GetUniformLocation("u_Min");
+	m_MaxLocation = m_Shader->GetUniformLocation("u_Max");
+
+	const float vertices[] =
+	{
+		0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  0.0f, 1.0f, 1.0f,  1.0f, 1.0f, 1.0f,
+	};
+
+	// Drawn without face culling, the winding does not matter
+	const uint32_t indices[] =
+	{
+		0, 1, 2, 2, 1, 3, // Z-
+		4, 5, 6, 6, 5, 7, // Z+
+		0, 1, 4, 4, 1, 5, // Y-
+		2, 3, 6, 6, 3, 7, // Y+
+		0, 2, 4, 4, 2, 6, // X-
+		1, 3, 5, 5, 3, 7, // X+
+	};
+
+	GLCall(glGenVertexArrays(1, &m_BoxVAO));
+	GLCall(glBindVertexArray(m_BoxVAO));
+
+	GLCall(glGenBuffers(1, &m_BoxVBO));
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_BoxVBO));
+	GLCall(glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW));
+
+	GLCall(glEnableVertexAttribArray(0));
+	GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (const void*)0));
+
+	GLCall(glGenBuffers(1, &m_BoxIBO));
+	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxIBO));
+	GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW));
+
+	GLCall(glBindVertexArray(0));
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+	for (const PendingQuery& pending : m_Pending)
+		m_FreeQueries.push_back(pending.query);
+
+	if (!m_FreeQueries.empty())
+		glDeleteQueries((GLsizei)m_FreeQueries.size(), m_FreeQueries.data());
+
+	glDeleteBuffers(1, &m_BoxVBO);
+	glDeleteBuffers(1, &m_BoxIBO);
+	glDeleteVertexArrays(1, &m_BoxVAO);
+}
+
+uint32_t OcclusionQueries::AcquireQuery()
+{
+	if (m_FreeQueries.empty())
+	{
+		uint32_t query;
+		GLCall(glGenQueries(1, &query));
+		return query;
+	}
+
+	const uint32_t query = m_FreeQueries.back();
+	m_FreeQueries.pop_back();
+	return query;
+}
+
+void OcclusionQueries::BeginFrame()
+{
+	++m_Frame;
+
+	m_Stats.Issued = m_Stats.Hidden = m_Stats.Saved = 0;
+	m_Stats.LatencyFrames = 0.0f;
+	m_Stats.MaxLatency = 0;
+
+	uint32_t read = 0, latency = 0;
+
+	// Results come in order of submission, mostly, each one is checked anyway
+	for (size_t i = 0; i < m_Pending.size();)
+	{
+		PendingQuery& pending = m_Pending[i];
+
+		GLuint available = GL_FALSE;
+		GLCall(glGetQueryObjectuiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available));
+		if (!available)
+		{
+			++i;
+			continue;
+		}
+
+		GLuint passed = 0;
+		GLCall(glGetQueryObjectuiv(pending.query, GL_QUERY_RESULT, &passed));
+
+		if (pending.chunk)
+		{
+			ChunkState& state = m_States[pending.chunk];
+			state.visibility = passed ? Visibility::Visible : Visibility::Hidden;
+			state.pending = false;
+		}
+		else if (passed)
+		{
+			// Drawn and queried one by one from now on
+			for (Chunk* chunk : pending.columns)
+			{
+				ChunkState& state = m_States[chunk];
+				if (state.visibility == Visibility::Hidden)
+					state.visibility = Visibility::Unknown;
+			}
+		}
+		else
+			m_Stats.Saved += (uint32_t)pending.columns.size();
+
+		const uint32_t frames = m_Frame - pending.frame;
+		latency += frames;
+		m_Stats.MaxLatency = frames > m_Stats.MaxLatency ? frames : m_Stats.MaxLatency;
+		++read;
+
+		m_FreeQueries.push_back(pending.query);
+
+		if (i + 1 < m_Pending.size())
+			pending = std::move(m_Pending.back());
+
+		m_Pending.pop_back();
+	}
+
+	if (read > 0)
+		m_Stats.LatencyFrames = (float)latency / read;
+
+	m_Stats.Pending = (uint32_t)m_Pending.size();
+}
+
+void OcclusionQueries::Split(std::vector<Chunk*>& chunks, std::vector<Chunk*>& hidden)
+{
+	size_t kept = 0;
+	for (Chunk* chunk : chunks)
+	{
+		ChunkState& state = m_States[chunk];
+
+		// Back in view, its last result may be from anywhere
+		if (state.seenFrame != m_Frame - 1)
+			state.visibility = Visibility::Unknown;
+
+		state.seenFrame = m_Frame;
+
+		if (state.visibility == Visibility::Hidden)
+			hidden.push_back(chunk);
+		else
+			chunks[kept++] = chunk;
+	}
+
+	chunks.resize(kept);
+
+	m_Stats.Hidden = (uint32_t)hidden.size();
+}
+
+void OcclusionQueries::BeginDraw(Chunk* chunk)
+{
+	ChunkState& state = m_States[chunk];
+	if (state.pending)
+		return;
+
+	state.pending = true;
+
+	m_ActiveQuery = AcquireQuery();
+	m_Pending.push_back({ m_ActiveQuery, m_Frame, chunk, {} });
+	++m_Stats.Issued;
+
+	GLCall(glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, m_ActiveQuery));
+}
+
+void OcclusionQueries::EndDraw()
+{
+	if (m_ActiveQuery == 0)
+		return;
+
+	GLCall(glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE));
+	m_ActiveQuery = 0;
+}
+
+void OcclusionQueries::TestHidden(const glm::vec3& position, const std::vector<Chunk*>& hidden, std::vector<uint32_t>& conditions)
+{
+	conditions.assign(hidden.size(), 0);
+
+	// The bounds of the hidden chunks of each column
+	std::unordered_map<glm::vec2, size_t> columnIndex;
+	std::vector<std::pair<glm::vec3, glm::vec3>> columnBounds;
+	std::vector<std::vector<size_t>> columnChunks;
+
+	for (size_t i = 0; i < hidden.size(); ++i)
+	{
+		const glm::vec3& coord = hidden[i]->m_Coord;
+
+		glm::vec3 boundsMin, boundsMax;
+		hidden[i]->GetBounds(boundsMin, boundsMax);
+		boundsMin += coord;
+		boundsMax += coord;
+
+		auto [it, inserted] = columnIndex.insert({ glm::vec2{ coord.x, coord.z }, columnBounds.size() });
+		if (inserted)
+		{
+			columnBounds.push_back({ boundsMin, boundsMax });
+			columnChunks.emplace_back();
+		}
+		else
+		{
+			auto& [columnMin, columnMax] = columnBounds[it->second];
+			for (int a = 0; a < 3; ++a)
+			{
+				columnMin[a] = boundsMin[a] < columnMin[a] ? boundsMin[a] : columnMin[a];
+				columnMax[a] = boundsMax[a] > columnMax[a] ? boundsMax[a] : columnMax[a];
+			}
+		}
+
+		columnChunks[it->second].push_back(i);
+	}
+
+	GLCall(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+	GLCall(glDepthMask(GL_FALSE));
+	GLCall(glDisable(GL_CULL_FACE));
+
+	m_Shader->Bind();
+
+	GLCall(glBindVertexArray(m_BoxVAO));
+
+	for (size_t c = 0; c < columnBounds.size(); ++c)
+	{
+		const glm::vec3 boxMin = columnBounds[c].first - QUERY_BOX_MARGIN, boxMax = columnBounds[c].second + QUERY_BOX_MARGIN;
+
+		// Drawn as usual, and queried alone again
+		if (glm::all(glm::greaterThan(position, boxMin - QUERY_CAMERA_MARGIN)) && glm::all(glm::lessThan(position, boxMax + QUERY_CAMERA_MARGIN)))
+		{
+			for (size_t i : columnChunks[c])
+				m_States[hidden[i]].visibility = Visibility::Unknown;
+
+			continue;
+		}
+
+		PendingQuery pending{ AcquireQuery(), m_Frame, nullptr, {} };
+		for (size_t i : columnChunks[c])
+		{
+			pending.columns.push_back(hidden[i]);
+			conditions[i] = pending.query;
+		}
+
+		m_Shader->SetUniform3f(m_MinLocation, boxMin.x, boxMin.y, boxMin.z);
+		m_Shader->SetUniform3f(m_MaxLocation, boxMax.x, boxMax.y, boxMax.z);
+
+		GLCall(glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, pending.query));
+		GLCall(glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr));
+		GLCall(glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE));
+
+		m_Pending.push_back(std::move(pending));
+		++m_Stats.Issued;
+	}
+
+	GLCall(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+	GLCall(glDepthMask(GL_TRUE));
+	GLCall(glEnable(GL_CULL_FACE));
+}
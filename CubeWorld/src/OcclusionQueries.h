@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Chunk.h"
+#include "Shader.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+
+struct QueryStats
+{
+	uint32_t Issued = 0, Pending = 0; // Issued this frame, still in flight from the ones before
+	uint32_t Hidden = 0;              // Chunks drawn only if their column box passes
+	uint32_t Saved = 0;               // Chunk draws the GPU skipped, by the results read this frame
+
+	// Frames from issue to result, of the results read this frame
+	float LatencyFrames = 0.0f;
+	uint32_t MaxLatency = 0;
+};
+
+// Occlusion queries of the chunks on the GPU, read back frames later so the CPU never waits.
+// A chunk drawn last time is drawn again inside a query of its own samples.
+// Once it passes no sample it is hidden: the hidden chunks of a column are tested together
+// with a box of their bounds against the depth of the drawn ones, and drawn under conditional
+// render of that query. A box that passes makes them drawn and queried one by one again.
+class OcclusionQueries
+{
+public:
+	OcclusionQueries();
+	~OcclusionQueries();
+
+	// Read the results available, never waits
+	void BeginFrame();
+
+	// Move the chunks hidden by their last result from chunks to hidden, both keep the order of chunks
+	// (front to back, the farther ones pass fewer samples). A chunk not in the last frame's chunks is tested again.
+	void Split(std::vector<Chunk*>& chunks, std::vector<Chunk*>& hidden);
+
+	// Around the draw of a chunk left in chunks by Split, queried when it has no query in flight
+	void BeginDraw(Chunk* chunk);
+	void EndDraw();
+
+	// After the drawn chunks, test the columns of the hidden ones. The query each chunk has to be drawn
+	// under (conditional render) goes to conditions, 0 for the ones the camera is in, always drawn.
+	void TestHidden(const glm::vec3& position, const std::vector<Chunk*>& hidden, std::vector<uint32_t>& conditions);
+
+	inline const QueryStats& GetStats() const { return m_Stats; }
+
+private:
+	enum class Visibility : uint8_t { Unknown, Visible, Hidden };
+
+	struct ChunkState
+	{
+		Visibility visibility = Visibility::Unknown;
+		bool pending = false;
+		uint32_t seenFrame = 0;
+	};
+
+	struct PendingQuery
+	{
+		uint32_t query;
+		uint32_t frame;
+		Chunk* chunk;                // Of its draw, nullptr for a column box
+		std::vector<Chunk*> columns; // Hidden chunks of the column box
+	};
+
+	uint32_t AcquireQuery();
+
+private:
+	std::unique_ptr<Shader> m_Shader; // Camera from the frame uniforms
+	int m_MinLocation = -1, m_MaxLocation = -1;
+	uint32_t m_BoxVAO = 0, m_BoxVBO = 0, m_BoxIBO = 0;
+
+	std::unordered_map<Chunk*, ChunkState> m_States;
+
+	std::vector<PendingQuery> m_Pending;
+	std::vector<uint32_t> m_FreeQueries;
+	uint32_t m_ActiveQuery = 0; // Between BeginDraw and EndDraw
+
+	uint32_t m_Frame = 1;
+
+	QueryStats m_Stats;
+};
@@ -0,0 +1,77 @@
+#include "RenderList.h"
+
+#include "utils/Timer.h"
+
+void RenderList::Add(Chunk* chunk)
+{
+	if (chunk->m_RenderRank != RENDER_RANK_NONE)
+		return;
+
+	// Last until the next sort
+	chunk->m_RenderRank = (uint32_t)m_Chunks.size();
+	m_Chunks.push_back(chunk);
+
+	m_Dirty = true;
+	m_Stats.Chunks = (uint32_t)m_Chunks.size();
+}
+
+void RenderList::Update(const glm::vec3& position)
+{
+	const glm::vec3 moved = position - m_SortPosition;
+	if (m_Dirty || glm::dot(moved, moved) > RENDER_LIST_RESORT * RENDER_LIST_RESORT)
+		Sort(position);
+}
+
+void RenderList::Sort(const glm::vec3& position)
+{
+	Timer timer;
+
+	m_SortPosition = position;
+	m_Dirty = false;
+
+	if (m_Chunks.empty())
+		return;
+
+	m_Keys.resize(m_Chunks.size());
+	m_KeysScratch.resize(m_Chunks.size());
+
+	// Squared distance from the center in blocks, at most a few million for any render distance
+	for (size_t i = 0; i < m_Chunks.size(); ++i)
+	{
+		const glm::vec3 d = m_Chunks[i]->m_Coord + HCHUNK_SIZE - position;
+		m_Keys[i] = { (uint32_t)glm::dot(d, d), m_Chunks[i] };
+	}
+
+	// Least significant byte first, a pass where every key has the same byte is skipped
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t counts[256]{};
+		for (const SortKey& key : m_Keys)
+			++counts[(key.distance >> shift) & 0xFF];
+
+		if (counts[(m_Keys.front().distance >> shift) & 0xFF] == m_Keys.size())
+			continue;
+
+		uint32_t offset = 0;
+		for (uint32_t& count : counts)
+		{
+			const uint32_t bucket = count;
+			count = offset;
+			offset += bucket;
+		}
+
+		for (const SortKey& key : m_Keys)
+			m_KeysScratch[counts[(key.distance >> shift) & 0xFF]++] = key;
+
+		m_Keys.swap(m_KeysScratch);
+	}
+
+	for (uint32_t rank = 0; rank < m_Keys.size(); ++rank)
+	{
+		m_Chunks[rank] = m_Keys[rank].chunk;
+		m_Chunks[rank]->m_RenderRank = rank;
+	}
+
+	++m_Stats.Sorts;
+	m_Stats.SortMicros = timer.ElapsedMillis() * 1000.0f;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Chunk.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <utility>
+
+// Blocks the camera moves before the chunks are sorted again
+#define RENDER_LIST_RESORT 4.0f
+
+#define RENDER_RANK_NONE UINT32_MAX // Chunk::m_RenderRank of a chunk not added
+
+struct RenderListStats
+{
+	uint32_t Chunks = 0, Sorts = 0; // Sorts since the start
+	float SortMicros = 0.0f;        // Last sort
+};
+
+// Every meshed chunk, sorted front to back from the camera by a radix sort of their quantized
+// squared distance. The sort runs again only once the camera moved RENDER_LIST_RESORT blocks
+// or chunks were added, in between each chunk keeps its rank (m_RenderRank) and a set of chunks
+// is ordered by placing them at their rank, in linear time.
+// Not thread safe, the world adds chunks and renders on the main thread.
+class RenderList
+{
+public:
+	// A chunk drawn from now on, added once (chunks are never removed)
+	void Add(Chunk* chunk);
+
+	// Sort again if needed
+	void Update(const glm::vec3& position);
+
+	// Order items front to back, or back to front, by the rank of the chunk chunkOf(item) returns
+	template<typename T, typename ChunkOf>
+	void Order(std::vector<T>& items, ChunkOf chunkOf, bool backToFront = false);
+
+	inline const RenderListStats& GetStats() const { return m_Stats; }
+
+private:
+	struct SortKey
+	{
+		uint32_t distance;
+		Chunk* chunk;
+	};
+
+	void Sort(const glm::vec3& position);
+
+private:
+	std::vector<Chunk*> m_Chunks; // By rank
+
+	std::vector<SortKey> m_Keys, m_KeysScratch;
+	std::vector<uint32_t> m_Slots; // Rank to item + 1, 0 for none, cleared after each Order
+
+	glm::vec3 m_SortPosition{ 0.0f };
+	bool m_Dirty = false;
+
+	RenderListStats m_Stats;
+};
+
+template<typename T, typename ChunkOf>
+void RenderList::Order(std::vector<T>& items, ChunkOf chunkOf, bool backToFront)
+{
+	m_Slots.resize(m_Chunks.size(), 0);
+
+	std::vector<T> unranked;
+	for (uint32_t i = 0; i < items.size(); ++i)
+	{
+		const uint32_t rank = chunkOf(items[i])->m_RenderRank;
+		if (rank < m_Slots.size())
+			m_Slots[rank] = i + 1;
+		else
+			unranked.push_back(std::move(items[i]));
+	}
+
+	std::vector<T> ordered;
+	ordered.reserve(items.size());
+
+	const size_t ranks = m_Slots.size();
+	for (size_t r = 0; r < ranks; ++r)
+	{
+		uint32_t& slot = m_Slots[backToFront ? ranks - 1 - r : r];
+		if (slot == 0)
+			continue;
+
+		ordered.push_back(std::move(items[slot - 1]));
+		slot = 0;
+	}
+
+	// Not in the list, drawn last
+	for (T& item : unranked)
+		ordered.push_back(std::move(item));
+
+	items = std::move(ordered);
+}
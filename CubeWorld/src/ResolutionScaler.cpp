@@ -0,0 +1,98 @@
+#include "ResolutionScaler.h"
+
+#include "Core.h"
+
+#include <cmath>
+
+ResolutionScaler::ResolutionScaler()
+{
+	GLCall(glGenQueries(RESOLUTION_TIMERS * 2, &m_Queries[0][0]));
+}
+
+ResolutionScaler::~ResolutionScaler()
+{
+	glDeleteQueries(RESOLUTION_TIMERS * 2, &m_Queries[0][0]);
+}
+
+void ResolutionScaler::BeginFrame()
+{
+	const uint32_t slot = m_Frame % RESOLUTION_TIMERS;
+
+	// The frame RESOLUTION_TIMERS ago, skipped if it is not done yet or was drawn at another scale
+	if (m_Frame >= RESOLUTION_TIMERS && m_QueryGenerations[slot] == m_Generation)
+	{
+		GLuint available = GL_FALSE;
+		GLCall(glGetQueryObjectuiv(m_Queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available));
+		if (available)
+		{
+			GLuint64 begin = 0, end = 0;
+			GLCall(glGetQueryObjectui64v(m_Queries[slot][0], GL_QUERY_RESULT, &begin));
+			GLCall(glGetQueryObjectui64v(m_Queries[slot][1], GL_QUERY_RESULT, &end));
+
+			m_MillisSum += (end - begin) * 1e-6f;
+			++m_Samples;
+
+			m_Stats.GpuMillis = m_MillisSum / m_Samples;
+		}
+	}
+
+	m_QueryGenerations[slot] = m_Generation;
+	GLCall(glQueryCounter(m_Queries[slot][0], GL_TIMESTAMP));
+}
+
+void ResolutionScaler::EndFrame()
+{
+	GLCall(glQueryCounter(m_Queries[m_Frame % RESOLUTION_TIMERS][1], GL_TIMESTAMP));
+	++m_Frame;
+}
+
+float ResolutionScaler::Update(float scale, float minScale, float maxScale, float targetMillis)
+{
+	// Out of bounds changed by hand, moved in at once
+	if (scale < minScale || scale > maxScale)
+	{
+		Reset();
+		++m_Stats.Changes;
+		return scale < minScale ? minScale : maxScale;
+	}
+
+	if (m_Samples < RESOLUTION_SAMPLES)
+		return scale;
+
+	const float millis = m_MillisSum / m_Samples;
+
+	// The next frames are averaged alone, the ones in flight still count
+	m_MillisSum = 0.0f;
+	m_Samples = 0;
+
+	float next = scale;
+	if (millis > targetMillis)
+	{
+		// The largest step predicted to fit, at least one under
+		next = std::floor(scale * std::sqrt(targetMillis / millis) / RESOLUTION_STEP) * RESOLUTION_STEP;
+		next = next < scale - RESOLUTION_STEP ? next : scale - RESOLUTION_STEP;
+	}
+	else
+	{
+		const float up = (scale + RESOLUTION_STEP) / scale;
+		if (millis * up * up < targetMillis * RESOLUTION_HEADROOM)
+			next = scale + RESOLUTION_STEP;
+	}
+
+	next = next < minScale ? minScale : next > maxScale ? maxScale : next;
+	if (next != scale)
+	{
+		Reset();
+		++m_Stats.Changes;
+	}
+
+	return next;
+}
+
+void ResolutionScaler::Reset()
+{
+	++m_Generation;
+
+	m_MillisSum = 0.0f;
+	m_Samples = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#define RESOLUTION_STEP 0.25f    // The scale moves by multiples of it, each one reallocates the framebuffer
+#define RESOLUTION_TIMERS 4      // Frames of GPU timestamps in flight
+#define RESOLUTION_SAMPLES 20    // Frames measured at a scale before it changes again
+#define RESOLUTION_HEADROOM 0.8f // Of the target, the time predicted one step up has to stay under
+
+struct ResolutionStats
+{
+	float GpuMillis = 0.0f; // Average of the frames at the current scale
+	uint32_t Changes = 0;   // Of the scale since the start, each one reallocates the framebuffer
+};
+
+// Picks the scale of the offscreen framebuffer from the GPU time of the frames, measured with
+// timestamp queries read back frames later. The time is taken to grow with the pixels (the scale
+// squared): above the target the scale drops straight to the step predicted to fit, under it the
+// scale goes up one step at a time once that step is predicted to fit with some headroom.
+class ResolutionScaler
+{
+public:
+	ResolutionScaler();
+	~ResolutionScaler();
+
+	// Around everything the frame draws on the GPU
+	void BeginFrame();
+	void EndFrame();
+
+	// The scale to draw the next frame at, scale itself until enough frames were measured at it
+	float Update(float scale, float minScale, float maxScale, float targetMillis);
+
+	// The frames measured so far are not comparable anymore (the window was resized)
+	void Reset();
+
+	inline const ResolutionStats& GetStats() const { return m_Stats; }
+
+private:
+	uint32_t m_Queries[RESOLUTION_TIMERS][2]{}; // Begin and end timestamps
+	uint32_t m_QueryGenerations[RESOLUTION_TIMERS]{};
+
+	uint32_t m_Frame = 0;
+	uint32_t m_Generation = 0; // Of the frames at the current scale and size
+
+	float m_MillisSum = 0.0f;
+	uint32_t m_Samples = 0;
+
+	ResolutionStats m_Stats;
+};
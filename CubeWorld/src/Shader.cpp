@@ -2,8 +2,27 @@
 
 #include "Core.h"
 
+#include "utils/Timer.h"
+
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#define SHADER_CACHE_MAGIC 0x48534243 // "CBSH"
+#define SHADER_CACHE_VERSION 1
+
+struct ShaderCacheHeader
+{
+    uint32_t magic = SHADER_CACHE_MAGIC;
+    uint32_t version = SHADER_CACHE_VERSION;
+    uint64_t key = 0;
+    uint32_t format = 0, length = 0;
+};
+
+ShaderCacheStats Shader::m_CacheStats;
 
 Shader::Shader()
     : m_RendererID(0)
@@ -13,8 +32,26 @@ Shader::Shader()
 Shader::Shader(const std::string& filepath)
     : m_FilePath(filepath), m_RendererID(0)
 {
+    Timer timer;
+
     ShaderProgramSource source = ParseShader(filepath);
-    m_RendererID = CreateShader(source.VertexSource, source.FragmentSource);
+
+    const uint64_t key = CacheKey(source);
+    m_RendererID = LoadBinary(filepath + ".bin", key);
+
+    if (m_RendererID)
+    {
+        ++m_CacheStats.Hits;
+    }
+    else
+    {
+        m_RendererID = CreateShader(source.VertexSource, source.FragmentSource);
+        SaveBinary(filepath + ".bin", key);
+
+        ++m_CacheStats.Misses;
+    }
+
+    m_CacheStats.Millis += timer.ElapsedMillis();
 }
 
 Shader::~Shader()
@@ -84,6 +121,9 @@ unsigned int Shader::CreateShader(const std::string& vertexShader, const std::st
 
     GLCall(glAttachShader(program, vs));
     GLCall(glAttachShader(program, fs));
+
+    // Kept by the driver for glGetProgramBinary
+    GLCall(glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
     GLCall(glLinkProgram(program));
 
     int result;
@@ -107,6 +147,107 @@ unsigned int Shader::CreateShader(const std::string& vertexShader, const std::st
     return program;
 }
 
+uint64_t Shader::CacheKey(const ShaderProgramSource& source)
+{
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+    const auto mix = [&hash](const char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ (uint8_t)data[i]) * 0x100000001B3ull;
+
+        // Apart from the next string
+        hash = (hash ^ 0xFF) * 0x100000001B3ull;
+    };
+
+    mix(source.VertexSource.data(), source.VertexSource.size());
+    mix(source.FragmentSource.data(), source.FragmentSource.size());
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const char* driver = (const char*)glGetString(name);
+        if (driver)
+            mix(driver, strlen(driver));
+    }
+
+    return hash;
+}
+
+unsigned int Shader::LoadBinary(const std::string& path, uint64_t key)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+        return 0;
+
+    ShaderCacheHeader header;
+    if (!stream.read((char*)&header, sizeof(ShaderCacheHeader)) || header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION || header.key != key)
+        return 0;
+
+    // A corrupt length never allocates more than the file holds
+    std::error_code error;
+    const uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error || header.length == 0 || header.length > fileSize - sizeof(ShaderCacheHeader))
+        return 0;
+
+    std::vector<char> binary(header.length);
+    if (!stream.read(binary.data(), header.length))
+        return 0;
+
+    // A format the driver does not take anymore is an error, not a failed link
+    int formatsCount = 0;
+    GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatsCount));
+
+    std::vector<int> formats(formatsCount);
+    if (formatsCount > 0)
+    {
+        GLCall(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data()));
+    }
+
+    if (std::find(formats.begin(), formats.end(), (int)header.format) == formats.end())
+        return 0;
+
+    GLCall(unsigned int program = glCreateProgram());
+    GLCall(glProgramBinary(program, header.format, binary.data(), header.length));
+
+    // Rejected by the driver (an update with the same strings), compiled again
+    int result;
+    GLCall(glGetProgramiv(program, GL_LINK_STATUS, &result));
+    if (result == GL_FALSE)
+    {
+        std::cout << "Cached binary of " << m_FilePath << " rejected, compiling" << std::endl;
+        GLCall(glDeleteProgram(program));
+        return 0;
+    }
+
+    return program;
+}
+
+void Shader::SaveBinary(const std::string& path, uint64_t key) const
+{
+    int formatsCount = 0;
+    GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatsCount));
+    if (m_RendererID == 0 || formatsCount == 0)
+        return;
+
+    int length = 0;
+    GLCall(glGetProgramiv(m_RendererID, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLCall(glGetProgramBinary(m_RendererID, length, &length, &format, binary.data()));
+
+    ShaderCacheHeader header;
+    header.key = key;
+    header.format = format;
+    header.length = (uint32_t)length;
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream || !stream.write((const char*)&header, sizeof(ShaderCacheHeader)) || !stream.write(binary.data(), length))
+        std::cout << "Failed to cache the binary of " << m_FilePath << std::endl;
+}
+
 void Shader::Bind() const
 {
     GLCall(glUseProgram(m_RendererID));
@@ -182,6 +323,26 @@ void Shader::SetUniformMat4f(const std::string& name, const glm::mat4& matrix)
     GLCall(glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]));
 }
 
+void Shader::SetUniform1i(int location, int value)
+{
+    GLCall(glUniform1i(location, value));
+}
+
+void Shader::SetUniform2f(int location, float v0, float v1)
+{
+    GLCall(glUniform2f(location, v0, v1));
+}
+
+void Shader::SetUniform3f(int location, float v0, float v1, float v2)
+{
+    GLCall(glUniform3f(location, v0, v1, v2));
+}
+
+void Shader::SetUniformMat4f(int location, const glm::mat4& matrix)
+{
+    GLCall(glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]));
+}
+
 int Shader::GetUniformLocation(const std::string& name)
 {
     if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
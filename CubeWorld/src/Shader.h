@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 
 #include "glm/glm.hpp"
 
@@ -11,6 +12,13 @@ struct ShaderProgramSource
 	std::string FragmentSource;
 };
 
+// Of every shader made since the start
+struct ShaderCacheStats
+{
+	uint32_t Hits = 0, Misses = 0; // Linked from the binary next to the source, compiled from source
+	float Millis = 0.0f;           // Parsing, loading and compiling
+};
+
 class Shader
 {
 protected:
@@ -19,8 +27,12 @@ protected:
 	// Caching for uniforms
 	std::unordered_map<std::string, int> m_UniformLocationCache;
 
+	static ShaderCacheStats m_CacheStats;
+
 public:
 	Shader();
+	// The program binary cached next to the file (filepath.bin) if it was made from the same source by the same driver,
+	// else compiled from source and cached
 	Shader(const std::string& filepath);
 	~Shader();
 
@@ -42,10 +54,25 @@ public:
 	void SetUniformMat3f(const std::string& name, const glm::mat3& matrix);
 	void SetUniformMat4f(const std::string& name, const glm::mat4& matrix);
 
+	// Looked up once, the setters by location below do not hash the name on the render path
+	int GetUniformLocation(const std::string& name);
+
+	void SetUniform1i(int location, int value);
+	void SetUniform2f(int location, float v0, float v1);
+	void SetUniform3f(int location, float v0, float v1, float v2);
+	void SetUniformMat4f(int location, const glm::mat4& matrix);
+
+	static inline const ShaderCacheStats& GetCacheStats() { return m_CacheStats; }
+
 private:
 	ShaderProgramSource ParseShader(const std::string& filepath);
 	unsigned int CompileShader(unsigned int type, const std::string& source);
 	unsigned int CreateShader(const std::string& vertexShader, const std::string& fragmentShader);
 
-	int GetUniformLocation(const std::string& name);
+	// The source and the driver strings, a binary is only valid for the same ones
+	static uint64_t CacheKey(const ShaderProgramSource& source);
+
+	// The program linked from the cached binary, 0 if missing, outdated or rejected by the driver
+	unsigned int LoadBinary(const std::string& path, uint64_t key);
+	void SaveBinary(const std::string& path, uint64_t key) const;
 };
\ No newline at end of file
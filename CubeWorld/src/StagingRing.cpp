@@ -0,0 +1,106 @@
+#include "StagingRing.h"
+
+StagingRing::StagingRing()
+{
+	// Core from 4.4, the context asks for 4.3
+	if (!GLEW_VERSION_4_4 && !GLEW_ARB_buffer_storage)
+	{
+		std::cout << "No persistent mapping, the meshes are written with glBufferData" << std::endl;
+		return;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	GLCall(glGenBuffers(1, &m_Buffer));
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, m_Buffer));
+	GLCall(glBufferStorage(GL_COPY_READ_BUFFER, STAGING_RING_BYTES, nullptr, flags));
+
+	// Coherent, the writes are seen by the copies issued after them without a flush
+	m_Data = (uint8_t*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, STAGING_RING_BYTES, flags);
+	GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+
+	m_Stats.Mapped = m_Data != nullptr;
+}
+
+StagingRing::~StagingRing()
+{
+	for (const Region& region : m_Regions)
+	{
+		GLCall(glDeleteSync(region.fence));
+	}
+
+	if (m_Buffer == 0)
+		return;
+
+	if (m_Data)
+	{
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, m_Buffer));
+		GLCall(glUnmapBuffer(GL_COPY_READ_BUFFER));
+		GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+	}
+
+	GLCall(glDeleteBuffers(1, &m_Buffer));
+}
+
+uint8_t* StagingRing::Reserve(size_t size, size_t& offset)
+{
+	size = (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	if (!m_Data || size > STAGING_RING_BYTES)
+		return nullptr;
+
+	while (true)
+	{
+		// The space of the finished copies is free again
+		while (!m_Regions.empty() && glClientWaitSync(m_Regions.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+		{
+			GLCall(glDeleteSync(m_Regions.front().fence));
+			m_Regions.pop_front();
+		}
+
+		if (m_Regions.empty())
+		{
+			if (m_Head + size > STAGING_RING_BYTES)
+				m_Head = 0;
+			break;
+		}
+
+		// In use from tail to head, around the end if head is before it (full if they are equal)
+		const size_t tail = m_Regions.front().begin;
+		if (m_Head > tail)
+		{
+			if (m_Head + size <= STAGING_RING_BYTES)
+				break;
+
+			if (size <= tail)
+			{
+				m_Head = 0;
+				break;
+			}
+		}
+		else if (m_Head < tail && m_Head + size <= tail)
+		{
+			break;
+		}
+
+		// Full, the oldest copies are waited for
+		++m_Stats.Waits;
+		glClientWaitSync(m_Regions.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	}
+
+	offset = m_Head;
+
+	m_ReservedBegin = m_Head;
+	m_ReservedEnd = m_Head += size;
+
+	m_Stats.Bytes += size;
+	return m_Data + offset;
+}
+
+void StagingRing::Fence()
+{
+	if (m_ReservedBegin == m_ReservedEnd)
+		return;
+
+	m_Regions.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_ReservedBegin, m_ReservedEnd });
+	m_ReservedBegin = m_ReservedEnd;
+}
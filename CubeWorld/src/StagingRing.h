@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Core.h"
+
+#include <cstdint>
+#include <deque>
+
+#define STAGING_RING_BYTES (32 * 1024 * 1024) // A mesh bigger than it is written without it
+#define STAGING_ALIGNMENT 64                  // Of each reservation, a cache line
+
+struct StagingRingStats
+{
+	uint64_t Bytes = 0;    // Written through the ring since the start
+	uint32_t Waits = 0;    // Reservations that waited for the GPU to be done with the space
+	bool Mapped = false;   // Else there is no persistent mapping (no GL 4.4 or ARB_buffer_storage)
+};
+
+// A buffer mapped once, persistent and coherent, written in place on the CPU and copied from on the GPU
+// (glCopyBufferSubData) to the final buffers. The space of the copies is taken again only once the fence
+// after them is signaled. Used by one thread, with the context it was made in.
+class StagingRing
+{
+public:
+	StagingRing();
+	~StagingRing();
+
+	inline bool IsMapped() const { return m_Data != nullptr; }
+
+	inline uint32_t GetBuffer() const { return m_Buffer; }
+
+	// Space for size bytes at offset in GetBuffer(), waits for the copies out of it if the ring is full. nullptr
+	// if it is not mapped or size does not fit. One reservation for each Fence
+	uint8_t* Reserve(size_t size, size_t& offset);
+
+	// After the copies out of the last reservation
+	void Fence();
+
+	inline const StagingRingStats& GetStats() const { return m_Stats; }
+
+private:
+	struct Region
+	{
+		GLsync fence;
+		size_t begin, end;
+	};
+
+	uint32_t m_Buffer = 0;
+	uint8_t* m_Data = nullptr;
+
+	size_t m_Head = 0;
+	size_t m_ReservedBegin = 0, m_ReservedEnd = 0; // Not fenced yet, empty if equal
+
+	std::deque<Region> m_Regions; // In use by the GPU, oldest first
+
+	StagingRingStats m_Stats;
+};
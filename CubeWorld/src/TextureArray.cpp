@@ -0,0 +1,89 @@
+#include "TextureArray.h"
+
+#include "stb_image/stb_image.h"
+
+#include <vector>
+#include <cmath>
+
+TextureArray::TextureArray(const std::string& path, int tileSize, GLint filterMin, GLint filterMag, bool anisotropic, bool mipmap)
+	: m_RendererID(0), m_FilePath(path), m_TileSize(tileSize), m_Columns(0), m_Rows(0)
+{
+	int width = 0, height = 0, bpp = 0;
+
+	// The rows from the bottom, as the uv of the tiles
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char* atlas = stbi_load(path.c_str(), &width, &height, &bpp, 4);
+
+	m_Columns = width / tileSize;
+	m_Rows = height / tileSize;
+
+	// Tile by tile, each one a contiguous layer
+	std::vector<unsigned char> layers((size_t)GetLayers() * tileSize * tileSize * 4);
+	for (int row = 0; row < m_Rows; ++row)
+		for (int column = 0; column < m_Columns; ++column)
+		{
+			unsigned char* layer = &layers[(size_t)(row * m_Columns + column) * tileSize * tileSize * 4];
+
+			for (int y = 0; y < tileSize; ++y)
+				memcpy(&layer[(size_t)y * tileSize * 4], &atlas[((size_t)(row * tileSize + y) * width + (size_t)column * tileSize) * 4], (size_t)tileSize * 4);
+		}
+
+	if (atlas)
+		stbi_image_free(atlas);
+
+	GLCall(glGenTextures(1, &m_RendererID));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_RendererID));
+
+	// Greedy quads span many blocks, the tile repeats across them
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filterMin));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filterMag));
+
+	if (anisotropic)
+	{
+		float amount = 0;
+		GLCall(glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &amount));
+		GLCall(glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY, amount));
+	}
+
+	// Down to one texel per tile
+	const int levels = mipmap ? (int)std::log2(tileSize) + 1 : 1;
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0));
+	GLCall(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1));
+
+	if (mipmap)
+	{
+		GLCall(glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_LOD_BIAS, -0.4f));
+	}
+
+	GLCall(glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, tileSize, tileSize, GetLayers()));
+	GLCall(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, tileSize, tileSize, GetLayers(), GL_RGBA, GL_UNSIGNED_BYTE, layers.data()));
+
+	if (mipmap)
+	{
+		GLCall(glGenerateMipmap(GL_TEXTURE_2D_ARRAY));
+	}
+}
+
+TextureArray::~TextureArray()
+{
+	GLCall(glDeleteTextures(1, &m_RendererID));
+}
+
+void TextureArray::Bind(unsigned int slot) const
+{
+	GLCall(glActiveTexture(GL_TEXTURE0 + slot));
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, m_RendererID));
+}
+
+void TextureArray::Unbind() const
+{
+	GLCall(glBindTexture(GL_TEXTURE_2D_ARRAY, 0));
+}
+
+uint32_t TextureArray::GetLayer(const glm::vec2& uv) const
+{
+	const int column = (int)std::round(uv.x * m_Columns), row = (int)std::round(uv.y * m_Rows);
+	return (uint32_t)(row * m_Columns + column);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Core.h"
+
+#include <glm/glm.hpp>
+
+// An atlas of square tiles loaded as a GL_TEXTURE_2D_ARRAY, a layer for each tile. The tile of uv (column, row
+// from the bottom) times the step is the layer row * columns + column. A tile repeats and has mip levels of its
+// own, its neighbors never bleed into it.
+class TextureArray
+{
+private:
+	unsigned int m_RendererID;
+	std::string m_FilePath;
+	int m_TileSize, m_Columns, m_Rows;
+
+public:
+	TextureArray(const std::string& path, int tileSize, GLint filterMin, GLint filterMag, bool anisotropic = true, bool mipmap = false);
+	~TextureArray();
+
+	void Bind(unsigned int slot = 0) const;
+	void Unbind() const;
+
+	// The layer of the tile at uv in the atlas
+	uint32_t GetLayer(const glm::vec2& uv) const;
+
+	// Of the atlas, the uv of one tile
+	inline glm::vec2 GetStep() const { return { 1.0f / m_Columns, 1.0f / m_Rows }; }
+
+	inline int GetLayers() const { return m_Columns * m_Rows; }
+};
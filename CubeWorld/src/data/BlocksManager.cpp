@@ -1,35 +1,30 @@
 #include "BlocksManager.h"
 
 #include "Core.h"
+#include "TextureArray.h"
 
 std::vector<Block*> BlocksManager::m_Blocks{};
 std::unordered_map<std::string, uint32_t> BlocksManager::m_NamedBlocks{};
 
 uint32_t BlocksManager::m_UVOffsets = 0;
 
-UniformBlock* BlocksManager::m_UniformBlocks = nullptr;
-
-uint32_t BlocksManager::m_UBO = 0;
+uint32_t BlocksManager::m_LayersSSBO = 0;
 
 
 void BlocksManager::Init()
 {
-	m_UniformBlocks = (UniformBlock*)calloc(4096, sizeof(UniformBlock));;
-
-	GLCall(glGenBuffers(1, &m_UBO));
-	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_UBO));
-	GLCall(glBufferData(GL_UNIFORM_BUFFER, 4096 * sizeof(UniformBlock), nullptr, GL_DYNAMIC_DRAW));
+	GLCall(glGenBuffers(1, &m_LayersSSBO));
 }
 
 void BlocksManager::Dispose()
 {
-	if (m_UBO)
-		GLCall(glDeleteBuffers(1, &m_UBO));
+	if (m_LayersSSBO)
+	{
+		GLCall(glDeleteBuffers(1, &m_LayersSSBO));
+	}
 
 	for (Block* block : m_Blocks)
 		free(block);
-
-	free(m_UniformBlocks);
 }
 
 uint32_t BlocksManager::RegisterBlock(Block* block)
@@ -42,23 +37,25 @@ uint32_t BlocksManager::RegisterBlock(Block* block)
 	return id;
 }
 
-void BlocksManager::UploadBlocks()
+void BlocksManager::UploadBlocks(const TextureArray& atlas)
 {
-	uint32_t i = 0;
+	// Resolved once here, the mesher and the vertices only know the block and the face
+	std::vector<uint32_t> layers(m_Blocks.size() * 6);
 	for (const Block* block : m_Blocks)
-	{
-		for (const glm::vec2& uv : block->m_UV)
+		for (int side = 0; side < 6; ++side)
 		{
-			m_UniformBlocks[i] = { { i, 0 }, uv };
-			++i;
+			uint32_t uv;
+			bool uvFlip;
+			block->GetSideUV(Block::Side::Front, (Block::Side)side, &uv, &uvFlip);
+
+			layers[block->m_ID * 6 + side] = atlas.GetLayer(block->m_UV[uv - block->m_UVOffset]);
 		}
-	}
 
-	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_UBO));
-	GLCall(glBufferSubData(GL_UNIFORM_BUFFER, 0, i * sizeof(UniformBlock), m_UniformBlocks));
+	GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_LayersSSBO));
+	GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, layers.size() * sizeof(uint32_t), layers.data(), GL_STATIC_DRAW));
 }
 
 void BlocksManager::Bind(uint32_t index)
 {
-	GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, index, m_UBO));
+	GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, m_LayersSSBO));
 }
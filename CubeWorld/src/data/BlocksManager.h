@@ -6,11 +6,7 @@
 #include <memory>
 #include <unordered_map>
 
-struct UniformBlock
-{
-	glm::uvec2 offset; // 1 uint offset + 1 padding
-	glm::vec2 uv;
-};
+class TextureArray;
 
 class BlocksManager
 {
@@ -20,9 +16,7 @@ public:
 
 	static uint32_t m_UVOffsets;
 
-	static UniformBlock* m_UniformBlocks;
-
-	static uint32_t m_UBO;
+	static uint32_t m_LayersSSBO; // Atlas layer of every side of every block (id * 6 + side)
 
 	static glm::vec2 m_Step;
 
@@ -32,9 +26,10 @@ public:
 
 	static uint32_t RegisterBlock(Block* block);
 
-	static void UploadBlocks();
+	static void UploadBlocks(const TextureArray& atlas);
 
-	static void Bind(uint32_t index = 0);
+	// Shader storage binding of the layers
+	static void Bind(uint32_t index);
 
 	static inline Block* GetBlock(uint32_t id)
 	{
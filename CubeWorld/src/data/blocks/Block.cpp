@@ -11,3 +11,15 @@ Block::Block(const std::string& name, std::vector<glm::vec2> uvs)
 Block::~Block()
 {
 }
+
+void Block::GetSideUV(Block::Side orientation, Block::Side side, uint32_t* id, bool* uvFlip) const
+{
+	*uvFlip = false;
+
+	if (m_UV.size() >= 6)
+		*id = m_UVOffset + side;
+	else if (m_UV.size() == 3)
+		*id = m_UVOffset + (side == Side::Up ? 0 : side == Side::Down ? 2 : 1);
+	else
+		*id = m_UVOffset;
+}
@@ -12,6 +12,7 @@ class Block
 public:
 	uint32_t m_ID = 0, m_UVOffset = 0;
 	bool m_IsTransparent = false, m_IsTranslucent = false, m_IsLiquid = false /* For Raycasting */;
+	uint8_t m_LightEmission = 0, m_LightOpacity = 0 /* Only for transparent blocks, opaque ones stop the light */;
 	std::string m_Name;
 	std::vector<glm::vec2> m_UV;
 
@@ -26,7 +27,8 @@ public:
 
 	virtual bool ShouldRenderSide(Block::Side side, const Block* neighbor) const { return neighbor->m_IsTransparent && neighbor->m_ID != m_ID; }
 
-	virtual void GetSideUV(Block::Side orientation, Block::Side side, uint32_t* id, bool* uvFlip) const { *id = m_UVOffset; *uvFlip = false; }
+	// The uvs are one for every side, top, sides and bottom, or one for each side (by Side)
+	virtual void GetSideUV(Block::Side orientation, Block::Side side, uint32_t* id, bool* uvFlip) const;
 
 	virtual bool HasCustomMesh() const { return false; }
 	virtual void RenderCustomMesh(std::vector<uint32_t>& data, std::vector<uint32_t>& transparent, int x, int y, int z) const {}
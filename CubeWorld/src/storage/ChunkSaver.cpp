@@ -0,0 +1,179 @@
+#include "ChunkSaver.h"
+
+#include <chrono>
+
+ChunkSaver::ChunkSaver(WorldStorage* storage, float flushInterval)
+	: m_Storage(storage), m_FlushInterval(flushInterval)
+{
+	m_Thread = std::thread([this]() { Run(); });
+}
+
+ChunkSaver::~ChunkSaver()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stop = true;
+	}
+
+	m_Condition.notify_one();
+	m_Thread.join();
+}
+
+void ChunkSaver::MarkDirty(Chunk* chunk)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_Dirty[chunk->m_Coord] = chunk;
+}
+
+bool ChunkSaver::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	const uint64_t failed = m_Stats.FailedBatches;
+
+	m_FlushRequested = true;
+	m_Condition.notify_one();
+
+	m_SavedCondition.wait(lock, [this, failed]() { return (m_Dirty.empty() && m_Saving.empty()) || m_Stats.FailedBatches != failed; });
+	return m_Stats.FailedBatches == failed;
+}
+
+bool ChunkSaver::IsSavePending(const glm::vec3& coord)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	return m_Dirty.contains(coord) || m_Saving.contains(coord);
+}
+
+bool ChunkSaver::WaitForSave(const glm::vec3& coord)
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+
+	const uint64_t failed = m_Stats.FailedBatches;
+
+	if (m_Dirty.contains(coord))
+	{
+		m_FlushRequested = true;
+		m_Condition.notify_one();
+	}
+
+	m_SavedCondition.wait(lock, [this, &coord, failed]()
+	{
+		return (!m_Dirty.contains(coord) && !m_Saving.contains(coord)) || m_Stats.FailedBatches != failed;
+	});
+	return !m_Dirty.contains(coord) && !m_Saving.contains(coord);
+}
+
+SaverStats ChunkSaver::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	SaverStats stats = m_Stats;
+	stats.Pending = m_Dirty.size() + m_Saving.size();
+	return stats;
+}
+
+void ChunkSaver::Run()
+{
+	std::unordered_map<glm::vec3, Chunk*> batch;
+
+	std::unique_lock<std::mutex> lock(m_Lock);
+	while (true)
+	{
+		m_Condition.wait_for(lock, std::chrono::duration<float>(m_FlushInterval.load()), [this]() { return m_Stop || m_FlushRequested; });
+
+		m_FlushRequested = false;
+
+		if (m_Dirty.empty())
+		{
+			m_SavedCondition.notify_all();
+
+			if (m_Stop)
+				return;
+
+			continue;
+		}
+
+		batch.swap(m_Dirty);
+		for (const auto& [coord, _] : batch)
+			m_Saving.insert(coord);
+
+		lock.unlock();
+
+		const bool saved = SaveBatch(batch);
+
+		lock.lock();
+
+		// Dirty again, never lost. An edit since the snapshot already put the chunk back
+		if (!saved)
+		{
+			for (const auto& [coord, chunk] : batch)
+				m_Dirty.try_emplace(coord, chunk);
+
+			++m_Stats.FailedBatches;
+		}
+
+		batch.clear();
+		m_Saving.clear();
+		m_SavedCondition.notify_all();
+
+		// The journal keeps the edits of a failed batch for the next start
+		if (!saved && m_Stop)
+			return;
+	}
+}
+
+bool ChunkSaver::SaveBatch(const std::unordered_map<glm::vec3, Chunk*>& batch)
+{
+	std::vector<ChunkSnapshot> snapshots;
+	snapshots.reserve(batch.size());
+
+	std::vector<ChunkBlock> data(CHUNK_SIZEQ);
+
+	bool compressed = true;
+
+	uint64_t bytes = 0;
+	for (const auto& [coord, chunk] : batch)
+	{
+		// The chunk lock is held only for the copy, compression runs unlocked
+		if (!chunk->Snapshot(data.data()))
+			continue;
+
+		ChunkSnapshot& snapshot = snapshots.emplace_back();
+		snapshot.coord = coord;
+
+		if (!RegionFile::Compress(data.data(), CHUNK_SIZEQ * sizeof(ChunkBlock), snapshot.compressed))
+		{
+			chunk->RestoreModified();
+			snapshots.pop_back();
+
+			compressed = false;
+			continue;
+		}
+
+		bytes += snapshot.compressed.size();
+	}
+
+	if (snapshots.empty())
+		return compressed;
+
+	// Write-ahead: the edits in the snapshots reach the journal before the region files
+	if (m_Journal)
+		m_Journal->Commit();
+
+	if (!m_Storage->SaveChunks(snapshots))
+	{
+		std::cout << "Failed to save " << snapshots.size() << " chunks, they are saved again on the next flush!" << std::endl;
+
+		for (const ChunkSnapshot& snapshot : snapshots)
+			batch.at(snapshot.coord)->RestoreModified();
+
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Lock);
+	m_Stats.ChunksSaved += snapshots.size();
+	m_Stats.BytesWritten += bytes;
+	++m_Stats.Batches;
+
+	return compressed;
+}
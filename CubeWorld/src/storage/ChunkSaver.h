@@ -0,0 +1,64 @@
+#pragma once
+
+#include "WorldStorage.h"
+#include "WorldJournal.h"
+
+#include <thread>
+#include <condition_variable>
+#include <unordered_set>
+
+struct SaverStats
+{
+	uint64_t ChunksSaved = 0, BytesWritten = 0, Batches = 0;
+	uint64_t FailedBatches = 0; // Kept dirty and saved again on the next flush
+	size_t Pending = 0;
+};
+
+// Write-behind saving of modified chunks on a background thread
+class ChunkSaver
+{
+public:
+	ChunkSaver(WorldStorage* storage, float flushInterval);
+	~ChunkSaver();
+
+	// Never blocks on disk, edits to the same chunk before the next flush are coalesced
+	void MarkDirty(Chunk* chunk);
+
+	// Write every dirty chunk now and wait for it, false if a batch failed meanwhile (its chunks are still dirty)
+	bool Flush();
+
+	bool IsSavePending(const glm::vec3& coord);
+
+	// Must be called before a chunk is freed, false if its batch failed (the chunk is still dirty)
+	bool WaitForSave(const glm::vec3& coord);
+
+	SaverStats GetStats();
+
+	inline void SetFlushInterval(float seconds) { m_FlushInterval = seconds; }
+
+	inline void SetJournal(WorldJournal* journal) { m_Journal = journal; }
+
+private:
+	void Run();
+
+	// False if nothing of the batch reached the disk, the chunks are modified again
+	bool SaveBatch(const std::unordered_map<glm::vec3, Chunk*>& batch);
+
+private:
+	WorldStorage* m_Storage;
+	WorldJournal* m_Journal = nullptr;
+
+	std::atomic<float> m_FlushInterval;
+
+	std::unordered_map<glm::vec3, Chunk*> m_Dirty;
+	std::unordered_set<glm::vec3> m_Saving;
+
+	std::mutex m_Lock;
+	std::condition_variable m_Condition, m_SavedCondition;
+
+	bool m_Stop = false, m_FlushRequested = false;
+
+	SaverStats m_Stats;
+
+	std::thread m_Thread;
+};
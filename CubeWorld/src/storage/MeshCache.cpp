@@ -0,0 +1,196 @@
+#include "MeshCache.h"
+
+#include <zlib.h>
+
+#include <cstring>
+
+struct MeshCacheHeader
+{
+	uint32_t version = MESH_CACHE_VERSION;
+	uint32_t counts[4]{ 0, 0, 0, 0 }; // vertices, indices, tvertices, tindices
+	uint64_t hash = 0;
+};
+
+MeshCache::~MeshCache()
+{
+	Flush();
+}
+
+bool MeshCache::Load(const glm::vec3& coord, uint64_t hash, Mesh& mesh)
+{
+	std::vector<uint8_t> payload;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+
+		if (m_Invalidated.contains(coord))
+		{
+			++m_Misses;
+			return false;
+		}
+
+		auto it = m_Pending.find(coord);
+		if (it != m_Pending.end())
+			payload = it->second;
+	}
+
+	if (payload.empty())
+	{
+		uint32_t index;
+		RegionFile* region = GetRegion(coord, false, &index);
+		if (region == nullptr || !region->ReadPayload(index, payload))
+		{
+			++m_Misses;
+			return false;
+		}
+	}
+
+	if (!Decode(payload, hash, mesh))
+	{
+		mesh = Mesh{};
+
+		++m_Misses;
+		return false;
+	}
+
+	++m_Hits;
+	return true;
+}
+
+void MeshCache::Store(const glm::vec3& coord, uint64_t hash, const Mesh& mesh)
+{
+	MeshCacheHeader header;
+	header.hash = hash;
+	header.counts[0] = (uint32_t)mesh.vertices.size();
+	header.counts[1] = (uint32_t)mesh.indices.size();
+	header.counts[2] = (uint32_t)mesh.tvertices.size();
+	header.counts[3] = (uint32_t)mesh.tindices.size();
+
+	std::vector<uint32_t> body;
+	body.reserve((size_t)header.counts[0] + header.counts[1] + header.counts[2] + header.counts[3]);
+	body.insert(body.end(), mesh.vertices.begin(),  mesh.vertices.end());
+	body.insert(body.end(), mesh.indices.begin(),   mesh.indices.end());
+	body.insert(body.end(), mesh.tvertices.begin(), mesh.tvertices.end());
+	body.insert(body.end(), mesh.tindices.begin(),  mesh.tindices.end());
+
+	std::vector<uint8_t> compressed;
+	if (!RegionFile::Compress(body.data(), (uint32_t)(body.size() * sizeof(uint32_t)), compressed))
+		return;
+
+	// Header uncompressed in front, a stale entry is rejected without inflating it
+	std::vector<uint8_t> payload(sizeof(MeshCacheHeader) + compressed.size());
+	memcpy(payload.data(), &header, sizeof(MeshCacheHeader));
+	memcpy(payload.data() + sizeof(MeshCacheHeader), compressed.data(), compressed.size());
+
+	std::unordered_map<glm::vec3, std::vector<uint8_t>> batch;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+
+		m_Invalidated.erase(coord);
+		m_Pending[coord] = std::move(payload);
+
+		if (m_Pending.size() < MESH_CACHE_BATCH)
+			return;
+
+		batch.swap(m_Pending);
+	}
+
+	WriteBatch(batch);
+}
+
+void MeshCache::Invalidate(const glm::vec3& coord)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+
+	m_Pending.erase(coord);
+	m_Invalidated.insert(coord);
+}
+
+void MeshCache::Flush()
+{
+	std::unordered_map<glm::vec3, std::vector<uint8_t>> batch;
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		batch.swap(m_Pending);
+	}
+
+	WriteBatch(batch);
+}
+
+MeshCacheStats MeshCache::GetStats()
+{
+	return MeshCacheStats{ m_Hits, m_Misses, m_Stored, m_BytesWritten };
+}
+
+RegionFile* MeshCache::GetRegion(const glm::vec3& coord, bool create, uint32_t* index)
+{
+	const glm::ivec2 regionCoord = WorldStorage::GetRegionCoord(coord, index);
+
+	std::lock_guard<std::mutex> regionsL(m_RegionsLock);
+
+	auto it = m_Regions.find(regionCoord);
+	if (it != m_Regions.end() && (it->second || !create))
+		return it->second.get();
+
+	const std::string filepath = m_Path + "/meshes/r." + std::to_string(regionCoord.x) + "." + std::to_string(regionCoord.y) + ".cwm";
+
+	std::unique_ptr<RegionFile> region = std::make_unique<RegionFile>(filepath);
+	if (!region->Open(create))
+		region.reset();
+
+	return (m_Regions[regionCoord] = std::move(region)).get();
+}
+
+void MeshCache::WriteBatch(const std::unordered_map<glm::vec3, std::vector<uint8_t>>& batch)
+{
+	std::unordered_map<RegionFile*, std::vector<RegionWrite>> regions;
+
+	uint64_t bytes = 0;
+	for (const auto& [coord, payload] : batch)
+	{
+		uint32_t index;
+		RegionFile* region = GetRegion(coord, true, &index);
+		if (region == nullptr)
+			continue;
+
+		regions[region].push_back({ index, &payload });
+		bytes += payload.size();
+	}
+
+	for (const auto& [region, writes] : regions)
+		if (!region->WriteChunks(writes))
+			std::cout << "Failed to write " << writes.size() << " cached meshes!" << std::endl;
+
+	m_Stored += batch.size();
+	m_BytesWritten += bytes;
+}
+
+bool MeshCache::Decode(const std::vector<uint8_t>& payload, uint64_t hash, Mesh& mesh)
+{
+	if (payload.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, payload.data(), sizeof(MeshCacheHeader));
+	if (header.version != MESH_CACHE_VERSION || header.hash != hash)
+		return false;
+
+	const size_t count = (size_t)header.counts[0] + header.counts[1] + header.counts[2] + header.counts[3];
+	// At most every side of every block as a quad (8 + 6 uints), anything else is corrupted
+	if (count > CHUNK_SIZEQ * 6 * 14)
+		return false;
+
+	std::vector<uint32_t> body(count);
+
+	uLongf size = (uLongf)(count * sizeof(uint32_t));
+	if (uncompress((Bytef*)body.data(), &size, payload.data() + sizeof(MeshCacheHeader), (uLong)(payload.size() - sizeof(MeshCacheHeader))) != Z_OK
+		|| size != count * sizeof(uint32_t))
+		return false;
+
+	const uint32_t* data = body.data();
+	mesh.vertices .assign(data, data + header.counts[0]); data += header.counts[0];
+	mesh.indices  .assign(data, data + header.counts[1]); data += header.counts[1];
+	mesh.tvertices.assign(data, data + header.counts[2]); data += header.counts[2];
+	mesh.tindices .assign(data, data + header.counts[3]);
+
+	return true;
+}
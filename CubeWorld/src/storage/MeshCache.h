@@ -0,0 +1,59 @@
+#pragma once
+
+#include "WorldStorage.h"
+
+#include <unordered_set>
+
+#define MESH_CACHE_VERSION 2
+
+// Meshes written per region file at once
+#define MESH_CACHE_BATCH 64
+
+struct MeshCacheStats
+{
+	uint64_t Hits = 0, Misses = 0, Stored = 0, BytesWritten = 0;
+};
+
+// Serialized chunk meshes in region files next to the world ones, a restart
+// uploads them without meshing again. An entry is only used if the blocks of
+// the chunk and of its border still hash to the value it was built from.
+class MeshCache
+{
+public:
+	MeshCache(const std::string& path)
+		: m_Path(path) {}
+	~MeshCache();
+
+	// False if missing or stale
+	bool Load(const glm::vec3& coord, uint64_t hash, Mesh& mesh);
+
+	// Buffered and written in batches
+	void Store(const glm::vec3& coord, uint64_t hash, const Mesh& mesh);
+
+	// The entry is never loaded again until the chunk is stored with a new mesh
+	void Invalidate(const glm::vec3& coord);
+
+	void Flush();
+
+	MeshCacheStats GetStats();
+
+private:
+	RegionFile* GetRegion(const glm::vec3& coord, bool create, uint32_t* index);
+
+	void WriteBatch(const std::unordered_map<glm::vec3, std::vector<uint8_t>>& batch);
+
+	static bool Decode(const std::vector<uint8_t>& payload, uint64_t hash, Mesh& mesh);
+
+private:
+	std::string m_Path;
+
+	// nullptr if the region is not on disk
+	std::unordered_map<glm::ivec2, std::unique_ptr<RegionFile>> m_Regions;
+	std::mutex m_RegionsLock;
+
+	std::unordered_map<glm::vec3, std::vector<uint8_t>> m_Pending;
+	std::unordered_set<glm::vec3> m_Invalidated;
+	std::mutex m_Lock;
+
+	std::atomic<uint64_t> m_Hits = 0, m_Misses = 0, m_Stored = 0, m_BytesWritten = 0;
+};
@@ -0,0 +1,274 @@
+#include "RegionFile.h"
+
+#include "utils/File.h"
+
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+#include <tuple>
+
+bool RegionFile::Compress(const void* data, uint32_t size, std::vector<uint8_t>& compressed)
+{
+	uLongf compressedSize = compressBound(size);
+	compressed.resize(compressedSize);
+
+	if (compress2(compressed.data(), &compressedSize, (const Bytef*)data, size, Z_BEST_SPEED) != Z_OK)
+		return false;
+
+	compressed.resize(compressedSize);
+	return true;
+}
+
+bool RegionFile::Open(bool create)
+{
+	std::unique_lock<std::shared_mutex> lock(m_Lock);
+
+	if (!std::filesystem::exists(m_FilePath))
+	{
+		if (!create)
+			return false;
+
+		std::filesystem::create_directories(std::filesystem::path(m_FilePath).parent_path());
+
+		std::ofstream stream(m_FilePath, std::ios::binary);
+		if (!stream)
+			return false;
+
+		// Empty header padded to a whole sector
+		m_Header = RegionHeader{};
+		stream.write((const char*)&m_Header, sizeof(RegionHeader));
+
+		const std::vector<char> padding(REGION_HEADER_SECTORS * REGION_SECTOR_SIZE - sizeof(RegionHeader), 0);
+		stream.write(padding.data(), padding.size());
+
+		m_SectorCount = REGION_HEADER_SECTORS;
+		m_UsedSectors.assign(m_SectorCount, true);
+		return (bool)stream;
+	}
+
+	if (!m_File.Open(m_FilePath) || m_File.GetSize() < sizeof(RegionHeader))
+		return false;
+
+	memcpy(&m_Header, m_File.GetData(), sizeof(RegionHeader));
+	if (m_Header.magic != REGION_MAGIC || m_Header.version != REGION_VERSION)
+	{
+		std::cout << "Region file " << m_FilePath << " is corrupted or outdated!" << std::endl;
+		m_File.Close();
+		return false;
+	}
+
+	m_SectorCount = (uint32_t)REGION_SECTORS(m_File.GetSize());
+
+	m_UsedSectors.assign(m_SectorCount, false);
+	std::fill_n(m_UsedSectors.begin(), REGION_HEADER_SECTORS, true);
+
+	for (const RegionEntry& entry : m_Header.entries)
+	{
+		if (entry.sector == 0)
+			continue;
+
+		const uint32_t end = entry.sector + REGION_SECTORS(entry.size);
+		if (end > m_UsedSectors.size())
+			m_UsedSectors.resize(end, false);
+
+		std::fill(m_UsedSectors.begin() + entry.sector, m_UsedSectors.begin() + end, true);
+	}
+
+	// A torn file can point past its end, those sectors are never taken either
+	m_SectorCount = (uint32_t)m_UsedSectors.size();
+	return true;
+}
+
+bool RegionFile::HasChunk(uint32_t index)
+{
+	std::shared_lock<std::shared_mutex> lock(m_Lock);
+	return m_Header.entries[index].sector != 0;
+}
+
+bool RegionFile::ReadChunk(uint32_t index, void* data, uint32_t size)
+{
+	std::shared_lock<std::shared_mutex> lock(m_Lock);
+
+	if (m_Header.entries[index].sector == 0 || !Map(lock))
+		return false;
+
+	const RegionEntry entry = m_Header.entries[index];
+	const size_t offset = (size_t)entry.sector * REGION_SECTOR_SIZE;
+	if (offset + entry.size > m_File.GetSize())
+		return false;
+
+	uLongf decompressedSize = size;
+	return uncompress((Bytef*)data, &decompressedSize, m_File.GetData() + offset, entry.size) == Z_OK
+		&& decompressedSize == size;
+}
+
+bool RegionFile::ReadPayload(uint32_t index, std::vector<uint8_t>& payload)
+{
+	std::shared_lock<std::shared_mutex> lock(m_Lock);
+
+	if (m_Header.entries[index].sector == 0 || !Map(lock))
+		return false;
+
+	const RegionEntry entry = m_Header.entries[index];
+	const size_t offset = (size_t)entry.sector * REGION_SECTOR_SIZE;
+	if (offset + entry.size > m_File.GetSize())
+		return false;
+
+	payload.assign(m_File.GetData() + offset, m_File.GetData() + offset + entry.size);
+	return true;
+}
+
+bool RegionFile::WriteChunk(uint32_t index, const std::vector<uint8_t>& compressed)
+{
+	return WriteChunks({ { index, &compressed } });
+}
+
+bool RegionFile::WriteChunks(const std::vector<RegionWrite>& writes)
+{
+	std::unique_lock<std::shared_mutex> lock(m_Lock);
+
+	RegionHeader header = m_Header;
+
+	std::vector<std::tuple<uint32_t, const std::vector<uint8_t>*>> payloads;
+	payloads.reserve(writes.size());
+
+	// Old sectors are free only once the header no longer points at them, new ones until then
+	std::vector<RegionEntry> released, allocated;
+	released.reserve(writes.size());
+	allocated.reserve(writes.size());
+
+	for (const auto& [index, compressed] : writes)
+	{
+		RegionEntry& entry = header.entries[index];
+
+		if (entry.sector != 0)
+			released.push_back(entry);
+
+		// Never over the live sectors, a crash before the header leaves the old payload whole
+		entry.sector = AllocateSectors((uint32_t)REGION_SECTORS(compressed->size()));
+		entry.size = (uint32_t)compressed->size();
+
+		allocated.push_back(entry);
+		payloads.push_back({ entry.sector, compressed });
+	}
+
+	// Write in file order
+	std::sort(payloads.begin(), payloads.end(), [](const auto& p1, const auto& p2) { return std::get<0>(p1) < std::get<0>(p2); });
+
+	size_t end = 0;
+
+	std::fstream stream(m_FilePath, std::ios::in | std::ios::out | std::ios::binary);
+	if (stream)
+	{
+		for (const auto& [sector, compressed] : payloads)
+		{
+			stream.seekp((std::streamoff)sector * REGION_SECTOR_SIZE);
+			stream.write((const char*)compressed->data(), compressed->size());
+
+			end = std::max(end, (size_t)sector * REGION_SECTOR_SIZE + compressed->size());
+		}
+
+		stream.flush();
+	}
+
+	// The payloads are on disk before a header points at them, the OS could write the header first otherwise
+	if (!stream || !File::Sync(m_FilePath))
+	{
+		for (const RegionEntry& entry : allocated)
+			ReleaseSectors(entry);
+
+		return false;
+	}
+
+	// Whole header once per batch, on disk before the old sectors can be written over
+	stream.seekp(0);
+	stream.write((const char*)&header, sizeof(RegionHeader));
+	stream.flush();
+
+	if (!stream || !File::Sync(m_FilePath))
+	{
+		// Either header may be the one on disk, neither run is free
+		std::cout << "Failed to write the header of region file " << m_FilePath << "!" << std::endl;
+		return false;
+	}
+
+	for (const RegionEntry& entry : released)
+		ReleaseSectors(entry);
+
+	m_Header = header;
+
+	// The mapping keeps its size, it is mapped again on the next read only if the file grew past it
+	if (m_File.IsOpen() && end > m_File.GetSize())
+		m_File.Close();
+
+	return true;
+}
+
+void RegionFile::Prefetch(uint32_t index)
+{
+	// Called from the main thread, skip it while the saver is writing
+	std::shared_lock<std::shared_mutex> lock(m_Lock, std::try_to_lock);
+	if (!lock.owns_lock() || m_Header.entries[index].sector == 0 || !m_File.IsOpen())
+		return;
+
+	const RegionEntry entry = m_Header.entries[index];
+	m_File.Prefetch((size_t)entry.sector * REGION_SECTOR_SIZE, entry.size);
+}
+
+bool RegionFile::Sync()
+{
+	std::shared_lock<std::shared_mutex> lock(m_Lock);
+	return File::Sync(m_FilePath);
+}
+
+uint32_t RegionFile::AllocateSectors(uint32_t count)
+{
+	uint32_t start = REGION_HEADER_SECTORS, run = 0;
+	for (uint32_t sector = REGION_HEADER_SECTORS; sector < m_SectorCount && run < count; ++sector)
+	{
+		if (m_UsedSectors[sector])
+		{
+			start = sector + 1;
+			run = 0;
+		}
+		else
+		{
+			++run;
+		}
+	}
+
+	// No run long enough, the free sectors at the end (if any) are extended past it
+	if (start + count > m_SectorCount)
+	{
+		m_SectorCount = start + count;
+		m_UsedSectors.resize(m_SectorCount, false);
+	}
+
+	std::fill_n(m_UsedSectors.begin() + start, count, true);
+	return start;
+}
+
+void RegionFile::ReleaseSectors(const RegionEntry& entry)
+{
+	std::fill_n(m_UsedSectors.begin() + entry.sector, REGION_SECTORS(entry.size), false);
+}
+
+bool RegionFile::Map(std::shared_lock<std::shared_mutex>& lock)
+{
+	while (!m_File.IsOpen())
+	{
+		lock.unlock();
+		{
+			std::unique_lock<std::shared_mutex> mapLock(m_Lock);
+			if (!m_File.IsOpen() && !m_File.Open(m_FilePath))
+				return false;
+		}
+		lock.lock();
+	}
+
+	return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Chunk.h"
+
+#include "utils/MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <shared_mutex>
+
+// A region stores REGION_SIZE x REGION_SIZE chunk columns (all CHUNK_Y_COUNT chunks of each)
+#define REGION_SIZE 16
+#define REGION_CHUNK_COUNT (REGION_SIZE * REGION_SIZE * CHUNK_Y_COUNT)
+
+#define REGION_SECTOR_SIZE 4096
+
+#define REGION_MAGIC 0x47525743 // "CWRG"
+#define REGION_VERSION 1
+
+// Y fastest, same layout of the blocks inside a chunk
+#define REGION_ID(x, y, z) ((y) + (x) * CHUNK_Y_COUNT + (z) * CHUNK_Y_COUNT * REGION_SIZE)
+
+struct RegionEntry
+{
+	uint32_t sector = 0; // 0 = Not stored (the header lives there)
+	uint32_t size = 0;   // Compressed size in bytes
+};
+
+struct RegionHeader
+{
+	uint32_t magic = REGION_MAGIC;
+	uint32_t version = REGION_VERSION;
+
+	RegionEntry entries[REGION_CHUNK_COUNT];
+};
+
+struct RegionWrite
+{
+	uint32_t index;
+	const std::vector<uint8_t>* compressed;
+};
+
+#define REGION_HEADER_SECTORS ((sizeof(RegionHeader) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE)
+#define REGION_SECTORS(size) (((size) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE)
+
+class RegionFile
+{
+public:
+	static bool Compress(const void* data, uint32_t size, std::vector<uint8_t>& compressed);
+
+public:
+	RegionFile(const std::string& filepath)
+		: m_FilePath(filepath) {}
+
+	// Load the header, if create is set a missing file is created empty
+	bool Open(bool create);
+
+	bool HasChunk(uint32_t index);
+
+	// Decompress the chunk payload straight from the mapped pages into data
+	bool ReadChunk(uint32_t index, void* data, uint32_t size);
+
+	// Copy of the stored bytes, for payloads with their own format
+	bool ReadPayload(uint32_t index, std::vector<uint8_t>& payload);
+
+	bool WriteChunk(uint32_t index, const std::vector<uint8_t>& compressed);
+	bool WriteChunks(const std::vector<RegionWrite>& writes);
+
+	void Prefetch(uint32_t index);
+
+	// Flush the written chunks to disk
+	bool Sync();
+
+private:
+	bool Map(std::shared_lock<std::shared_mutex>& lock);
+
+	// First run of count free sectors, past the end of the file if there is none
+	uint32_t AllocateSectors(uint32_t count);
+	void ReleaseSectors(const RegionEntry& entry);
+
+private:
+	std::string m_FilePath;
+
+	RegionHeader m_Header;
+	uint32_t m_SectorCount = 0;
+
+	// Sectors of the header and of the chunks in it, a payload is never written over them
+	std::vector<bool> m_UsedSectors;
+
+	MappedFile m_File;
+	std::shared_mutex m_Lock;
+};
@@ -0,0 +1,249 @@
+#include "WorldJournal.h"
+
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+struct JournalHeader
+{
+	uint32_t magic = JOURNAL_MAGIC;
+	uint32_t version = JOURNAL_VERSION;
+};
+
+static uint32_t RecordChecksum(const JournalRecord& record)
+{
+	return (uint32_t)crc32(0, (const Bytef*)&record, offsetof(JournalRecord, checksum));
+}
+
+static void ReadJournalFile(const std::string& filepath, std::vector<JournalRecord>& records)
+{
+	std::ifstream stream(filepath, std::ios::binary);
+	if (!stream)
+		return;
+
+	JournalHeader header;
+	if (!stream.read((char*)&header, sizeof(JournalHeader)) || header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION)
+	{
+		std::cout << "Journal " << filepath << " is corrupted or outdated!" << std::endl;
+		return;
+	}
+
+	JournalRecord record;
+	while (stream.read((char*)&record, sizeof(JournalRecord)))
+	{
+		// Everything after a torn write was never committed
+		if (record.checksum != RecordChecksum(record))
+			break;
+
+		records.push_back(record);
+	}
+}
+
+void WorldJournal::ReadRecords(const std::string& path, std::vector<JournalRecord>& records)
+{
+	ReadJournalFile(path + "/journal.old", records);
+	ReadJournalFile(path + "/journal.log", records);
+}
+
+void WorldJournal::Clear(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::remove(path + "/journal.old", error);
+	std::filesystem::remove(path + "/journal.log", error);
+}
+
+WorldJournal::WorldJournal(const std::string& path, float commitInterval, float checkpointInterval)
+	: m_Path(path), m_LogPath(path + "/journal.log"), m_OldPath(path + "/journal.old"),
+	  m_CommitInterval(commitInterval), m_CheckpointInterval(checkpointInterval)
+{
+}
+
+WorldJournal::~WorldJournal()
+{
+	Close();
+}
+
+void WorldJournal::Close()
+{
+	if (m_Thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_StopLock);
+			m_Stop = true;
+		}
+
+		m_StopCondition.notify_one();
+		m_Thread.join();
+	}
+
+	Commit();
+}
+
+bool WorldJournal::Open()
+{
+	{
+		std::lock_guard<std::mutex> fileL(m_FileLock);
+
+		std::error_code error;
+		std::filesystem::create_directories(m_Path, error);
+
+		bool exists = false;
+		if (std::filesystem::exists(m_LogPath))
+		{
+			// Appending after a torn tail would make the new records unreadable
+			std::vector<JournalRecord> records;
+			ReadJournalFile(m_LogPath, records);
+
+			exists = !records.empty();
+			std::filesystem::resize_file(m_LogPath, exists ? sizeof(JournalHeader) + records.size() * sizeof(JournalRecord) : 0, error);
+		}
+
+		if (!m_File.Open(m_LogPath))
+		{
+			std::cout << "Failed to open journal " << m_LogPath << "!" << std::endl;
+			return false;
+		}
+
+		if (!exists)
+		{
+			JournalHeader header;
+			m_File.Write(&header, sizeof(JournalHeader));
+			m_File.Sync();
+		}
+	}
+
+	m_CheckpointTimer.Reset();
+	m_Thread = std::thread([this]() { Run(); });
+	return true;
+}
+
+void WorldJournal::Append(const glm::ivec3& coord, uint32_t data, const std::function<void()>& apply)
+{
+	Timer timer;
+
+	JournalRecord record{ coord.x, coord.y, coord.z, data, 0 };
+	record.checksum = RecordChecksum(record);
+
+	{
+		// Logged before it is applied, and a checkpoint rotation never falls in between
+		std::lock_guard<std::mutex> bufferL(m_BufferLock);
+		m_Buffer.push_back(record);
+
+		m_AppendNanos += timer.ElapsedNanoseconds();
+
+		apply();
+	}
+
+	++m_Edits;
+}
+
+bool WorldJournal::Commit()
+{
+	std::lock_guard<std::mutex> fileL(m_FileLock);
+	return CommitLocked();
+}
+
+bool WorldJournal::CommitLocked()
+{
+	// The buffer is taken under the file lock so concurrent commits keep the order
+	std::vector<JournalRecord> records;
+	{
+		std::lock_guard<std::mutex> bufferL(m_BufferLock);
+		records.swap(m_Buffer);
+	}
+
+	if (records.empty() || !m_File.IsOpen())
+		return true;
+
+	Timer timer;
+
+	// Group commit: one write and one fsync for every edit since the last one
+	const bool committed = m_File.Write(records.data(), records.size() * sizeof(JournalRecord)) && m_File.Sync();
+	if (!committed)
+		std::cout << "Failed to commit " << records.size() << " journal records!" << std::endl;
+
+	std::lock_guard<std::mutex> statsL(m_StatsLock);
+	m_Stats.CommitMillis = timer.ElapsedMillis();
+	++m_Stats.Commits;
+
+	return committed;
+}
+
+bool WorldJournal::Checkpoint()
+{
+	std::lock_guard<std::mutex> checkpointL(m_CheckpointLock);
+
+	bool rotated = false;
+	{
+		std::lock_guard<std::mutex> fileL(m_FileLock);
+
+		CommitLocked();
+
+		// If the last checkpoint did not finish the old log is still there, keep appending to this one
+		if (!std::filesystem::exists(m_OldPath))
+		{
+			m_File.Close();
+
+			std::error_code error;
+			std::filesystem::rename(m_LogPath, m_OldPath, error);
+
+			rotated = !error;
+
+			if (m_File.Open(m_LogPath) && rotated)
+			{
+				JournalHeader header;
+				m_File.Write(&header, sizeof(JournalHeader));
+				m_File.Sync();
+			}
+		}
+	}
+
+	// Every edit in the old log is applied and dirty, once the callback saved and synced them it can go
+	const bool saved = !m_CheckpointCallback || m_CheckpointCallback();
+	if (saved)
+	{
+		std::error_code error;
+		std::filesystem::remove(m_OldPath, error);
+	}
+	else
+	{
+		std::cout << "Checkpoint failed, journal " << m_OldPath << " is kept!" << std::endl;
+	}
+
+	m_CheckpointTimer.Reset();
+
+	std::lock_guard<std::mutex> statsL(m_StatsLock);
+	m_Stats.Checkpoints += rotated && saved;
+
+	return saved;
+}
+
+JournalStats WorldJournal::GetStats()
+{
+	std::lock_guard<std::mutex> statsL(m_StatsLock);
+
+	JournalStats stats = m_Stats;
+	stats.Edits = m_Edits;
+	stats.AppendMicros = stats.Edits > 0 ? (float)(m_AppendNanos * 0.001 / stats.Edits) : 0.0f;
+	return stats;
+}
+
+void WorldJournal::Run()
+{
+	std::unique_lock<std::mutex> lock(m_StopLock);
+	while (!m_Stop)
+	{
+		m_StopCondition.wait_for(lock, std::chrono::duration<float, std::milli>(m_CommitInterval), [this]() { return m_Stop; });
+
+		lock.unlock();
+
+		Commit();
+
+		if (m_CheckpointTimer.ElapsedSeconds() >= m_CheckpointInterval)
+			Checkpoint();
+
+		lock.lock();
+	}
+}
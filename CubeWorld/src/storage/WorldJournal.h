@@ -0,0 +1,99 @@
+#pragma once
+
+#include "utils/File.h"
+#include "utils/Timer.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#define JOURNAL_MAGIC 0x4C4A5743 // "CWJL"
+#define JOURNAL_VERSION 1
+
+struct JournalRecord
+{
+	int32_t x, y, z;   // World block coordinate
+	uint32_t data;     // ChunkBlock data (ID + Side)
+	uint32_t checksum; // crc32 of the fields above, a torn tail fails it
+};
+
+struct JournalStats
+{
+	uint64_t Edits = 0, Commits = 0, Checkpoints = 0;
+
+	float AppendMicros = 0.0f; // Average cost of logging an edit (record and buffer), not the edit itself
+	float CommitMillis = 0.0f; // Last write + fsync
+};
+
+// Append-only write-ahead log of the placed blocks, replayed on startup
+// into the region files if the process died before they were saved
+class WorldJournal
+{
+public:
+	// Records left by a previous run, oldest first
+	static void ReadRecords(const std::string& path, std::vector<JournalRecord>& records);
+
+	static void Clear(const std::string& path);
+
+public:
+	WorldJournal(const std::string& path, float commitInterval, float checkpointInterval);
+	~WorldJournal();
+
+	bool Open();
+
+	// Stop the group commit thread and commit what is left
+	void Close();
+
+	// Only buffers the record and runs apply (the edit itself), it is durable after the next group commit
+	void Append(const glm::ivec3& coord, uint32_t data, const std::function<void()>& apply);
+
+	// Write and fsync the buffered records
+	bool Commit();
+
+	// Write every edit to the region files (the callback) then drop the log. If the callback fails the old log is
+	// kept and replayed on the next start
+	bool Checkpoint();
+
+	// True once every edit is saved and synced to disk
+	inline void SetCheckpointCallback(const std::function<bool()>& callback) { m_CheckpointCallback = callback; }
+
+	JournalStats GetStats();
+
+private:
+	void Run();
+
+	bool CommitLocked();
+
+private:
+	std::string m_Path, m_LogPath, m_OldPath;
+
+	float m_CommitInterval, m_CheckpointInterval;
+
+	std::function<bool()> m_CheckpointCallback;
+
+	File m_File;
+	std::mutex m_FileLock;
+
+	std::vector<JournalRecord> m_Buffer;
+	std::mutex m_BufferLock;
+
+	std::atomic<uint64_t> m_AppendNanos = 0, m_Edits = 0;
+
+	JournalStats m_Stats;
+	std::mutex m_StatsLock;
+
+	Timer m_CheckpointTimer;
+	std::mutex m_CheckpointLock;
+
+	bool m_Stop = false;
+	std::mutex m_StopLock;
+	std::condition_variable m_StopCondition;
+
+	std::thread m_Thread;
+};
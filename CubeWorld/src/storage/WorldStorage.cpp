@@ -0,0 +1,192 @@
+#include "WorldStorage.h"
+
+#include <fstream>
+#include <filesystem>
+
+#define LEVEL_MAGIC 0x4C4C5743 // "CWLL"
+#define LEVEL_VERSION 1
+
+struct LevelData
+{
+	uint32_t magic = LEVEL_MAGIC;
+	uint32_t version = LEVEL_VERSION;
+	uint32_t seed = 0;
+};
+
+bool WorldStorage::LoadChunk(const glm::vec3& coord, ChunkBlock* data)
+{
+	uint32_t index;
+	RegionFile* region = GetRegion(coord, false, &index);
+	if (region == nullptr || !region->HasChunk(index))
+		return false;
+
+	Timer timer;
+
+	if (!region->ReadChunk(index, data, CHUNK_SIZEQ * sizeof(ChunkBlock)))
+	{
+		std::cout << "Failed to load chunk " << coord.x << ", " << coord.y << ", " << coord.z << "!" << std::endl;
+		return false;
+	}
+
+	m_DecompressNanos += timer.ElapsedNanoseconds();
+	m_BytesDecompressed += CHUNK_SIZEQ * sizeof(ChunkBlock);
+	++m_ChunksLoaded;
+
+	return true;
+}
+
+bool WorldStorage::SaveChunk(const glm::vec3& coord, const ChunkBlock* data)
+{
+	uint32_t index;
+	RegionFile* region = GetRegion(coord, true, &index);
+	if (region == nullptr)
+		return false;
+
+	std::vector<uint8_t> compressed;
+	if (!RegionFile::Compress(data, CHUNK_SIZEQ * sizeof(ChunkBlock), compressed))
+		return false;
+
+	return region->WriteChunk(index, compressed);
+}
+
+bool WorldStorage::SaveChunks(const std::vector<ChunkSnapshot>& snapshots)
+{
+	std::unordered_map<RegionFile*, std::vector<RegionWrite>> regions;
+
+	for (const ChunkSnapshot& snapshot : snapshots)
+	{
+		uint32_t index;
+		RegionFile* region = GetRegion(snapshot.coord, true, &index);
+		if (region == nullptr)
+			return false;
+
+		regions[region].push_back({ index, &snapshot.compressed });
+	}
+
+	bool saved = true;
+	for (const auto& [region, writes] : regions)
+		saved &= region->WriteChunks(writes);
+
+	return saved;
+}
+
+bool WorldStorage::HasChunk(const glm::vec3& coord)
+{
+	uint32_t index;
+	RegionFile* region = GetRegion(coord, false, &index);
+	return region != nullptr && region->HasChunk(index);
+}
+
+bool WorldStorage::LoadSeed(uint32_t* seed)
+{
+	std::ifstream stream(m_Path + "/level.dat", std::ios::binary);
+	if (!stream)
+		return false;
+
+	LevelData level;
+	if (!stream.read((char*)&level, sizeof(LevelData)) || level.magic != LEVEL_MAGIC || level.version != LEVEL_VERSION)
+	{
+		std::cout << "Level data of " << m_Path << " is corrupted or outdated!" << std::endl;
+		return false;
+	}
+
+	*seed = level.seed;
+	return true;
+}
+
+bool WorldStorage::SaveSeed(uint32_t seed)
+{
+	std::error_code error;
+	std::filesystem::create_directories(m_Path, error);
+
+	LevelData level;
+	level.seed = seed;
+
+	std::ofstream stream(m_Path + "/level.dat", std::ios::binary | std::ios::trunc);
+	return stream && stream.write((const char*)&level, sizeof(LevelData));
+}
+
+void WorldStorage::Prefetch(const glm::vec3& coord)
+{
+	uint32_t index;
+	RegionFile* region = FindRegion(coord, &index);
+	if (region != nullptr)
+		region->Prefetch(index);
+}
+
+bool WorldStorage::Sync()
+{
+	std::lock_guard<std::mutex> regionsL(m_RegionsLock);
+
+	bool synced = true;
+	for (const auto& [_, region] : m_Regions)
+		if (region)
+			synced &= region->Sync();
+
+	return synced;
+}
+
+void WorldStorage::UpdateStats()
+{
+	const float elapsed = m_StatsTimer.ElapsedSeconds();
+	if (elapsed < 1.0f)
+		return;
+
+	m_StatsTimer.Reset();
+
+	const uint64_t bytes = m_BytesDecompressed, nanos = m_DecompressNanos, pageFaults = MappedFile::GetPageFaultCount();
+
+	const double megaBytes = (bytes - m_LastBytesDecompressed) * 0.001 * 0.001;
+	const double seconds   = (nanos - m_LastDecompressNanos) * 0.001 * 0.001 * 0.001;
+
+	m_Stats.ChunksLoaded = m_ChunksLoaded;
+	m_Stats.DecompressedMBs = megaBytes / elapsed;
+	m_Stats.DecompressThroughput = seconds > 0.0 ? megaBytes / seconds : 0.0;
+
+	m_Stats.PageFaults = pageFaults;
+	m_Stats.PageFaultsPerSecond = (pageFaults - m_LastPageFaults) / elapsed;
+
+	m_LastBytesDecompressed = bytes;
+	m_LastDecompressNanos = nanos;
+	m_LastPageFaults = pageFaults;
+}
+
+RegionFile* WorldStorage::GetRegion(const glm::vec3& coord, bool create, uint32_t* index)
+{
+	const glm::ivec2 regionCoord = GetRegionCoord(coord, index);
+
+	std::lock_guard<std::mutex> regionsL(m_RegionsLock);
+
+	auto it = m_Regions.find(regionCoord);
+	if (it != m_Regions.end() && (it->second || !create))
+		return it->second.get();
+
+	const std::string filepath = m_Path + "/region/r." + std::to_string(regionCoord.x) + "." + std::to_string(regionCoord.y) + ".cwr";
+
+	std::unique_ptr<RegionFile> region = std::make_unique<RegionFile>(filepath);
+	if (!region->Open(create))
+		region.reset();
+
+	return (m_Regions[regionCoord] = std::move(region)).get();
+}
+
+RegionFile* WorldStorage::FindRegion(const glm::vec3& coord, uint32_t* index)
+{
+	const glm::ivec2 regionCoord = GetRegionCoord(coord, index);
+
+	std::lock_guard<std::mutex> regionsL(m_RegionsLock);
+
+	auto it = m_Regions.find(regionCoord);
+	return it != m_Regions.end() ? it->second.get() : nullptr;
+}
+
+glm::ivec2 WorldStorage::GetRegionCoord(const glm::vec3& coord, uint32_t* index)
+{
+	const glm::ivec3 chunk = glm::ivec3(glm::floor(coord * CHUNK_SIZE_INV));
+	const glm::ivec2 regionCoord{
+		(int)std::floor((float)chunk.x / REGION_SIZE),
+		(int)std::floor((float)chunk.z / REGION_SIZE) };
+
+	*index = REGION_ID(chunk.x - regionCoord.x * REGION_SIZE, chunk.y, chunk.z - regionCoord.y * REGION_SIZE);
+	return regionCoord;
+}
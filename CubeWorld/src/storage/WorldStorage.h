@@ -0,0 +1,85 @@
+#pragma once
+
+#include "RegionFile.h"
+
+#include "utils/Timer.h"
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+struct ChunkSnapshot
+{
+	glm::vec3 coord;
+	std::vector<uint8_t> compressed;
+};
+
+struct StorageStats
+{
+	uint64_t ChunksLoaded = 0;
+
+	double DecompressedMBs = 0.0;     // MB decompressed per second of wall time
+	double DecompressThroughput = 0.0; // MB per second spent inside zlib
+
+	uint64_t PageFaults = 0;
+	double PageFaultsPerSecond = 0.0;
+};
+
+class WorldStorage
+{
+public:
+	WorldStorage(const std::string& path)
+		: m_Path(path) {}
+
+	// Chunk coordinates are in world units (multiple of CHUNK_SIZE)
+	bool LoadChunk(const glm::vec3& coord, ChunkBlock* data);
+	bool SaveChunk(const glm::vec3& coord, const ChunkBlock* data);
+
+	// Batch write, one write per region file
+	bool SaveChunks(const std::vector<ChunkSnapshot>& snapshots);
+
+	bool HasChunk(const glm::vec3& coord);
+
+	// Generation seed of the world, false if the world was never saved
+	bool LoadSeed(uint32_t* seed);
+	bool SaveSeed(uint32_t seed);
+
+	// Readahead of the chunk payload, does nothing if it was never saved
+	void Prefetch(const glm::vec3& coord);
+
+	// Flush every region file to disk
+	bool Sync();
+
+	void UpdateStats();
+
+	inline const StorageStats& GetStats() const { return m_Stats; }
+
+	// Region of a chunk and the index of the chunk inside it
+	static glm::ivec2 GetRegionCoord(const glm::vec3& coord, uint32_t* index);
+
+private:
+	RegionFile* GetRegion(const glm::vec3& coord, bool create, uint32_t* index);
+
+	// Only regions already opened, never touches the disk
+	RegionFile* FindRegion(const glm::vec3& coord, uint32_t* index);
+
+private:
+	std::string m_Path;
+
+	// nullptr if the region is not on disk
+	std::unordered_map<glm::ivec2, std::unique_ptr<RegionFile>> m_Regions;
+	std::mutex m_RegionsLock;
+
+	std::atomic<uint64_t> m_ChunksLoaded = 0, m_BytesDecompressed = 0, m_DecompressNanos = 0;
+
+	uint64_t m_LastBytesDecompressed = 0, m_LastDecompressNanos = 0, m_LastPageFaults = 0;
+
+	StorageStats m_Stats;
+	Timer m_StatsTimer;
+};
@@ -0,0 +1,344 @@
+#include "Pregenerator.h"
+
+#include "Chunk.h"
+#include "CubeWorld.h"
+#include "LightEngine.h"
+
+#include "storage/WorldStorage.h"
+#include "storage/MeshCache.h"
+
+#include "utils/Timer.h"
+#include "utils/ThreadPool.h"
+#include "utils/SimplexNoise.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <deque>
+#include <atomic>
+
+struct PregenSettings
+{
+	uint32_t Seed = 0;
+	int Radius = 0; // In chunk columns around the origin
+
+	bool Mesh = false;
+
+	uint32_t Threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	std::string Path = "saves/world";
+};
+
+struct PregenStats
+{
+	std::atomic<uint64_t> Generated = 0, Skipped = 0, BytesRaw = 0, BytesCompressed = 0;
+	std::atomic<uint64_t> Meshed = 0, Quads = 0;
+
+	float MeshSeconds = 0.0f, LightSeconds = 0.0f;
+};
+
+// One row of chunk columns along X, Y fastest
+using ChunkRow = std::vector<Chunk*>;
+
+static bool ParseNumber(const char* text, long long low, long long high, long long* value)
+{
+	char* end;
+	*value = std::strtoll(text, &end, 10);
+	return end != text && *end == '\0' && *value >= low && *value <= high;
+}
+
+static bool ParseArguments(int argc, char** argv, PregenSettings& settings)
+{
+	long long value;
+
+	if (argc < 2 || !ParseNumber(argv[0], 0, 0xFFFFFFFF, &value))
+		return false;
+	settings.Seed = (uint32_t)value;
+
+	if (!ParseNumber(argv[1], 0, 4096, &value))
+		return false;
+	settings.Radius = (int)value;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--mesh") == 0)
+			settings.Mesh = true;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && ParseNumber(argv[i + 1], 1, 256, &value))
+		{
+			settings.Threads = (uint32_t)value;
+			++i;
+		}
+		else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+			settings.Path = argv[++i];
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static ChunkRow GenerateRow(ThreadPool& pool, WorldStorage& storage, SimplexNoise& noise, const PregenSettings& settings,
+	int z, int extent, std::vector<ChunkSnapshot>& snapshots, PregenStats& stats)
+{
+	const size_t count = (size_t)(extent * 2 + 1) * CHUNK_Y_COUNT;
+
+	snapshots.clear();
+	snapshots.resize(count);
+
+	std::vector<std::future<Chunk*>> tasks;
+	tasks.reserve(count);
+
+	size_t i = 0;
+	for (int x = -extent; x <= extent; x++)
+		for (int y = 0; y < CHUNK_Y_COUNT; y++)
+		{
+			ChunkSnapshot& snapshot = snapshots[i++];
+			snapshot.coord = glm::vec3{ x, y, z } * CHUNK_SIZE3;
+
+			tasks.push_back(pool.enqueue([&storage, &noise, &settings, &snapshot, &stats]() -> Chunk*
+			{
+				// Already in the world (pregenerated or edited in game), never overwritten
+				if (storage.HasChunk(snapshot.coord))
+				{
+					++stats.Skipped;
+					if (!settings.Mesh)
+						return nullptr;
+
+					Chunk* chunk = new Chunk{ snapshot.coord };
+					if (!chunk->Load(&storage))
+						chunk->Fill(&noise, settings.Seed);
+
+					return chunk;
+				}
+
+				Chunk* chunk = new Chunk{ snapshot.coord };
+				chunk->Fill(&noise, settings.Seed);
+
+				RegionFile::Compress(chunk->GetData(), CHUNK_SIZEQ * sizeof(ChunkBlock), snapshot.compressed);
+
+				++stats.Generated;
+				stats.BytesRaw += CHUNK_SIZEQ * sizeof(ChunkBlock);
+				stats.BytesCompressed += snapshot.compressed.size();
+
+				if (settings.Mesh)
+					return chunk;
+
+				delete chunk;
+				return nullptr;
+			}));
+		}
+
+	ChunkRow row(count);
+	for (i = 0; i < count; i++)
+		row[i] = tasks[i].get();
+
+	std::erase_if(snapshots, [](const ChunkSnapshot& snapshot) { return snapshot.compressed.empty(); });
+
+	return row;
+}
+
+// rows[1] is meshed, rows[0] and rows[2] are its -Z and +Z neighbors
+static void MeshRow(ThreadPool& pool, MeshCache& cache, const std::deque<ChunkRow>& rows, int radius, int extent, PregenStats& stats)
+{
+	Timer timer;
+
+	std::vector<std::future<void>> tasks;
+	tasks.reserve((size_t)(radius * 2 + 1) * CHUNK_Y_COUNT);
+
+	for (int x = -radius; x <= radius; x++)
+		for (int y = 0; y < CHUNK_Y_COUNT; y++)
+		{
+			const int column = x + extent;
+
+			tasks.push_back(pool.enqueue([&cache, &rows, &stats, column, y]()
+			{
+				Chunk* chunks[27];
+
+				int i = 0;
+				for (int dz = -1; dz <= 1; dz++)
+					for (int dy = -1; dy <= 1; dy++)
+						for (int dx = -1; dx <= 1; dx++, i++)
+						{
+							const int ny = y + dy;
+							chunks[i] = ny >= 0 && ny < CHUNK_Y_COUNT ? rows[1 + dz][(column + dx) * CHUNK_Y_COUNT + ny] : nullptr;
+						}
+
+				Mesh mesh;
+				chunks[13]->GenerateMesh(chunks, mesh);
+
+				cache.Store(chunks[13]->m_Coord, chunks[13]->ContentHash(chunks), mesh);
+
+				++stats.Meshed;
+				// 4 vertices of 2 uints per quad
+				stats.Quads += (mesh.vertices.size() + mesh.tvertices.size()) / 8;
+			}));
+		}
+
+	for (std::future<void>& task : tasks)
+		task.get();
+
+	stats.MeshSeconds += timer.ElapsedSeconds();
+}
+
+// Light spreads less than a chunk, the middle of three lit rows has its final light
+static void LightRow(LightEngine& light, const ChunkRow& row, PregenStats& stats)
+{
+	Timer timer;
+
+	for (Chunk* chunk : row)
+		light.AddChunk(chunk);
+
+	light.Update(0.0f);
+
+	stats.LightSeconds += timer.ElapsedSeconds();
+}
+
+static void ForgetRow(LightEngine& light, const ChunkRow& row)
+{
+	for (size_t i = 0; i < row.size(); i += CHUNK_Y_COUNT)
+		light.RemoveColumn(glm::ivec2(glm::floor(glm::vec2{ row[i]->m_Coord.x, row[i]->m_Coord.z } * CHUNK_SIZE_INV)));
+}
+
+static void DeleteRow(const ChunkRow& row)
+{
+	for (Chunk* chunk : row)
+		delete chunk;
+}
+
+void Pregenerator::PrintUsage()
+{
+	std::cout << "Usage: CubeWorld --pregen <seed> <radius> [--mesh] [--threads N] [--path saves/world]" << std::endl;
+	std::cout << "  <radius>   Chunk columns around the origin, (2 * radius + 1)^2 columns in total" << std::endl;
+	std::cout << "  --mesh     Also mesh every chunk into the mesh cache" << std::endl;
+	std::cout << "  --threads  Worker threads (default: every hardware thread)" << std::endl;
+	std::cout << "  --path     World directory (default: saves/world)" << std::endl;
+}
+
+int Pregenerator::Run(int argc, char** argv)
+{
+	PregenSettings settings;
+	if (!ParseArguments(argc, argv, settings))
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	// The atlas UVs are never used without a renderer
+	CubeWorld::RegisterBlocks(glm::vec2{ 1.0f / 16.0f, 1.0f / 16.0f });
+
+	WorldGenerationSettings generation;
+	generation.Seed = settings.Seed;
+
+	SimplexNoise noise(generation.Frequency, generation.Amplitude, generation.Lacunarity, generation.Persistence);
+
+	WorldStorage storage(settings.Path);
+
+	uint32_t worldSeed;
+	if (storage.LoadSeed(&worldSeed) && worldSeed != settings.Seed)
+	{
+		std::cout << "World " << settings.Path << " was generated with seed " << worldSeed << "!" << std::endl;
+		BlocksManager::Dispose();
+		return -1;
+	}
+
+	if (!storage.SaveSeed(settings.Seed))
+	{
+		std::cout << "Failed to create world " << settings.Path << "!" << std::endl;
+		BlocksManager::Dispose();
+		return -1;
+	}
+
+	// Meshing the border columns needs one more ring of generated neighbors
+	const int extent = settings.Radius + (settings.Mesh ? 1 : 0), width = extent * 2 + 1;
+	const uint64_t total = (uint64_t)width * width * CHUNK_Y_COUNT;
+
+	std::cout << "Pregenerating " << total << " chunks of " << settings.Path << " (seed " << settings.Seed << ", radius " << settings.Radius
+		<< (settings.Mesh ? ", meshing" : "") << ") on " << settings.Threads << " threads" << std::endl;
+
+	PregenStats stats;
+	bool saved = true;
+
+	MeshCache meshCache(settings.Path);
+	LightEngine light;
+
+	Timer timer;
+
+	{
+		ThreadPool pool(settings.Threads);
+
+		// Only three rows are alive at once, a row is written while the next one generates
+		std::deque<ChunkRow> rows;
+		std::vector<ChunkSnapshot> snapshots[2];
+		std::future<bool> saving;
+
+		for (int z = -extent; z <= extent; z++)
+		{
+			std::vector<ChunkSnapshot>& rowSnapshots = snapshots[(z + extent) & 1];
+			rows.push_back(GenerateRow(pool, storage, noise, settings, z, extent, rowSnapshots, stats));
+
+			if (saving.valid())
+				saved &= saving.get();
+
+			saving = pool.enqueue([&storage, &rowSnapshots]() { return storage.SaveChunks(rowSnapshots); });
+
+			if (settings.Mesh)
+				LightRow(light, rows.back(), stats);
+
+			if (settings.Mesh && rows.size() == 3)
+				MeshRow(pool, meshCache, rows, settings.Radius, extent, stats);
+
+			if (!settings.Mesh || rows.size() == 3)
+			{
+				if (settings.Mesh)
+					ForgetRow(light, rows.front());
+
+				DeleteRow(rows.front());
+				rows.pop_front();
+			}
+
+			const uint64_t done = stats.Generated + stats.Skipped;
+			std::cout << "\r[" << (z + extent + 1) << "/" << width << "] " << done << "/" << total << " chunks ("
+				<< done * 100 / total << "%) - " << (uint64_t)(done / std::max(timer.ElapsedSeconds(), 0.001f)) << " chunks/s   " << std::flush;
+		}
+
+		if (saving.valid())
+			saved &= saving.get();
+
+		for (const ChunkRow& row : rows)
+			DeleteRow(row);
+	}
+
+	meshCache.Flush();
+
+	saved &= storage.Sync();
+
+	const float seconds = std::max(timer.ElapsedSeconds(), 0.001f);
+	std::cout << std::endl;
+
+	std::cout << "Generated " << stats.Generated << " chunks (" << stats.Skipped << " already saved) in " << CubeWorld::FormatFloat(seconds, 3) << " s - "
+		<< (uint64_t)(stats.Generated / seconds) << " chunks/s" << std::endl;
+
+	std::cout << "Written " << CubeWorld::BytesToText((double)stats.BytesCompressed) << " (" << CubeWorld::BytesToText((double)stats.BytesRaw) << " raw) - "
+		<< CubeWorld::BytesToText(stats.BytesCompressed / seconds) << "/s" << std::endl;
+
+	if (settings.Mesh)
+	{
+		std::cout << "Meshed " << stats.Meshed << " chunks (" << stats.Quads << " quads) in " << CubeWorld::FormatFloat(stats.MeshSeconds, 3) << " s - "
+			<< (uint64_t)(stats.Meshed / std::max(stats.MeshSeconds, 0.001f)) << " chunks/s" << std::endl;
+
+		const LightStats& lightStats = light.GetStats();
+		std::cout << "Lit " << lightStats.ColumnsLit << " columns (" << lightStats.NodesProcessed << " nodes) in " << CubeWorld::FormatFloat(stats.LightSeconds, 3) << " s - "
+			<< (uint64_t)(lightStats.ColumnsLit / std::max(stats.LightSeconds, 0.001f)) << " columns/s" << std::endl;
+
+		const MeshCacheStats meshCacheStats = meshCache.GetStats();
+		std::cout << "Mesh cache: " << meshCacheStats.Stored << " meshes (" << CubeWorld::BytesToText((double)meshCacheStats.BytesWritten) << ")" << std::endl;
+	}
+
+	if (!saved)
+		std::cout << "Failed to write some chunks to " << settings.Path << "!" << std::endl;
+
+	BlocksManager::Dispose();
+
+	return saved ? 0 : -1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Headless world generation into the region files, no window or GL context
+// CubeWorld --pregen <seed> <radius> [--mesh] [--threads N] [--path saves/world]
+class Pregenerator
+{
+public:
+	static int Run(int argc, char** argv);
+
+	static void PrintUsage();
+};
@@ -0,0 +1,111 @@
+#include "File.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+File::~File()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool File::Open(const std::string& path)
+{
+	Close();
+
+	HANDLE handle = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	m_Handle = handle;
+	return true;
+}
+
+void File::Close()
+{
+	if (m_Handle)
+		CloseHandle(m_Handle);
+
+	m_Handle = nullptr;
+}
+
+bool File::Write(const void* data, size_t size)
+{
+	DWORD written = 0;
+	return WriteFile(m_Handle, data, (DWORD)size, &written, NULL) && written == size;
+}
+
+bool File::Sync()
+{
+	return FlushFileBuffers(m_Handle);
+}
+
+bool File::Sync(const std::string& path)
+{
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool synced = FlushFileBuffers(handle);
+	CloseHandle(handle);
+	return synced;
+}
+
+#else
+
+bool File::Open(const std::string& path)
+{
+	Close();
+
+	m_FileDescriptor = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+	return m_FileDescriptor >= 0;
+}
+
+void File::Close()
+{
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+
+	m_FileDescriptor = -1;
+}
+
+bool File::Write(const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	while (size > 0)
+	{
+		ssize_t written = write(m_FileDescriptor, bytes, size);
+		if (written <= 0)
+			return false;
+
+		bytes += written;
+		size -= (size_t)written;
+	}
+
+	return true;
+}
+
+bool File::Sync()
+{
+	return fsync(m_FileDescriptor) == 0;
+}
+
+bool File::Sync(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	bool synced = fsync(fd) == 0;
+	close(fd);
+	return synced;
+}
+
+#endif
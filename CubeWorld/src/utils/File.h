@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Unbuffered native file for writes that have to reach the disk
+class File
+{
+public:
+	File() = default;
+	~File();
+
+	File(const File&) = delete;
+	File& operator=(const File&) = delete;
+
+	// Opens for appending, the file is created if missing
+	bool Open(const std::string& path);
+	void Close();
+
+	bool Write(const void* data, size_t size);
+
+	// fsync / FlushFileBuffers
+	bool Sync();
+
+#ifdef _WIN32
+	inline bool IsOpen() const { return m_Handle != nullptr; }
+#else
+	inline bool IsOpen() const { return m_FileDescriptor >= 0; }
+#endif
+
+	// Flush to disk the data written by any handle of the file
+	static bool Sync(const std::string& path);
+
+private:
+#ifdef _WIN32
+	void* m_Handle = nullptr;
+#else
+	int m_FileDescriptor = -1;
+#endif
+};
@@ -0,0 +1,83 @@
+#include "FramePacer.h"
+
+#include <thread>
+#include <cmath>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <timeapi.h>
+#endif
+
+FramePacer::FramePacer()
+{
+#ifdef _WIN32
+	// The default timer granularity rounds a 1 ms sleep up to 15.6 ms
+	timeBeginPeriod(1);
+#endif
+
+	Reset();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::Reset()
+{
+	m_Due = m_LastFrame = Clock::now();
+}
+
+float FramePacer::Wait(float frameSeconds)
+{
+	using namespace std::chrono;
+
+	m_Due += duration_cast<Clock::duration>(duration<double>(frameSeconds));
+
+	Clock::time_point now = Clock::now();
+
+	// Late, the next frames are not rushed to catch up
+	if (now > m_Due)
+		m_Due = now;
+
+	// Sleeps while one more surely ends before the deadline, mean plus a deviation of them
+	const Clock::time_point sleepStart = now;
+	while (true)
+	{
+		const double variance = m_SleepSquares - m_SleepMean * m_SleepMean;
+		const double estimate = m_SleepMean + std::sqrt(variance > 0.0 ? variance : 0.0);
+
+		if (duration<double>(m_Due - now).count() <= estimate)
+			break;
+
+		std::this_thread::sleep_for(milliseconds(1));
+
+		const Clock::time_point woken = Clock::now();
+		const double slept = duration<double>(woken - now).count();
+		now = woken;
+
+		m_SleepMean    += (slept - m_SleepMean) * 0.05;
+		m_SleepSquares += (slept * slept - m_SleepSquares) * 0.05;
+	}
+
+	// The rest spinning, yielding to the workers
+	const Clock::time_point spinStart = now;
+	while (now < m_Due)
+	{
+		std::this_thread::yield();
+		now = Clock::now();
+	}
+
+	m_Stats.SleepMillis = duration<float, std::milli>(spinStart - sleepStart).count();
+	m_Stats.SpinMillis = duration<float, std::milli>(now - spinStart).count();
+	m_Stats.SleepErrorMicros = (float)((m_SleepMean - 0.001) * 1e6);
+
+	const float elapsed = duration<float>(now - m_LastFrame).count();
+	m_LastFrame = now;
+
+	return elapsed;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+struct FramePacerStats
+{
+	float SleepMillis = 0.0f, SpinMillis = 0.0f; // Waited by the last frame
+	float SleepErrorMicros = 0.0f;               // Expected overshoot of a 1 ms sleep
+};
+
+// Paces a loop without keeping a core busy: it sleeps 1 ms at a time while the time
+// left is above the expected overshoot of a sleep (measured as it goes), then yields in a short
+// spin to the exact deadline. Frames are due every frame time from the last deadline, a late
+// frame starts the schedule again from now.
+class FramePacer
+{
+public:
+	FramePacer();
+	~FramePacer();
+
+	// From now, the time before does not count (a long load)
+	void Reset();
+
+	// Wait for the frame due frameSeconds after the last one, returns the seconds since it
+	float Wait(float frameSeconds);
+
+	inline const FramePacerStats& GetStats() const { return m_Stats; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	Clock::time_point m_Due, m_LastFrame;
+
+	// Of the 1 ms sleeps, in seconds
+	double m_SleepMean = 0.002, m_SleepSquares = 0.002 * 0.002;
+
+	FramePacerStats m_Stats;
+};
@@ -0,0 +1,163 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <Psapi.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/resource.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_MappingHandle = mapping;
+	m_Data = (const uint8_t*)data;
+	m_Size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+
+	m_Data = nullptr;
+	m_Size = 0;
+	m_FileHandle = m_MappingHandle = nullptr;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (!m_Data || offset >= m_Size)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)(m_Data + offset);
+	range.NumberOfBytes = std::min(size, m_Size - offset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+uint64_t MappedFile::GetPageFaultCount()
+{
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PageFaultCount;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	// Chunks are read in camera order, not file order
+	madvise(data, (size_t)st.st_size, MADV_RANDOM);
+
+	m_FileDescriptor = fd;
+	m_Data = (const uint8_t*)data;
+	m_Size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data)
+		munmap((void*)m_Data, m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+
+	m_Data = nullptr;
+	m_Size = 0;
+	m_FileDescriptor = -1;
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (!m_Data || offset >= m_Size)
+		return;
+
+	// madvise wants a page aligned address
+	const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t begin = offset & ~(pageSize - 1);
+	const size_t end = std::min(offset + size, m_Size);
+
+	madvise((void*)(m_Data + begin), end - begin, MADV_WILLNEED);
+}
+
+uint64_t MappedFile::GetPageFaultCount()
+{
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	return (uint64_t)usage.ru_minflt + (uint64_t)usage.ru_majflt;
+}
+
+#endif
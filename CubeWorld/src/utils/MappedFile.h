@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	// Hint the OS to start reading the range in the page cache
+	void Prefetch(size_t offset, size_t size) const;
+
+	inline bool           IsOpen()  const { return m_Data != nullptr; }
+	inline const uint8_t* GetData() const { return m_Data; }
+	inline size_t         GetSize() const { return m_Size; }
+
+	static uint64_t GetPageFaultCount();
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+
+#ifdef _WIN32
+	void* m_FileHandle = nullptr, *m_MappingHandle = nullptr;
+#else
+	int m_FileDescriptor = -1;
+#endif
+};
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <future>
+#include <atomic>
 
 class ThreadPool
 {
@@ -37,6 +38,7 @@ public:
                     }
 
                     task();
+                    ++completed;
                 }
             });
         }
@@ -79,6 +81,17 @@ public:
         return tasks.size();
     }
 
+    inline size_t GetThreadCount() const
+    {
+        return workers.size();
+    }
+
+    // Tasks run to the end since the start
+    inline uint64_t GetCompletedCount() const
+    {
+        return completed.load(std::memory_order_relaxed);
+    }
+
 private:
     std::vector<std::thread> workers;
     std::queue<std::function<void()>> tasks;
@@ -86,4 +99,6 @@ private:
     std::mutex queueMutex;
     std::condition_variable condition;
     bool stop;
+
+    std::atomic<uint64_t> completed{ 0 };
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+// Hand-off from one producer thread to one consumer thread where neither waits for the other.
+// The producer fills its own slot and publishes it, the consumer takes the last one published,
+// each on its slot while the third holds the published one.
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Producer only, the slot to fill
+	inline T& Back() { return m_Slots[m_Back]; }
+
+	// Producer only. Published but not taken yet, a slot published over it would never be read
+	inline bool IsPending() const { return m_Middle.load(std::memory_order_acquire) & FRESH; }
+
+	// Producer only, hands Back() over, Back() is another slot afterwards (filled before, to fill again)
+	void Publish()
+	{
+		m_Back = m_Middle.exchange(m_Back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	// Consumer only, the last slot published, nullptr if none since the last call. Valid until the next call
+	T* Acquire()
+	{
+		if (!(m_Middle.load(std::memory_order_acquire) & FRESH))
+			return nullptr;
+
+		m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & INDEX;
+		return &m_Slots[m_Front];
+	}
+
+private:
+	static constexpr int INDEX = 3, FRESH = 4;
+
+	T m_Slots[3];
+
+	int m_Back = 0, m_Front = 1;
+	std::atomic<int> m_Middle{ 2 }; // Index, FRESH once published until taken
+};